@@ -0,0 +1,1335 @@
+#pragma once                                                        //Sub-accounts, bank accounts and the account directory
+
+#include "journal.h"
+
+class SubAccount{                                           //Shared state for every account type: balance, history and logging -- the limits live in PolicyAccount
+    protected:
+        struct PendingRecord{                               //An accepted change on its way into the history, on the stack of the thread that made it until done is set
+            PendingRecord* next;
+            TransactionType type;
+            uint16_t sequence;
+            int64_t oldCents;
+            int64_t newCents;
+            int64_t timestamp;
+            uint64_t logSequence;                           //Set before done, so the maker's commit() waits for the right log record
+            std::atomic<bool> done;
+        };
+
+        static constexpr int64_t balanceLimit = (int64_t(1) << 47) - 1;        //Balances live in the top 48 bits of state, about $1.4 trillion either way
+        static constexpr uint64_t ownerBit = uint64_t(1) << 15;                 //Held by the one thread allowed to write the history: a change that finds it clear takes it in the same CAS that accepts it
+        static constexpr uint64_t frozenBit = uint64_t(1) << 14;                //Set by the owner when the balance must hold still (a transfer, readState)
+        static constexpr uint16_t sequenceMask = uint16_t(frozenBit - 1);
+
+        static uint64_t pack(int64_t cents, uint16_t sequence){
+            return (uint64_t(cents) << 16) | (sequence & sequenceMask);
+        }
+
+        static int64_t centsOf(uint64_t word){
+            return int64_t(word) >> 16;
+        }
+
+        static uint16_t sequenceOf(uint64_t word){
+            return uint16_t(word & sequenceMask);
+        }
+
+        static uint16_t following(uint16_t sequence){
+            return uint16_t((sequence + 1) & sequenceMask);
+        }
+
+        mutable TransactionHistory History;                 //Owner only -- mutable like the rest of the owner's state, since readers own the account too and record what queued behind them on the way out
+        mutable std::atomic<uint64_t> state;                //Balance in cents << 16 | owner bit | frozen bit | 14-bit sequence of the last accepted change; the owner bit only clears once that change is in the history
+        mutable std::atomic<PendingRecord*> pending;        //Changes accepted while the account was owned, pushed by their makers, newest first
+        mutable std::atomic<uint32_t> wakeups;              //Bumped when queued changes are recorded or the owner leaves with sleepers, everyone who waits sleeps on it
+        mutable std::atomic<uint32_t> sleepers;             //Threads asleep until the owner or frozen bit clears, so a plain release never has to bump wakeups
+        mutable PendingRecord* parked;                      //Drained ahead of an earlier sequence that hasn't arrived yet, in sequence order (owner)
+        mutable uint16_t appliedSequence;                   //Sequence of the newest change in History (owner)
+        WriteAheadLog* journal;                             //Optional, set by the owning BankAccount
+        std::string_view owner;                             //Owning username (stored inline in the BankAccount, which never moves) and C/S code, only used to label log records
+        char code;
+
+        class HistoryGuard{                                 //Owns the account for a scope
+            private:
+                const SubAccount& account;
+
+            public:
+                explicit HistoryGuard(const SubAccount& target) : account(target) {
+                    account.acquire();
+                }
+
+                ~HistoryGuard(){
+                    account.release();
+                }
+
+                HistoryGuard(const HistoryGuard&) = delete;
+                HistoryGuard& operator=(const HistoryGuard&) = delete;
+        };
+
+        void wake() const{
+            wakeups.fetch_add(1, std::memory_order_release);
+            wakeups.notify_all();
+        }
+
+        uint64_t awaitClear(uint64_t bits) const{           //Sleeps until none of bits are set in state, returns the word that showed it
+            uint64_t word = state.load(std::memory_order_acquire);
+
+            while(word & bits){
+                uint32_t ticket = wakeups.load(std::memory_order_acquire);
+                sleepers.fetch_add(1, std::memory_order_seq_cst);
+                word = state.load(std::memory_order_seq_cst);          //Looked at again after signing up: release() clears the owner bit before it reads sleepers, so one of the two sees the other
+
+                if(word & bits){
+                    wakeups.wait(ticket, std::memory_order_acquire);
+                }
+
+                sleepers.fetch_sub(1, std::memory_order_relaxed);
+                word = state.load(std::memory_order_acquire);
+            }
+
+            return word;
+        }
+
+        void acquire() const{                               //Takes the owner bit, asleep while someone else has it -- with the bit clear every accepted change is already in the history
+            uint64_t word = awaitClear(ownerBit);
+
+            while(!state.compare_exchange_weak(word, word | ownerBit, std::memory_order_acquire, std::memory_order_acquire)){
+                if(word & ownerBit){
+                    word = awaitClear(ownerBit);
+                }
+            }
+        }
+
+        void release() const{                               //Owner: records everything accepted so far, then clears the owner bit in a CAS that fails if another change got in first, so nothing is ever left queued without an owner
+            uint64_t word = state.load(std::memory_order_acquire);
+
+            do{
+                catchUp(sequenceOf(word));
+            } while(!state.compare_exchange_weak(word, word & ~ownerBit, std::memory_order_seq_cst, std::memory_order_acquire));
+
+            if(sleepers.load(std::memory_order_seq_cst) != 0){
+                wake();
+            }
+        }
+
+        uint64_t logChange(const char* command, Money amount, int64_t timestamp) const{        //e.g. "DEPOSIT bob C 100.00 at=1760000000000000", the time so replay restamps the record the same way -- returns its log sequence number, 0 without a log
+            if(journal != nullptr){
+                return journal -> append(string(command) + " " + string(owner) + " " + code + " " + amount.toString() + " at=" + std::to_string(timestamp));
+            }
+
+            return 0;
+        }
+
+        uint64_t recordChange(TransactionType type, int64_t oldCents, int64_t newCents, int64_t timestamp, uint16_t sequence) const{        //Owner, and sequence is next: history first, then the log -- returns the log sequence number
+            Money change = Money::fromCents(newCents - oldCents);
+            int64_t stamped = History.addRecord(type, Money::fromCents(oldCents), change, timestamp);
+            appliedSequence = sequence;
+            return logChange(type == TransactionType::Deposit ? "DEPOSIT" : "WITHDRAW", change.magnitude(), stamped);
+        }
+
+        void drainLocked() const{                           //Owner: moves every pending change whose turn has come into the history and the log, in sequence order
+            PendingRecord* taken = pending.exchange(nullptr, std::memory_order_acquire);
+
+            while(taken != nullptr){                        //Newest first, so each one usually goes in at the front of parked
+                PendingRecord* record = taken;
+                taken = taken -> next;
+                uint16_t distance = uint16_t((record -> sequence - appliedSequence - 1) & sequenceMask);
+                PendingRecord** slot = &parked;
+
+                while(*slot != nullptr && uint16_t(((*slot) -> sequence - appliedSequence - 1) & sequenceMask) < distance){
+                    slot = &(*slot) -> next;
+                }
+
+                record -> next = *slot;
+                *slot = record;
+            }
+
+            bool finished = false;
+
+            while(parked != nullptr && parked -> sequence == following(appliedSequence)){
+                PendingRecord* record = parked;
+                parked = record -> next;
+                record -> logSequence = recordChange(record -> type, record -> oldCents, record -> newCents, record -> timestamp, record -> sequence);
+                record -> done.store(true, std::memory_order_release);         //Last touch, the maker may return as soon as it sees this
+                finished = true;
+            }
+
+            if(finished){
+                wake();
+            }
+        }
+
+        void catchUp(uint16_t sequence) const{              //Owner: drains until the change numbered sequence is in the history -- the makers still missing are between their CAS and their push, which never blocks
+            while(appliedSequence != sequence){
+                drainLocked();
+
+                if(appliedSequence != sequence){
+                    pending.wait(nullptr, std::memory_order_acquire);
+                }
+            }
+        }
+
+        uint64_t freezeLocked(){                            //Owner: stops changes, waits until the ones already accepted are in the history and returns the word they left -- thawLocked() undoes it
+            uint64_t word = state.fetch_or(frozenBit, std::memory_order_acq_rel);         //Only the owner freezes, so it wasn't frozen before
+            catchUp(sequenceOf(word));
+            return word;
+        }
+
+        void thawLocked(uint64_t word){                     //Owner froze word: puts it back unchanged
+            state.store(word, std::memory_order_release);
+        }
+
+        int64_t placeLocked(TransactionType type, uint64_t frozen, int64_t newCents, int64_t timestamp){      //Owner froze the balance at `frozen`: records the change unlogged (the caller logs the operation as a whole) and thaws at the new balance -- returns the time stamped on it
+            int64_t stamped = History.addRecord(type, Money::fromCents(centsOf(frozen)), Money::fromCents(newCents - centsOf(frozen)), timestamp);
+            appliedSequence = following(sequenceOf(frozen));
+            state.store(pack(newCents, appliedSequence) | ownerBit, std::memory_order_release);
+            return stamped;
+        }
+
+        template<typename Rule>
+        bool update(TransactionType type, Rule&& rule, int64_t timestamp){      //CAS loop: rule(oldCents, newCents) checks the exact balance the CAS replaces -- the CAS also takes the owner bit, so a change that finds it clear records itself straight away and any other is queued behind the owner
+            auto admitted = WriteAheadLog::admit(journal);
+            uint64_t seen = state.load(std::memory_order_acquire), wanted;
+
+            do{
+                if(seen & frozenBit){                       //Thawed again before its owner lets go
+                    seen = awaitClear(frozenBit);
+                }
+
+                int64_t newCents;
+
+                if(!rule(centsOf(seen), newCents)){
+                    return false;
+                }
+
+                wanted = pack(newCents, following(sequenceOf(seen))) | ownerBit;
+            } while(!state.compare_exchange_weak(seen, wanted, std::memory_order_acq_rel, std::memory_order_acquire));
+
+            if(!(seen & ownerBit)){                         //Ours now, and nothing accepted ahead of it is still on its way
+                uint64_t logSequence = recordChange(type, centsOf(seen), centsOf(wanted), timestamp, sequenceOf(wanted));
+                release();
+                WriteAheadLog::adopt(logSequence);
+                return true;
+            }
+
+            PendingRecord record{nullptr, type, sequenceOf(wanted), centsOf(seen), centsOf(wanted), timestamp, 0, {false}};
+            record.next = pending.load(std::memory_order_relaxed);
+
+            while(!pending.compare_exchange_weak(record.next, &record, std::memory_order_release, std::memory_order_relaxed));
+
+            pending.notify_all();                           //The owner may be in catchUp() waiting for exactly this record
+
+            while(true){                                    //The owner can't let go before recording it, so just sleep until it has
+                uint32_t ticket = wakeups.load(std::memory_order_acquire);
+
+                if(record.done.load(std::memory_order_acquire)){
+                    break;
+                }
+
+                wakeups.wait(ticket, std::memory_order_acquire);
+            }
+
+            WriteAheadLog::adopt(record.logSequence);
+            return true;
+        }
+
+        template<typename> friend class PolicyAccount;     //Transfers freeze and record on a second account of any policy
+
+    public:
+        class LockSet{                                      //Owns a group of sub-accounts, always taken in address order so two groups can never each wait on the other
+            private:
+                vector<SubAccount*> members;
+
+            public:
+                explicit LockSet(vector<SubAccount*> accounts) : members(std::move(accounts)) {
+                    std::sort(members.begin(), members.end(), std::less<SubAccount*>());
+                    members.erase(std::unique(members.begin(), members.end()), members.end());
+
+                    for(SubAccount* account : members){
+                        account -> acquire();
+                    }
+                }
+
+                ~LockSet(){
+                    for(size_t i = members.size(); i > 0; i--){
+                        members[i - 1] -> release();
+                    }
+                }
+
+                LockSet(const LockSet&) = delete;
+                LockSet& operator=(const LockSet&) = delete;
+        };
+
+        SubAccount() : History(), state(pack(0, 0)), pending(nullptr), wakeups(0), sleepers(0), parked(nullptr), appliedSequence(0), journal(nullptr), owner(), code('?') {}             //Simple constructor to initialize balance and history
+
+        void attachJournal(WriteAheadLog* log, std::string_view ownerName, char accountCode){
+            journal = log;
+            owner = ownerName;
+            code = accountCode;
+        }
+
+        void showHistory(std::ostream& out){            //Renders the history as text through a per-thread buffer, one large write instead of a stream call per field
+            static thread_local HistoryRenderer renderer;
+            OpTimer timer(MetricOp::History);
+            HistoryGuard guard(*this);
+            renderer.render(History, RenderFormat::Text, out);
+        }
+
+        void renderHistory(HistoryRenderer& renderer, RenderFormat format, std::ostream& out) const{
+            OpTimer timer(MetricOp::History);
+            HistoryGuard guard(*this);
+            renderer.render(History, format, out);
+        }
+
+        Money getBalance() const{                            //Getter for balance, one load with no lock
+            return Money::fromCents(centsOf(state.load(std::memory_order_acquire)));
+        }
+
+        size_t historySize() const{
+            HistoryGuard guard(*this);
+            return History.size();
+        }
+
+        template<typename Visitor>
+        size_t readHistory(Visitor&& visit, size_t limit = SIZE_MAX) const{          //Chronological walk under the account lock, stops after `limit` records; returns how many were visited
+            HistoryGuard guard(*this);
+            size_t visited = 0;
+
+            History.forEach([&](const Transaction& record){
+                if(visited < limit){
+                    visit(record);
+                    visited++;
+                }
+            });
+
+            return visited;
+        }
+
+        Money balanceAsOf(int64_t micros) const{
+            HistoryGuard guard(*this);
+            return History.balanceAsOf(micros);
+        }
+
+        template<typename Visitor>
+        size_t readHistoryBetween(int64_t from, int64_t to, Visitor&& visit) const{        //Records stamped in [from, to] under the account lock
+            HistoryGuard guard(*this);
+            return History.forEachBetween(from, to, visit);
+        }
+
+        HistorySummary summarizeHistory() const{        //Totals, counts and balance range straight off the history columns
+            HistoryGuard guard(*this);
+            return History.summarize();
+        }
+
+        std::pair<Money, size_t> readState(){           //Balance and record count taken together, so a snapshot's balance always matches its history prefix -- the balance is frozen while changes in flight land
+            HistoryGuard guard(*this);
+            uint64_t word = freezeLocked();
+            std::pair<Money, size_t> taken(Money::fromCents(centsOf(word)), History.size());
+            thawLocked(word);
+            return taken;
+        }
+
+        void restore(const SnapshotBalance& saved, const SnapshotRecord* records){         //Replace balance and history with a snapshot's copy, nothing is logged
+            HistoryGuard guard(*this);
+            History.clear();
+
+            for(uint64_t i = 0; i < saved.recordCount; i++){
+                const SnapshotRecord& record = records[saved.firstRecord + i];
+                History.addRecord(TransactionType(record.type), Money::fromCents(record.oldCents), Money::fromCents(record.changeCents), record.timestampMicros);
+            }
+
+            state.store(pack(saved.balanceCents, appliedSequence) | ownerBit, std::memory_order_release);
+        }
+
+        template<typename Source>
+        bool rebuild(Money finalBalance, uint64_t records, Source&& next){     //Replace balance and history with records pulled one at a time from next(type, old, change, time) -- nothing is logged, false if the source ran dry
+            HistoryGuard guard(*this);
+            History.clear();
+            TransactionType type;
+            Money oldBalance, change;
+            int64_t timestamp;
+
+            for(uint64_t i = 0; i < records; i++){
+                if(!next(type, oldBalance, change, timestamp)){
+                    return false;
+                }
+
+                History.addRecord(type, oldBalance, change, timestamp);
+            }
+
+            state.store(pack(finalBalance.getCents(), appliedSequence) | ownerBit, std::memory_order_release);
+            return true;
+        }
+
+        bool commitJournal(){                           //Acknowledge point for the interactive flow, false if the change can't be made durable
+            return journal == nullptr || journal -> commit();
+        }
+};
+
+struct CheckingPolicy{                                      //Account rules as compile-time constants, PolicyAccount reads these instead of dispatching through a vtable
+    static constexpr Money minimumBalance = Money();
+    static constexpr Money overdraft = Money::dollars(20);              //Allow down to $20 negative balance
+    static constexpr Money maxTransaction = Money::dollars(5000);       //Typical maximum transaction size
+    static constexpr Money openingDeposit = Money();
+};
+
+struct SavingsPolicy{
+    static constexpr Money minimumBalance = Money::dollars(10);         //Require minimum $10 balance
+    static constexpr Money overdraft = Money();
+    static constexpr Money maxTransaction = Money::dollars(5000);
+    static constexpr Money openingDeposit = Money::dollars(10);         //Initial deposit on creation (not getting rid of this feature)
+};
+
+template<typename Policy>
+class PolicyAccount : public SubAccount{                    //Deposit/withdraw with the limits baked in at compile time, so the hot path inlines with no virtual call
+    private:
+        static constexpr int64_t floorCents = Policy::minimumBalance.getCents() - Policy::overdraft.getCents();      //Lowest balance a withdrawal may leave
+        static constexpr int64_t maxCents = Policy::maxTransaction.getCents();
+
+    public:
+        PolicyAccount() : SubAccount() {
+            if constexpr(Policy::openingDeposit > Money()){
+                state.store(pack(Policy::openingDeposit.getCents(), 0), std::memory_order_relaxed);
+                History.addRecord(TransactionType::Deposit, Money(), Policy::openingDeposit);
+            }
+        }
+
+        static constexpr Money depositLimit(){              //Largest single deposit
+            return Policy::maxTransaction;
+        }
+
+        Money withdrawLimit() const{                        //Largest withdrawal allowed right now (never negative)
+            int64_t headroom = getBalance().getCents() - floorCents;
+            return Money::fromCents(std::max<int64_t>(0, std::min(headroom, maxCents)));
+        }
+
+        OpResult applyDeposit(Money depositAmount, int64_t timestamp = 0){         //Non-interactive deposit, same bounds validate() enforces at the prompt
+            OpTimer timer(MetricOp::Deposit);
+            int64_t amount = depositAmount.getCents();
+
+            if((amount <= 0) | (amount > maxCents)){                 //Non-short-circuit on purpose, one branch for both checks
+                return timer.result(OpResult::OutOfBounds);
+            }
+
+            bool accepted = update(TransactionType::Deposit, [amount](int64_t cents, int64_t& newCents){
+                newCents = cents + amount;
+                return newCents <= balanceLimit;
+            }, timestamp);
+
+            return accepted ? OpResult::Ok : timer.result(OpResult::OutOfBounds);
+        }
+
+        OpResult applyWithdraw(Money withdrawAmount, int64_t timestamp = 0){       //Non-interactive withdraw, can't take the balance below the policy floor -- checked against the exact balance the CAS replaces
+            OpTimer timer(MetricOp::Withdraw);
+            int64_t amount = withdrawAmount.getCents();
+
+            if((amount <= 0) | (amount > maxCents)){
+                return timer.result(OpResult::OutOfBounds);
+            }
+
+            bool accepted = update(TransactionType::Withdrawal, [amount](int64_t cents, int64_t& newCents){
+                newCents = cents - amount;
+                return newCents >= floorCents;
+            }, timestamp);
+
+            return accepted ? OpResult::Ok : timer.result(OpResult::OutOfBounds);
+        }
+
+        template<typename Target>
+        OpResult transfer(PolicyAccount<Target>& target, Money amount, int64_t timestamp = 0){        //Moves amount from here to target as one operation, taking both history locks in address order so opposite transfers can't deadlock
+            if(static_cast<SubAccount*>(&target) == this){
+                Metrics::reject(MetricOp::Transfer, OpResult::SameAccount);
+                return OpResult::SameAccount;
+            }
+
+            SubAccount* first = std::less<SubAccount*>()(this, &target) ? static_cast<SubAccount*>(this) : &target;
+            SubAccount* second = first == this ? static_cast<SubAccount*>(&target) : this;
+            auto admitted = WriteAheadLog::admit(journal);
+            HistoryGuard firstGuard(*first);
+            HistoryGuard secondGuard(*second);
+            return transferLocked(target, amount, timestamp);
+        }
+
+        template<typename Target>
+        OpResult transferLocked(PolicyAccount<Target>& target, Money transferAmount, int64_t timestamp = 0){      //Caller is admitted to the log and holds both history locks: a TransferOut here and a TransferIn on target stamped the same time, logged as one TRANSFER line
+            OpTimer timer(MetricOp::Transfer);
+            int64_t amount = transferAmount.getCents();
+
+            if(static_cast<SubAccount*>(&target) == this){
+                return timer.result(OpResult::SameAccount);
+            }
+
+            if((amount <= 0) | (amount > std::min(maxCents, Target::maxTransaction.getCents()))){
+                return timer.result(OpResult::OutOfBounds);
+            }
+
+            uint64_t debitWord = freezeLocked();             //Neither balance moves until both sides are checked and recorded
+            uint64_t creditWord = target.freezeLocked();
+            int64_t debitCents = centsOf(debitWord);
+            int64_t creditCents = centsOf(creditWord);
+
+            if(debitCents - amount < floorCents || creditCents + amount > balanceLimit){        //Both sides checked before either changes, so a refused transfer leaves no trace
+                thawLocked(debitWord);
+                target.thawLocked(creditWord);
+                return timer.result(OpResult::OutOfBounds);
+            }
+
+            timestamp = placeLocked(TransactionType::TransferOut, debitWord, debitCents - amount, timestamp);        //Both halves and the log get the same time, so replay stamps them the same way
+            target.placeLocked(TransactionType::TransferIn, creditWord, creditCents + amount, timestamp);
+
+            if(journal != nullptr){                         //Still under both locks, so the line lands between the same neighbours in the log as the records do in each history
+                journal -> append("TRANSFER " + string(owner) + " " + code + " " + string(target.owner) + " " + target.code + " " + transferAmount.toString() + " at=" + std::to_string(timestamp));
+            }
+
+            return OpResult::Ok;
+        }
+};
+
+using CheckingAccount = PolicyAccount<CheckingPolicy>;
+using SavingsAccount = PolicyAccount<SavingsPolicy>;
+
+class InlineName{                                       //Username kept inside the account node -- 20 characters is the enforced maximum, so no account field ever touches the heap
+    private:
+        static constexpr size_t capacity = 20;
+        char text[capacity];
+        uint8_t length;
+
+    public:
+        explicit InlineName(std::string_view value) : length(uint8_t(std::min(value.size(), capacity))) {        //Callers validate lengths first, anything longer is cut at 20
+            memcpy(text, value.data(), length);
+        }
+
+        std::string_view view() const{
+            return std::string_view(text, length);
+        }
+
+        bool operator==(std::string_view other) const{
+            return view() == other;
+        }
+};
+
+class BankAccount{              //Account class, includes username, password hash, checking account, savings account, and next pointer
+    private:
+        InlineName username;
+        PasswordHash credential;                //Never the password itself, see PasswordHasher
+        CheckingAccount checking;
+        SavingsAccount savings;
+        BankAccount* next;
+        BankAccount* previous;                  //Back pointer so AccountList can unlink an indexed account without walking to it
+        WriteAheadLog* journal;
+        mutable std::mutex credentials;         //Guards credential only, balances have their own locks
+        std::atomic<int> pins;                  //AccountList holds one, every AccountHandle holds one -- whoever drops the last frees the account
+
+    public:
+        BankAccount(std::string_view accountName, const PasswordHash& accountCredential, WriteAheadLog* log = nullptr) : username(accountName), credential(accountCredential), checking(), savings(), next(nullptr), previous(nullptr), journal(log), pins(1) {       //Constructor for all private members, only takes name/password hash (and the bank's log, if any)
+            checking.attachJournal(log, username.view(), 'C');
+            savings.attachJournal(log, username.view(), 'S');
+        }
+
+        BankAccount(const BankAccount&) = delete;               //Sub-accounts point back at username
+        BankAccount& operator=(const BankAccount&) = delete;
+
+        static void* operator new(size_t size, const std::nothrow_t&) noexcept{         //Nodes come from the pool, a failed allocation yields nullptr instead of throwing
+            return NodePool::allocate(BlockSizes::classFor(size));
+        }
+
+        static void operator delete(void* account, size_t size) noexcept{
+            NodePool::release(account, BlockSizes::classFor(size));
+        }
+
+        static void operator delete(void* account, const std::nothrow_t&) noexcept{     //Only reached if the constructor throws
+            NodePool::release(account, BlockSizes::classFor(sizeof(BankAccount)));
+        }
+
+        std::string_view getUsername() const{   //Getters for username, password, and next pointer -- the name never changes, so a view of it stays valid as long as the account does
+            return username.view();
+        }
+
+        PasswordHash getCredential() const{     //A copy, since setCredential may change it once the lock is released
+            std::lock_guard<std::mutex> guard(credentials);
+            return credential;
+        }
+
+        bool checkPassword(std::string_view attempt) const{         //The KDF runs on that copy, outside the lock
+            return PasswordHasher::verify(getCredential(), attempt);
+        }
+
+        bool hasCredential(const PasswordHash& expected) const{     //Still the hash a caller verified against, i.e. the password hasn't changed since
+            std::lock_guard<std::mutex> guard(credentials);
+            return memcmp(&credential, &expected, sizeof(credential)) == 0;
+        }
+
+        void pin(){
+            pins.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        bool unpin(){                           //True when that was the last reference and the caller must delete
+            return pins.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
+
+        void setPassword(std::string_view newPass){     //Hashed before the lock is taken
+            setCredential(PasswordHasher::hash(newPass));
+        }
+
+        void setCredential(const PasswordHash& newCredential){
+            auto admitted = WriteAheadLog::admit(journal);
+            std::lock_guard<std::mutex> guard(credentials);
+
+            if(journal != nullptr){                     //The hash is logged, never the password, so replay installs the same one without redoing the KDF
+                journal -> append("SETHASH " + string(username.view()) + " " + encodeHash(newCredential));
+            }
+
+            credential = newCredential;
+        }
+
+        void setJournal(WriteAheadLog* log){
+            journal = log;
+            checking.attachJournal(log, username.view(), 'C');
+            savings.attachJournal(log, username.view(), 'S');
+        }
+
+        BankAccount* getNext(){
+            return next;
+        }
+
+        void setNext(BankAccount* newNext){             //Setter for next pointer
+            next = newNext;
+        }
+
+        BankAccount* getPrevious(){
+            return previous;
+        }
+
+        void setPrevious(BankAccount* newPrevious){
+            previous = newPrevious;
+        }
+
+        CheckingAccount& getChecking(){                 //Typed access for the menus, which need each account's own limits
+            return checking;
+        }
+
+        SavingsAccount& getSavings(){
+            return savings;
+        }
+
+        SubAccount* getSubAccount(char accountChoice){          //C/c for checking, S/s for savings, nullptr for anything else
+            if(accountChoice == 'C' || accountChoice == 'c'){
+                return &checking;
+            }
+
+            if(accountChoice == 'S' || accountChoice == 's'){
+                return &savings;
+            }
+
+            return nullptr;
+        }
+
+        OpResult deposit(char accountChoice, Money amount, int64_t timestamp = 0){     //Non-interactive deposit into C or S, resolved statically per account type; timestamp 0 is now
+            if(accountChoice == 'C' || accountChoice == 'c'){
+                return checking.applyDeposit(amount, timestamp);
+            }
+
+            if(accountChoice == 'S' || accountChoice == 's'){
+                return savings.applyDeposit(amount, timestamp);
+            }
+
+            return OpResult::NotFound;
+        }
+
+        OpResult withdraw(char accountChoice, Money amount, int64_t timestamp = 0){
+            if(accountChoice == 'C' || accountChoice == 'c'){
+                return checking.applyWithdraw(amount, timestamp);
+            }
+
+            if(accountChoice == 'S' || accountChoice == 's'){
+                return savings.applyWithdraw(amount, timestamp);
+            }
+
+            return OpResult::NotFound;
+        }
+
+        template<typename Operation>
+        OpResult withPair(char fromChoice, BankAccount& target, char toChoice, Operation&& operation){      //operation(from, to) on the typed sub-accounts, NotFound for anything but C/S on either side
+            auto withTarget = [&](auto& from){
+                if(toChoice == 'C' || toChoice == 'c'){
+                    return operation(from, target.checking);
+                }
+
+                if(toChoice == 'S' || toChoice == 's'){
+                    return operation(from, target.savings);
+                }
+
+                return OpResult::NotFound;
+            };
+
+            if(fromChoice == 'C' || fromChoice == 'c'){
+                return withTarget(checking);
+            }
+
+            if(fromChoice == 'S' || fromChoice == 's'){
+                return withTarget(savings);
+            }
+
+            return OpResult::NotFound;
+        }
+
+        OpResult transfer(char fromChoice, BankAccount& target, char toChoice, Money amount, int64_t timestamp = 0){       //C/S here to C/S on target, which may be this same account
+            return withPair(fromChoice, target, toChoice, [amount, timestamp](auto& from, auto& to){
+                return from.transfer(to, amount, timestamp);
+            });
+        }
+
+        OpResult transferLocked(char fromChoice, BankAccount& target, char toChoice, Money amount){        //Same, for a caller already holding both history locks
+            return withPair(fromChoice, target, toChoice, [amount](auto& from, auto& to){
+                return from.transferLocked(to, amount);
+            });
+        }
+};
+
+class AccountHandle{                                    //Pins a BankAccount for as long as it's held, so a concurrent deleteAccount can unlink it but not free it
+    private:
+        BankAccount* account;
+
+    public:
+        AccountHandle() : account(nullptr) {}
+
+        explicit AccountHandle(BankAccount* pinned) : account(pinned) {}      //Takes over a pin the caller already added
+
+        AccountHandle(AccountHandle&& other) noexcept : account(other.account) {
+            other.account = nullptr;
+        }
+
+        AccountHandle& operator=(AccountHandle&& other) noexcept{
+            std::swap(account, other.account);
+            return *this;
+        }
+
+        AccountHandle(const AccountHandle&) = delete;
+        AccountHandle& operator=(const AccountHandle&) = delete;
+
+        ~AccountHandle(){
+            if(account != nullptr && account -> unpin()){
+                delete account;
+            }
+        }
+
+        BankAccount* operator->() const{
+            return account;
+        }
+
+        BankAccount* get() const{
+            return account;
+        }
+
+        explicit operator bool() const{
+            return account != nullptr;
+        }
+};
+
+class AccountIndex{                                     //Open-addressing (linear probing) hash table on username, kept alongside AccountList so lookups don't walk the list
+    private:
+        struct Slot{
+            size_t hash;
+            BankAccount* account;                           //nullptr with deleted == false marks an empty slot
+            bool deleted;                                   //Tombstone, keeps probe chains intact after a removal
+        };
+
+        vector<Slot> slots;
+        size_t live;                                        //Accounts currently indexed
+        size_t occupied;                                    //Live slots plus tombstones, drives the resize check
+
+        size_t findSlot(std::string_view username, size_t hash) const{        //Returns the slot holding username, or slots.size() if it isn't indexed
+            size_t mask = slots.size() - 1;
+
+            for(size_t i = hash & mask; ; i = (i + 1) & mask){
+                const Slot& slot = slots[i];
+
+                if(slot.account == nullptr && !slot.deleted){               //Empty slot ends the probe chain
+                    return slots.size();
+                }
+
+                if(slot.account != nullptr && slot.hash == hash && slot.account -> getUsername() == username){
+                    return i;
+                }
+            }
+        }
+
+        void rehash(size_t newCapacity){                    //Rebuild into a table of newCapacity slots (power of two), dropping tombstones
+            vector<Slot> old;
+            old.swap(slots);
+            slots.assign(newCapacity, Slot{0, nullptr, false});
+            occupied = live;
+
+            size_t mask = newCapacity - 1;
+
+            for(const Slot& slot : old){
+                if(slot.account == nullptr){
+                    continue;
+                }
+
+                size_t i = slot.hash & mask;
+
+                while(slots[i].account != nullptr){
+                    i = (i + 1) & mask;
+                }
+
+                slots[i] = slot;
+            }
+        }
+
+    public:
+        AccountIndex() : slots(16, Slot{0, nullptr, false}), live(0), occupied(0) {}
+
+        static size_t hashName(std::string_view username){  //FNV-1a, usernames are short so this is cheaper than std::hash's setup
+            size_t hash = 1469598103934665603ULL;
+
+            for(unsigned char c : username){
+                hash ^= c;
+                hash *= 1099511628211ULL;
+            }
+
+            return hash;
+        }
+
+        BankAccount* find(std::string_view username) const{
+            size_t i = findSlot(username, hashName(username));
+            return i == slots.size() ? nullptr : slots[i].account;
+        }
+
+        void insert(BankAccount* account){                  //Caller guarantees the username isn't already indexed (createAccount checks accountExists first)
+            if((occupied + 1) * 10 > slots.size() * 7){     //Keep load factor (tombstones included) under 0.7
+                rehash(live * 2 + 2 > slots.size() / 2 ? slots.size() * 2 : slots.size());
+            }
+
+            size_t hash = hashName(account -> getUsername());
+            size_t mask = slots.size() - 1;
+            size_t i = hash & mask;
+
+            while(slots[i].account != nullptr){             //Reuse the first tombstone or empty slot in the chain
+                i = (i + 1) & mask;
+            }
+
+            if(!slots[i].deleted){
+                occupied++;
+            }
+
+            slots[i] = Slot{hash, account, false};
+            live++;
+        }
+
+        void erase(std::string_view username){
+            size_t i = findSlot(username, hashName(username));
+
+            if(i == slots.size()){
+                return;
+            }
+
+            slots[i].account = nullptr;
+            slots[i].deleted = true;
+            live--;
+        }
+
+        size_t size() const{
+            return live;
+        }
+};
+
+class UsernameTree{                                     //B+ tree of accounts ordered by username, kept alongside AccountIndex -- leaves are linked so sorted listings and prefix scans never touch the rest of the bank
+    private:
+        static constexpr size_t maxKeys = 32;               //Per node; a leaf is about five cache lines of pointers
+        static constexpr size_t minKeys = maxKeys / 2;
+
+        struct Node{
+            bool leaf;
+            size_t count;                                   //Accounts in a leaf, separators in a branch
+
+            explicit Node(bool isLeaf) : leaf(isLeaf), count(0) {}
+        };
+
+        struct Leaf : Node{
+            BankAccount* accounts[maxKeys + 1];             //One spare slot so an insert can overflow before it splits
+            Leaf* next;
+            Leaf* previous;
+
+            Leaf() : Node(true), accounts(), next(nullptr), previous(nullptr) {}
+
+            std::string_view name(size_t i) const{
+                return accounts[i] -> getUsername();
+            }
+        };
+
+        struct Branch : Node{
+            string separators[maxKeys + 1];                 //Copies, not pointers, so deleting an account never leaves a dangling separator
+            Node* children[maxKeys + 2];
+
+            Branch() : Node(false), separators(), children() {}
+        };
+
+        struct Split{                                       //What a full child hands up to its parent
+            string separator;
+            Node* right = nullptr;
+        };
+
+        Node* root;
+        size_t members;
+
+        static size_t leafPosition(const Leaf* leaf, std::string_view name){        //First slot whose name is >= name
+            size_t low = 0, high = leaf -> count;
+
+            while(low < high){
+                size_t middle = (low + high) / 2;
+
+                if(leaf -> name(middle) < name){
+                    low = middle + 1;
+
+                } else {
+                    high = middle;
+                }
+            }
+
+            return low;
+        }
+
+        static size_t childIndex(const Branch* branch, std::string_view name){      //Child whose range holds name: separators <= name are to its left
+            return size_t(std::upper_bound(branch -> separators, branch -> separators + branch -> count, name, [](std::string_view key, const string& separator){
+                return key < std::string_view(separator);
+            }) - branch -> separators);
+        }
+
+        static void destroy(Node* node){
+            if(node == nullptr){
+                return;
+            }
+
+            if(node -> leaf){
+                delete static_cast<Leaf*>(node);
+                return;
+            }
+
+            Branch* branch = static_cast<Branch*>(node);
+
+            for(size_t i = 0; i <= branch -> count; i++){
+                destroy(branch -> children[i]);
+            }
+
+            delete branch;
+        }
+
+        bool insertInto(Node* node, BankAccount* account, Split& split){          //False if the name is already present
+            std::string_view name = account -> getUsername();
+
+            if(node -> leaf){
+                Leaf* leaf = static_cast<Leaf*>(node);
+                size_t position = leafPosition(leaf, name);
+
+                if(position < leaf -> count && leaf -> name(position) == name){
+                    return false;
+                }
+
+                std::copy_backward(leaf -> accounts + position, leaf -> accounts + leaf -> count, leaf -> accounts + leaf -> count + 1);
+                leaf -> accounts[position] = account;
+                leaf -> count++;
+
+                if(leaf -> count > maxKeys){                //Upper half moves to a new right sibling
+                    Leaf* right = new Leaf();
+                    size_t keep = leaf -> count / 2;
+
+                    right -> count = leaf -> count - keep;
+                    std::copy(leaf -> accounts + keep, leaf -> accounts + leaf -> count, right -> accounts);
+                    leaf -> count = keep;
+
+                    right -> next = leaf -> next;
+                    right -> previous = leaf;
+
+                    if(leaf -> next != nullptr){
+                        leaf -> next -> previous = right;
+                    }
+
+                    leaf -> next = right;
+                    split.separator = right -> name(0);
+                    split.right = right;
+                }
+
+                return true;
+            }
+
+            Branch* branch = static_cast<Branch*>(node);
+            size_t child = childIndex(branch, name);
+            Split below;
+
+            if(!insertInto(branch -> children[child], account, below)){
+                return false;
+            }
+
+            if(below.right == nullptr){
+                return true;
+            }
+
+            std::move_backward(branch -> separators + child, branch -> separators + branch -> count, branch -> separators + branch -> count + 1);
+            std::copy_backward(branch -> children + child + 1, branch -> children + branch -> count + 1, branch -> children + branch -> count + 2);
+            branch -> separators[child] = std::move(below.separator);
+            branch -> children[child + 1] = below.right;
+            branch -> count++;
+
+            if(branch -> count > maxKeys){                  //Middle separator moves up, the right half becomes a new branch
+                Branch* right = new Branch();
+                size_t middle = branch -> count / 2;
+
+                right -> count = branch -> count - middle - 1;
+                std::move(branch -> separators + middle + 1, branch -> separators + branch -> count, right -> separators);
+                std::copy(branch -> children + middle + 1, branch -> children + branch -> count + 1, right -> children);
+                split.separator = std::move(branch -> separators[middle]);
+                split.right = right;
+                branch -> count = middle;
+            }
+
+            return true;
+        }
+
+        void rebalance(Branch* parent, size_t child){       //Child dropped below half full: borrow from a sibling, or merge with one
+            Node* node = parent -> children[child];
+            Node* left = child > 0 ? parent -> children[child - 1] : nullptr;
+            Node* right = child < parent -> count ? parent -> children[child + 1] : nullptr;
+
+            if(node -> leaf){
+                Leaf* leaf = static_cast<Leaf*>(node);
+
+                if(left != nullptr && left -> count > minKeys){
+                    Leaf* donor = static_cast<Leaf*>(left);
+                    std::copy_backward(leaf -> accounts, leaf -> accounts + leaf -> count, leaf -> accounts + leaf -> count + 1);
+                    leaf -> accounts[0] = donor -> accounts[--donor -> count];
+                    leaf -> count++;
+                    parent -> separators[child - 1] = leaf -> name(0);
+                    return;
+                }
+
+                if(right != nullptr && right -> count > minKeys){
+                    Leaf* donor = static_cast<Leaf*>(right);
+                    leaf -> accounts[leaf -> count++] = donor -> accounts[0];
+                    std::copy(donor -> accounts + 1, donor -> accounts + donor -> count, donor -> accounts);
+                    donor -> count--;
+                    parent -> separators[child] = donor -> name(0);
+                    return;
+                }
+
+                size_t merged = right != nullptr ? child : child - 1;       //Fold the right one of the pair into the left one
+                Leaf* into = static_cast<Leaf*>(parent -> children[merged]);
+                Leaf* from = static_cast<Leaf*>(parent -> children[merged + 1]);
+
+                std::copy(from -> accounts, from -> accounts + from -> count, into -> accounts + into -> count);
+                into -> count += from -> count;
+                into -> next = from -> next;
+
+                if(from -> next != nullptr){
+                    from -> next -> previous = into;
+                }
+
+                delete from;
+                removeSeparator(parent, merged);
+                return;
+            }
+
+            Branch* branch = static_cast<Branch*>(node);
+
+            if(left != nullptr && left -> count > minKeys){             //Rotate through the parent's separator
+                Branch* donor = static_cast<Branch*>(left);
+                std::move_backward(branch -> separators, branch -> separators + branch -> count, branch -> separators + branch -> count + 1);
+                std::copy_backward(branch -> children, branch -> children + branch -> count + 1, branch -> children + branch -> count + 2);
+                branch -> separators[0] = std::move(parent -> separators[child - 1]);
+                branch -> children[0] = donor -> children[donor -> count];
+                branch -> count++;
+                parent -> separators[child - 1] = std::move(donor -> separators[donor -> count - 1]);
+                donor -> count--;
+                return;
+            }
+
+            if(right != nullptr && right -> count > minKeys){
+                Branch* donor = static_cast<Branch*>(right);
+                branch -> separators[branch -> count] = std::move(parent -> separators[child]);
+                branch -> children[branch -> count + 1] = donor -> children[0];
+                branch -> count++;
+                parent -> separators[child] = std::move(donor -> separators[0]);
+                std::move(donor -> separators + 1, donor -> separators + donor -> count, donor -> separators);
+                std::copy(donor -> children + 1, donor -> children + donor -> count + 1, donor -> children);
+                donor -> count--;
+                return;
+            }
+
+            size_t merged = right != nullptr ? child : child - 1;
+            Branch* into = static_cast<Branch*>(parent -> children[merged]);
+            Branch* from = static_cast<Branch*>(parent -> children[merged + 1]);
+
+            into -> separators[into -> count] = std::move(parent -> separators[merged]);
+            std::move(from -> separators, from -> separators + from -> count, into -> separators + into -> count + 1);
+            std::copy(from -> children, from -> children + from -> count + 1, into -> children + into -> count + 1);
+            into -> count += from -> count + 1;
+            from -> count = 0;
+            delete from;
+            removeSeparator(parent, merged);
+        }
+
+        static void removeSeparator(Branch* parent, size_t separator){            //Drops separator i and the child to its right
+            std::move(parent -> separators + separator + 1, parent -> separators + parent -> count, parent -> separators + separator);
+            std::copy(parent -> children + separator + 2, parent -> children + parent -> count + 1, parent -> children + separator + 1);
+            parent -> count--;
+        }
+
+        bool eraseFrom(Node* node, std::string_view name){
+            if(node -> leaf){
+                Leaf* leaf = static_cast<Leaf*>(node);
+                size_t position = leafPosition(leaf, name);
+
+                if(position == leaf -> count || leaf -> name(position) != name){
+                    return false;
+                }
+
+                std::copy(leaf -> accounts + position + 1, leaf -> accounts + leaf -> count, leaf -> accounts + position);
+                leaf -> count--;
+                return true;
+            }
+
+            Branch* branch = static_cast<Branch*>(node);
+            size_t child = childIndex(branch, name);
+
+            if(!eraseFrom(branch -> children[child], name)){
+                return false;
+            }
+
+            if(branch -> children[child] -> count < minKeys){
+                rebalance(branch, child);
+            }
+
+            return true;
+        }
+
+        const Leaf* seek(std::string_view name, size_t& position) const{         //Leaf and slot of the first account >= name, nullptr past the end
+            const Node* node = root;
+
+            while(!node -> leaf){
+                const Branch* branch = static_cast<const Branch*>(node);
+                node = branch -> children[childIndex(branch, name)];
+            }
+
+            const Leaf* leaf = static_cast<const Leaf*>(node);
+            position = leafPosition(leaf, name);
+
+            while(leaf != nullptr && position == leaf -> count){
+                leaf = leaf -> next;
+                position = 0;
+            }
+
+            return leaf;
+        }
+
+    public:
+        UsernameTree() : root(new Leaf()), members(0) {}
+
+        ~UsernameTree(){
+            destroy(root);
+        }
+
+        UsernameTree(const UsernameTree&) = delete;
+        UsernameTree& operator=(const UsernameTree&) = delete;
+
+        void insert(BankAccount* account){
+            Split split;
+
+            if(!insertInto(root, account, split)){
+                return;
+            }
+
+            members++;
+
+            if(split.right != nullptr){                     //Root split, the tree grows a level
+                Branch* newRoot = new Branch();
+                newRoot -> separators[0] = std::move(split.separator);
+                newRoot -> children[0] = root;
+                newRoot -> children[1] = split.right;
+                newRoot -> count = 1;
+                root = newRoot;
+            }
+        }
+
+        void erase(std::string_view name){
+            if(!eraseFrom(root, name)){
+                return;
+            }
+
+            members--;
+
+            if(!root -> leaf && root -> count == 0){       //Root branch down to one child, the tree shrinks a level
+                Branch* oldRoot = static_cast<Branch*>(root);
+                root = oldRoot -> children[0];
+                delete oldRoot;
+            }
+        }
+
+        template<typename Visitor>
+        size_t scan(std::string_view prefix, std::string_view after, size_t limit, Visitor&& visit) const{     //Up to limit accounts starting with prefix and sorting after `after`, in order -- returns how many were visited
+            size_t position;
+            const Leaf* leaf = seek(std::max(prefix, after), position);
+            size_t visited = 0;
+
+            while(leaf != nullptr && visited < limit){
+                std::string_view name = leaf -> name(position);
+
+                if(name.substr(0, prefix.size()) != prefix){            //Sorted, so the first miss ends the prefix range
+                    break;
+                }
+
+                if(after.empty() || name != after){
+                    visit(leaf -> accounts[position]);
+                    visited++;
+                }
+
+                if(++position == leaf -> count){
+                    leaf = leaf -> next;
+                    position = 0;
+                }
+            }
+
+            return visited;
+        }
+
+        size_t size() const{
+            return members;
+        }
+};
+
+class AccountList{                                      //Linked list class for bank accounts, includes head/tail pointers, add account function, and display accounts function -- I still think a map was more efficient, but I guess this is simple
+    private:
+        BankAccount* head = nullptr;
+        BankAccount* tail = nullptr;
+        AccountIndex index;                                 //Username -> node, updated by addAccount/deleteAccount
+        UsernameTree ordered;                               //Same accounts in name order, for sorted and paginated listings
+        WriteAheadLog* journal;                             //Optional, creations and deletions are logged here
+        int members;                                        //Literally only used one time to see if any accounts exist, might be unnecessary
+
+        BankAccount* linkAccount(std::string_view username, const PasswordHash& credential){       //In order: Construct new account via pointer, append it at the tail, index it, increment members -- nullptr if allocation failed
+            BankAccount* newAccount = new (std::nothrow) BankAccount(username, credential, journal);
+
+            if(newAccount == nullptr){                      //Failure handling if the pool cannot map more memory
+                cout << "Error in account memory allocation: out of memory\n";
+                return nullptr;
+            }
+
+            return link(newAccount);
+        }
+
+        BankAccount* link(BankAccount* newAccount){
+            if(head == nullptr){                  //If head is null, set both head and tail to new account
+                head = newAccount;
+                tail = newAccount;
+
+            } else {                            //If head is not null, set next pointer of tail to new account, set tail to new account
+                tail -> setNext(newAccount);
+                newAccount -> setPrevious(tail);
+                tail = newAccount;                
+            }
+
+            index.insert(newAccount);
+            ordered.insert(newAccount);
+            members++;
+            return newAccount;
+        }
+
+    public:
+        AccountList() : head(nullptr), tail(nullptr), index(), ordered(), journal(nullptr), members(0) {}             //Simple constructor for head pointer, set members to 0 for consistency
+
+        ~AccountList(){              //Destructor to delete all nodes in list -- Won't actually get used, so far, at least
+            deleteList(head);
+        }
+
+        void addAccount(std::string_view username, const PasswordHash& credential){             //Append a brand new account and log its creation
+            if(linkAccount(username, credential) != nullptr && journal != nullptr){
+                journal -> append("CREATEHASHED " + string(username) + " " + encodeHash(credential));
+            }
+        }
+
+        void adoptAccount(BankAccount* account){        //Link an account that was built outside the list (an import), nothing is logged
+            account -> setJournal(journal);
+            link(account);
+        }
+
+        BankAccount* restoreAccount(std::string_view username, const PasswordHash& credential){        //Append an account that already exists in a snapshot, so nothing is logged
+            return linkAccount(username, credential);
+        }
+
+        OpResult deleteAccount(std::string_view username, const PasswordHash* verified = nullptr){     //Index finds the node and its back pointer unlinks it -- username must not point into the account
+            BankAccount* current = index.find(username);
+
+            if(current == nullptr || (verified != nullptr && !current -> hasCredential(*verified))){
+                return OpResult::NotFound;
+            }
+
+            BankAccount* previous = current -> getPrevious();
+            BankAccount* next = current -> getNext();
+
+            if(previous == nullptr){                //If head is the account to be deleted, set head to next account (null if N/A)
+                head = next;
+
+            } else {
+                previous -> setNext(next);
+            }
+
+            if(next == nullptr){                    //If tail is the account to be deleted, set tail to previous (null if N/A)
+                tail = previous;
+
+            } else {
+                next -> setPrevious(previous);
+            }
+
+            index.erase(username);
+            ordered.erase(username);
+            members--;
+
+            if(current -> unpin()){                 //Only destroyed here if no AccountHandle still has it, otherwise the last handle does it
+                delete current;                                             //This line calls the BankAccount destructor and destroys the chain of all the info relevant to the account
+            }
+
+            if(journal != nullptr){
+                journal -> append("PURGE " + string(username));
+            }
+
+            return OpResult::Ok;
+        }
+
+        void setJournal(WriteAheadLog* log){            //Attached after replay, so existing accounts are pointed at the log too
+            journal = log;
+
+            for(BankAccount* current = head; current != nullptr; current = current -> getNext()){
+                current -> setJournal(log);
+            }
+        }
+
+        BankAccount* findAccount(std::string_view username) const{        //O(1) lookup through the hash index, nullptr if the username isn't registered
+            return index.find(username);
+        }
+
+        void displayAccounts() const{                //Every account in alphabetical order, straight off the ordered index
+            if (members == 0){
+                cout << "No accounts exist.\n";
+                return;
+
+            } else {
+                cout << "\nAccounts:\n";
+            }
+
+            ordered.scan("", "", ordered.size(), [](const BankAccount* account){
+                cout << account -> getUsername() << "\n";
+            });
+        }
+
+        template<typename Visitor>
+        size_t listAccounts(std::string_view prefix, std::string_view after, size_t limit, Visitor&& visit) const{     //One page of names in order, see UsernameTree::scan
+            return ordered.scan(prefix, after, limit, [&visit](const BankAccount* account){
+                visit(account -> getUsername());
+            });
+        }
+
+        BankAccount* getHead() const{
+            return head;
+        }
+
+        int size() const{
+            return members;
+        }
+};
@@ -0,0 +1,849 @@
+#pragma once                                                        //The bank itself: accounts, transfers, replay and persistence
+
+#include "export.h"
+
+class NameFilter{                                       //Counting Bloom filter over every username the bank holds, so a lookup for a name that doesn't exist usually stops here instead of searching the index and the snapshot
+    private:
+        static constexpr int probes = 6;                    //Counters touched per name, all inside one 64-byte block so a check costs a single cache miss
+        static constexpr size_t countersPerName = 10;       //Before rounding the block count up to a power of two, ~1% false positives at capacity
+        static constexpr uint8_t saturated = 15;            //A counter that reaches this stays there, since its true count is no longer known
+
+        struct alignas(64) Block{
+            uint8_t counters[64] = {};                      //Two 4-bit counters per byte, 128 per block
+        };
+
+        vector<Block> blocks;
+        size_t blockMask;
+        size_t capacity;                                    //Names the filter was sized for, the owner rebuilds it bigger past this
+        size_t count;
+
+        static uint64_t hashName(std::string_view username){       //FNV-1a with a 64-bit finalizer, so the low bits (block) and high bits (counters) are both well mixed
+            uint64_t hash = 1469598103934665603ULL;
+
+            for(unsigned char c : username){
+                hash ^= c;
+                hash *= 1099511628211ULL;
+            }
+
+            hash ^= hash >> 33;
+            hash *= 0xff51afd7ed558ccdULL;
+            hash ^= hash >> 33;
+            hash *= 0xc4ceb9fe1a85ec53ULL;
+            return hash ^ (hash >> 33);
+        }
+
+        template <typename Step>
+        void forEachCounter(std::string_view username, Step&& step){   //Calls step(byte, shift) for each of the name's counters
+            uint64_t hash = hashName(username);
+            Block& block = blocks[hash & blockMask];
+            uint64_t positions = hash * 0x9E3779B97F4A7C15ULL;      //Re-mixed so the counter picks don't depend on which block was chosen
+
+            for(int i = 0; i < probes; i++){
+                unsigned counter = (positions >> (57 - 7 * i)) & 127;
+                step(block.counters[counter >> 1], (counter & 1) * 4);
+            }
+        }
+
+    public:
+        NameFilter(){
+            reset(1024);
+        }
+
+        void reset(size_t expected){                        //Empty filter sized for expected names
+            size_t wanted = std::max<size_t>(1, (std::max<size_t>(expected, 1024) * countersPerName + 127) / 128);
+            size_t size = 1;
+
+            while(size < wanted){
+                size *= 2;
+            }
+
+            blocks.assign(size, Block());
+            blocks.shrink_to_fit();
+            blockMask = size - 1;
+            capacity = std::max<size_t>(expected, 1024);
+            count = 0;
+        }
+
+        void add(std::string_view username){
+            forEachCounter(username, [](uint8_t& byte, unsigned shift){
+                if(((byte >> shift) & 15) != saturated){
+                    byte += uint8_t(1 << shift);
+                }
+            });
+            count++;
+        }
+
+        void remove(std::string_view username){             //Only for names that were added, otherwise other names' counters drop and they start missing
+            forEachCounter(username, [](uint8_t& byte, unsigned shift){
+                unsigned value = (byte >> shift) & 15;
+
+                if(value != saturated && value != 0){
+                    byte -= uint8_t(1 << shift);
+                }
+            });
+            count--;
+        }
+
+        bool mayContain(std::string_view username) const{   //False means definitely absent, true means go and look
+            uint64_t hash = hashName(username);
+            const Block& block = blocks[hash & blockMask];
+            uint64_t positions = hash * 0x9E3779B97F4A7C15ULL;
+
+            for(int i = 0; i < probes; i++){
+                unsigned counter = (positions >> (57 - 7 * i)) & 127;
+
+                if(((block.counters[counter >> 1] >> ((counter & 1) * 4)) & 15) == 0){
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        bool full() const{
+            return count > capacity;
+        }
+
+        size_t size() const{
+            return count;
+        }
+
+        size_t memoryBytes() const{
+            return blocks.size() * sizeof(Block);
+        }
+};
+
+struct TransferOrder{                                    //One entry of a settleTransfers batch, result is filled in
+    std::string_view fromUser;
+    char fromChoice;
+    std::string_view toUser;
+    char toChoice;
+    Money amount;
+    OpResult result;
+};
+
+class Bank{
+    private:
+        std::unique_ptr<WriteAheadLog> journal;     //Optional, see openJournal() -- declared first so it outlives the accounts that point at it
+        mutable std::shared_mutex directory;        //Shared for lookups, exclusive for create/delete/materialize -- balances are guarded per sub-account instead
+        AccountList accounts;                       //Initialize account list
+        std::unique_ptr<Snapshot> snapshot;         //Optional, accounts not touched since startup are still served from here
+        NameFilter names;                           //Every live and unclaimed snapshot username, checked before the index so unknown names skip the snapshot search
+        bool namesReady = true;                     //False while the filter is rebuilt after loadSnapshot, lookups skip it until then
+        vector<std::pair<string, bool>> pendingNames;       //Creates (true) and deletes (false) made during that rebuild, replayed onto the new filter
+        std::thread namesBuilder;
+
+        bool existsLocked(std::string_view username) const{            //Caller holds directory (either mode)
+            if(namesReady && !names.mayContain(username)){
+                return false;
+            }
+
+            return accounts.findAccount(username) != nullptr || (snapshot != nullptr && snapshot -> find(username) >= 0);
+        }
+
+        void nameAdded(std::string_view username){     //Caller holds directory exclusively
+            if(!namesReady){
+                pendingNames.emplace_back(string(username), true);
+                return;
+            }
+
+            names.add(username);
+
+            if(names.full()){
+                rebuildNames();
+            }
+        }
+
+        void nameRemoved(std::string_view username){   //Caller holds directory exclusively
+            if(!namesReady){
+                pendingNames.emplace_back(string(username), false);
+                return;
+            }
+
+            names.remove(username);
+        }
+
+        void rebuildNames(){                        //Caller holds directory exclusively -- resizes to twice the current name count, amortized over the creates that filled it
+            size_t unclaimed = snapshot == nullptr ? 0 : snapshot -> getUnclaimed();
+            names.reset(2 * (accounts.size() + unclaimed));
+            accounts.listAccounts("", "", accounts.size(), [this](std::string_view name){
+                names.add(name);
+            });
+
+            for(size_t i = 0; unclaimed > 0 && i < snapshot -> size(); i++){
+                if(!snapshot -> isClaimed(i)){
+                    names.add(snapshot -> username(i));
+                }
+            }
+        }
+
+        void buildNames(vector<string> live){       //Runs on namesBuilder after loadSnapshot: the table is read-only, so only the final swap needs the lock
+            NameFilter fresh;
+            fresh.reset((live.size() + snapshot -> size()) * 5 / 4);           //Room for some growth before the first resize
+
+            for(const string& name : live){
+                fresh.add(name);
+            }
+
+            for(size_t i = 0; i < snapshot -> size(); i++){        //Nothing is claimed yet as of the load, later claims and deletes arrive through pendingNames
+                fresh.add(snapshot -> username(i));
+            }
+
+            std::unique_lock<std::shared_mutex> guard(directory);
+
+            for(const auto& [name, added] : pendingNames){
+                if(added){
+                    fresh.add(name);
+
+                } else {
+                    fresh.remove(name);
+                }
+            }
+
+            pendingNames.clear();
+            pendingNames.shrink_to_fit();
+            names = std::move(fresh);
+            namesReady = true;
+        }
+
+        BankAccount* findLocked(std::string_view username){            //Caller holds directory exclusively, since this may materialize from the snapshot
+            BankAccount* account = accounts.findAccount(username);
+
+            if(account == nullptr && snapshot != nullptr){
+                long entry = snapshot -> find(username);
+
+                if(entry >= 0){
+                    account = materialize(entry);
+                }
+            }
+
+            return account;
+        }
+
+        BankAccount* materialize(long entry){       //Copy one snapshot account into AccountList the first time it's needed
+            BankAccount* account = accounts.restoreAccount(snapshot -> username(entry), snapshot -> credential(entry));
+
+            if(account == nullptr){
+                return nullptr;
+            }
+
+            account -> getSubAccount('C') -> restore(snapshot -> balance(entry, 0), snapshot -> getRecords());
+            account -> getSubAccount('S') -> restore(snapshot -> balance(entry, 1), snapshot -> getRecords());
+            snapshot -> claim(entry);
+            return account;
+        }
+
+        void logImport(const string& copy, const ExportStats& stats){      //Logged as an IMPORT of the copy kept beside the log, so replay reads exactly what was imported -- the copy is needed until the next SNAPSHOT
+            if(journal == nullptr){
+                return;
+            }
+
+            if(stats.accounts > 0){
+                journal -> append("IMPORT " + copy);
+
+            } else {
+                ::unlink(copy.c_str());
+            }
+        }
+
+        OpResult insertAccount(std::string_view username, const PasswordHash& credential){         //Check and insert under one lock so two sessions can't claim the same name
+            std::unique_lock<std::shared_mutex> guard(directory);
+
+            if(existsLocked(username)){
+                return OpResult::AlreadyExists;
+            }
+
+            accounts.addAccount(username, credential);
+            nameAdded(username);
+            return OpResult::Ok;
+        }
+
+        static void copyFixed(char (&destination)[24], std::string_view text){
+            memset(destination, 0, sizeof(destination));
+            memcpy(destination, text.data(), std::min(text.size(), sizeof(destination) - 1));
+        }
+
+    public:
+        ~Bank(){
+            if(namesBuilder.joinable()){
+                namesBuilder.join();
+            }
+        }
+
+        void waitForNameFilter(){                   //Blocks until the filter rebuild started by loadSnapshot is done, lookups are correct either way
+            if(namesBuilder.joinable()){
+                namesBuilder.join();
+            }
+        }
+
+        bool accountExists(std::string_view username){                            //Check the username index, then the snapshot table, without materializing anything
+            std::shared_lock<std::shared_mutex> guard(directory);
+            return existsLocked(username);
+        }
+
+        void addAccount(std::string_view username, std::string_view password){             //Create new account by appending to list
+            PasswordHash credential = PasswordHasher::hash(password);
+            std::unique_lock<std::shared_mutex> guard(directory);
+            accounts.addAccount(username, credential);
+            nameAdded(username);
+        }
+
+        AccountHandle acquire(std::string_view username){                 //Pinned account (empty if unknown) -- stays valid even if another thread deletes it meanwhile
+            {
+                std::shared_lock<std::shared_mutex> guard(directory);
+
+                if(namesReady && !names.mayContain(username)){         //Unknown name, don't bother with the index or the exclusive lock below
+                    return AccountHandle();
+                }
+
+                BankAccount* account = accounts.findAccount(username);
+
+                if(account != nullptr){
+                    account -> pin();
+                    return AccountHandle(account);
+                }
+
+                if(snapshot == nullptr){
+                    return AccountHandle();
+                }
+            }
+
+            std::unique_lock<std::shared_mutex> guard(directory);          //Rare path: first touch of a snapshot account, lookup again since the lock was dropped
+            BankAccount* account = findLocked(username);
+
+            if(account == nullptr){
+                return AccountHandle();
+            }
+
+            account -> pin();
+            return AccountHandle(account);
+        }
+
+        bool loadSnapshot(const string& path){      //Maps the file only, so startup cost doesn't grow with the number of accounts -- load before replaying the log
+            if(namesBuilder.joinable()){            //A previous load's filter build reads the old table, let it finish first
+                namesBuilder.join();
+            }
+
+            std::unique_lock<std::shared_mutex> guard(directory);
+            snapshot = Snapshot::open(path);
+
+            if(snapshot == nullptr){
+                return false;
+            }
+
+            vector<string> live;                    //Usually empty, the snapshot is loaded before anything is created
+            live.reserve(accounts.size());
+            accounts.listAccounts("", "", accounts.size(), [&live](std::string_view name){
+                live.emplace_back(name);
+            });
+
+            namesReady = false;                     //The name filter is rebuilt in the background, lookups go straight to the table until it's done
+            namesBuilder = std::thread(&Bank::buildNames, this, std::move(live));
+            return true;
+        }
+
+        uint64_t snapshotJournalOffset() const{
+            return snapshot == nullptr ? 0 : snapshot -> getJournalOffset();
+        }
+
+        bool writeSnapshot(const string& path){     //Writes live accounts plus any still-unclaimed snapshot accounts to path (via a temp file and rename)
+            struct Entry{
+                std::string_view username;
+                AccountHandle live;                 //Empty means "copy from the current snapshot", pinned so a delete after the capture can't free it under the writer
+                long snapshotIndex;
+                PasswordHash credential;
+                std::pair<Money, size_t> state[2];  //Balance and history length as of the capture, the records past it are replayed from the log
+            };
+
+            vector<Entry> entries;
+            uint64_t recordCount = 0;
+            SnapshotHeader header{};
+
+            {
+                std::unique_lock<std::shared_mutex> guard(directory);          //Freezes the account set, and the fence freezes balances and credentials, only for as long as the capture takes
+                auto fence = journal == nullptr ? std::unique_lock<std::shared_mutex>() : journal -> quiesce();
+                entries.reserve(accounts.size() + (snapshot == nullptr ? 0 : snapshot -> getUnclaimed()));
+
+                for(BankAccount* current = accounts.getHead(); current != nullptr; current = current -> getNext()){
+                    current -> pin();
+                    entries.push_back(Entry{current -> getUsername(), AccountHandle(current), -1, current -> getCredential(), {current -> getSubAccount('C') -> readState(), current -> getSubAccount('S') -> readState()}});
+                    recordCount += entries.back().state[0].second + entries.back().state[1].second;
+                }
+
+                if(snapshot != nullptr){
+                    for(size_t i = 0; i < snapshot -> size(); i++){
+                        if(!snapshot -> isClaimed(i)){
+                            entries.push_back(Entry{snapshot -> username(i), AccountHandle(), long(i), snapshot -> credential(i), {}});
+                            recordCount += snapshot -> balance(i, 0).recordCount + snapshot -> balance(i, 1).recordCount;
+                        }
+                    }
+                }
+
+                header.journalOffset = journal == nullptr ? 0 : journal -> endOffset();        //Every record before this is in the capture and none after it is
+            }
+
+            if(journal != nullptr && !journal -> flushAll()){          //A snapshot past a hole in the log would skip records replay can't find
+                return false;
+            }
+
+            std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b){
+                return a.username < b.username;
+            });
+
+            string temporary = path + ".tmp";
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+            if(!file){
+                return false;
+            }
+
+            memcpy(header.magic, "BANKSNP3", 8);
+            header.accountCount = entries.size();
+            header.recordCount = recordCount;
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+            for(const Entry& entry : entries){
+                SnapshotAccount row;
+                copyFixed(row.username, entry.username);
+                row.credential = entry.credential;
+                file.write(reinterpret_cast<const char*>(&row), sizeof(row));
+            }
+
+            uint64_t nextRecord = 0;
+
+            for(const Entry& entry : entries){
+                for(size_t sub = 0; sub < 2; sub++){
+                    SnapshotBalance saved{};
+                    saved.firstRecord = nextRecord;
+
+                    if(entry.live){
+                        saved.balanceCents = entry.state[sub].first.getCents();
+                        saved.recordCount = entry.state[sub].second;
+
+                    } else {
+                        saved.balanceCents = snapshot -> balance(entry.snapshotIndex, sub).balanceCents;
+                        saved.recordCount = snapshot -> balance(entry.snapshotIndex, sub).recordCount;
+                    }
+
+                    nextRecord += saved.recordCount;
+                    file.write(reinterpret_cast<const char*>(&saved), sizeof(saved));
+                }
+            }
+
+            for(const Entry& entry : entries){
+                for(size_t sub = 0; sub < 2; sub++){
+                    if(entry.live){
+                        entry.live -> getSubAccount(sub == 0 ? 'C' : 'S') -> readHistory([&file](const Transaction& record){
+                            SnapshotRecord packed{};
+                            packed.oldCents = record.getOldBalance().getCents();
+                            packed.changeCents = record.getBalanceChange().getCents();
+                            packed.timestampMicros = record.getTimestamp();
+                            packed.type = uint8_t(record.getType());
+                            file.write(reinterpret_cast<const char*>(&packed), sizeof(packed));
+                        }, entry.state[sub].second);
+
+                    } else {
+                        const SnapshotBalance& saved = snapshot -> balance(entry.snapshotIndex, sub);
+                        file.write(reinterpret_cast<const char*>(snapshot -> getRecords() + saved.firstRecord), saved.recordCount * sizeof(SnapshotRecord));
+                    }
+                }
+            }
+
+            file.close();
+
+            if(!file){
+                ::unlink(temporary.c_str());
+                return false;
+            }
+
+            return replaceDurably(temporary, path);         //Replay skips the log up to this file's offset, so all of it has to be on disk before it replaces the old one
+        }
+
+        bool exportAccounts(const string& path, std::string_view username, ExportStats& stats){      //One account, or the whole bank when username is empty, streamed to path in the export format (via a temp file and rename)
+            string temporary = path + ".tmp";
+            ExportWriter writer(temporary);
+
+            if(!writer.isOpen()){
+                return false;
+            }
+
+            auto exportLive = [&writer, &stats](BankAccount* account){     //Balance and history length captured together, as in writeSnapshot
+                writer.beginAccount(account -> getUsername(), account -> getCredential());
+
+                for(SubAccount* sub : {static_cast<SubAccount*>(&account -> getChecking()), static_cast<SubAccount*>(&account -> getSavings())}){
+                    auto [balance, records] = sub -> readState();
+                    writer.beginSubAccount(balance, records);
+                    sub -> readHistory([&writer](const Transaction& record){
+                        writer.putRecord(record);
+                    }, records);
+                    stats.records += records;
+                }
+
+                stats.accounts++;
+            };
+
+            if(!username.empty()){
+                AccountHandle account = acquire(username);
+
+                if(!account){
+                    return false;
+                }
+
+                exportLive(account.get());
+
+            } else {
+                std::shared_lock<std::shared_mutex> guard(directory);          //Holds the account set still, snapshot claims need the exclusive lock so the table can be read too
+
+                for(BankAccount* current = accounts.getHead(); current != nullptr; current = current -> getNext()){
+                    exportLive(current);
+                }
+
+                for(size_t i = 0; snapshot != nullptr && i < snapshot -> size(); i++){      //Accounts nobody has touched since startup come straight from the mapped table
+                    if(snapshot -> isClaimed(i)){
+                        continue;
+                    }
+
+                    writer.beginAccount(snapshot -> username(i), snapshot -> credential(i));
+
+                    for(size_t sub = 0; sub < 2; sub++){
+                        const SnapshotBalance& saved = snapshot -> balance(i, sub);
+                        writer.beginSubAccount(Money::fromCents(saved.balanceCents), saved.recordCount);
+
+                        for(uint64_t r = 0; r < saved.recordCount; r++){
+                            const SnapshotRecord& record = snapshot -> getRecords()[saved.firstRecord + r];
+                            writer.putRecord(TransactionType(record.type), record.oldCents, record.changeCents, record.timestampMicros);
+                        }
+
+                        stats.records += saved.recordCount;
+                    }
+
+                    stats.accounts++;
+                }
+            }
+
+            bool written = writer.finish();
+            stats.bytes = writer.bytesWritten();
+
+            if(!written){
+                ::unlink(temporary.c_str());
+                return false;
+            }
+
+            return replaceDurably(temporary, path);
+        }
+
+        bool importAccounts(const string& path, ExportStats& stats){      //Adds every exported account whose name is free, records go straight from the read buffer into the new histories
+            string source = path;
+
+            if(journal != nullptr && !journal -> preserve(path, source)){          //Read from the copy the log will name, so what replay imports is what was imported here
+                return false;
+            }
+
+            ExportReader reader(source);
+
+            while(reader.ok() && reader.nextAccount()){
+                BankAccount* account = new (std::nothrow) BankAccount(reader.getUsername(), reader.getCredential());        //Filled before it's linked, so nobody sees it half imported
+
+                if(account == nullptr){
+                    return false;
+                }
+
+                bool complete = true;
+
+                for(char code : {'C', 'S'}){
+                    Money balance;
+                    uint64_t records = 0;
+                    complete = complete && reader.beginSubAccount(balance, records) && account -> getSubAccount(code) -> rebuild(balance, records, [&reader](TransactionType& type, Money& oldBalance, Money& change, int64_t& timestamp){
+                        return reader.nextRecord(type, oldBalance, change, timestamp);
+                    });
+                    stats.records += complete ? records : 0;
+                }
+
+                std::unique_lock<std::shared_mutex> guard(directory);
+
+                if(!complete || existsLocked(account -> getUsername())){
+                    guard.unlock();
+                    stats.skipped += complete;
+                    delete account;
+
+                    if(!complete){                              //Damaged file: whatever came before stays, the log makes replay stop at the same place
+                        logImport(source, stats);
+                        return false;
+                    }
+
+                    continue;
+                }
+
+                accounts.adoptAccount(account);
+                nameAdded(account -> getUsername());
+                stats.accounts++;
+            }
+
+            stats.bytes = reader.bytesRead();
+            logImport(source, stats);
+            return reader.ok();
+        }
+
+        void attachJournal(std::unique_ptr<WriteAheadLog> log){         //Every change from here on is logged; replay first, then attach
+            std::unique_lock<std::shared_mutex> guard(directory);
+            journal = std::move(log);
+            accounts.setJournal(journal.get());
+        }
+
+        bool commitJournal(){                       //Acknowledge point: blocks until this thread's logged changes are durable under the log's policy, false if they can't be
+            return journal == nullptr || journal -> commit();
+        }
+
+        bool journalFailed(){                       //The log lost a write, so nothing more can be acknowledged
+            return journal != nullptr && journal -> hasFailed();
+        }
+
+        WriteAheadLog* getJournal(){
+            return journal.get();
+        }
+
+        OpResult deleteAccount(std::string_view username, std::string_view password){        //Password checked without the directory lock, then unlinked under the exclusive lock only if it's still that password; threads still holding a handle keep the account alive until they let go
+            OpTimer timer(MetricOp::Delete);
+            AccountHandle account = acquire(username);              //Pulls it out of the snapshot first so the claim bit keeps it deleted
+
+            if(!account){
+                PasswordHasher::burn(password);
+                return timer.result(OpResult::NotFound);
+            }
+
+            PasswordHash verified = account -> getCredential();
+
+            if(!PasswordHasher::verify(verified, password)){
+                return timer.result(OpResult::NotFound);
+            }
+
+            std::unique_lock<std::shared_mutex> guard(directory);
+            OpResult result = accounts.deleteAccount(username, &verified);
+
+            if(result == OpResult::Ok){
+                nameRemoved(username);
+            }
+
+            return timer.result(result);
+        }
+
+        OpResult purgeAccount(std::string_view username){          //PURGE from the log: the delete was checked before it was logged, so no password here
+            OpTimer timer(MetricOp::Delete);
+            std::unique_lock<std::shared_mutex> guard(directory);
+            findLocked(username);
+            OpResult result = accounts.deleteAccount(username);
+
+            if(result == OpResult::Ok){
+                nameRemoved(username);
+            }
+
+            return timer.result(result);
+        }
+
+        AccountHandle signIn(std::string_view username, std::string_view password){          //Pinned account if the password matches, empty otherwise -- every login path goes through here
+            OpTimer timer(MetricOp::Login);
+            AccountHandle account = acquire(username);
+
+            if(!account){
+                PasswordHasher::burn(password);
+                timer.result(OpResult::NotFound);
+                return AccountHandle();
+            }
+
+            if(!account -> checkPassword(password)){
+                timer.result(OpResult::NotFound);
+                return AccountHandle();
+            }
+
+            return account;
+        }
+
+        OpResult authenticate(std::string_view username, std::string_view password){         //Non-interactive login check, same answer for an unknown user and a wrong password
+            return signIn(username, password) ? OpResult::Ok : OpResult::NotFound;
+        }
+
+        OpResult updatePassword(std::string_view username, std::string_view oldPassword, std::string_view newPassword){       //Non-interactive version of updateAccount
+            OpTimer timer(MetricOp::Passwd);
+            AccountHandle account = acquire(username);
+
+            if(!account){
+                PasswordHasher::burn(oldPassword);
+                return timer.result(OpResult::NotFound);
+            }
+
+            if(!account -> checkPassword(oldPassword)){
+                return timer.result(OpResult::NotFound);
+            }
+
+            if(!validLength(newPassword)){
+                return timer.result(OpResult::InvalidLength);
+            }
+
+            account -> setPassword(newPassword);
+            return OpResult::Ok;
+        }
+
+        OpResult transfer(std::string_view fromUser, char fromChoice, std::string_view toUser, char toChoice, Money amount, int64_t timestamp = 0){     //Between any two sub-accounts, one user's or two users' -- both move or neither does
+            AccountHandle from = acquire(fromUser);
+            AccountHandle to = acquire(toUser);
+
+            if(!from || !to || from -> getSubAccount(fromChoice) == nullptr || to -> getSubAccount(toChoice) == nullptr){
+                Metrics::reject(MetricOp::Transfer, OpResult::NotFound);
+                return OpResult::NotFound;
+            }
+
+            return from -> transfer(fromChoice, *to.get(), toChoice, amount, timestamp);
+        }
+
+        size_t settleTransfers(vector<TransferOrder>& orders){     //Batched transfers: every account involved is pinned once and locked once (in address order), then the orders run in sequence -- returns how many went through
+            struct Party{                                   //One user named somewhere in the batch
+                bool used = false;
+                std::string_view name;
+                AccountHandle account;
+                bool touched[2] = {false, false};           //Checking, savings
+            };
+
+            size_t capacity = 16;
+
+            while(capacity < 4 * orders.size()){            //Two names per order, kept at most half full
+                capacity *= 2;
+            }
+
+            vector<Party> parties(capacity);
+            vector<std::pair<Party*, Party*>> sides(orders.size(), {nullptr, nullptr});
+
+            auto find = [&](std::string_view name) -> Party*{          //Linear probing on the name, acquired the first time it shows up
+                for(size_t i = AccountIndex::hashName(name) & (capacity - 1); ; i = (i + 1) & (capacity - 1)){
+                    if(!parties[i].used){
+                        parties[i].used = true;
+                        parties[i].name = name;
+                        parties[i].account = acquire(name);
+                    }
+
+                    if(parties[i].name == name){
+                        return parties[i].account ? &parties[i] : nullptr;
+                    }
+                }
+            };
+
+            auto slot = [](char choice){                    //0 checking, 1 savings, -1 neither
+                return choice == 'C' || choice == 'c' ? 0 : choice == 'S' || choice == 's' ? 1 : -1;
+            };
+
+            for(size_t i = 0; i < orders.size(); i++){
+                Party* from = find(orders[i].fromUser);
+                Party* to = find(orders[i].toUser);
+
+                if(from != nullptr && to != nullptr && slot(orders[i].fromChoice) >= 0 && slot(orders[i].toChoice) >= 0){
+                    sides[i] = {from, to};
+                    from -> touched[slot(orders[i].fromChoice)] = true;
+                    to -> touched[slot(orders[i].toChoice)] = true;
+                }
+            }
+
+            vector<SubAccount*> touched;
+
+            for(Party& party : parties){
+                for(int sub = 0; sub < 2; sub++){
+                    if(party.touched[sub]){
+                        touched.push_back(party.account -> getSubAccount("CS"[sub]));
+                    }
+                }
+            }
+
+            auto admitted = WriteAheadLog::admit(journal.get());
+            SubAccount::LockSet held(std::move(touched));
+            size_t settled = 0;
+
+            for(size_t i = 0; i < orders.size(); i++){
+                TransferOrder& order = orders[i];
+
+                if(sides[i].first == nullptr){
+                    Metrics::reject(MetricOp::Transfer, OpResult::NotFound);
+                    order.result = OpResult::NotFound;
+                    continue;
+                }
+
+                order.result = sides[i].first -> account -> transferLocked(order.fromChoice, *sides[i].second -> account.get(), order.toChoice, order.amount);
+                settled += order.result == OpResult::Ok;
+            }
+
+            return settled;
+        }
+
+        OpResult createAccount(std::string_view username, std::string_view password){        //Non-interactive account creation, same rules as the prompt version
+            OpTimer timer(MetricOp::Create);
+
+            if(!validUsername(username) || !validLength(password)){
+                return timer.result(OpResult::InvalidLength);
+            }
+
+            if(accountExists(username)){                    //A taken name shouldn't cost a hash, insertAccount checks again under the lock
+                return timer.result(OpResult::AlreadyExists);
+            }
+
+            return timer.result(insertAccount(username, PasswordHasher::hash(password)));        //Hashed before the lock is taken
+        }
+
+        OpResult createHashed(std::string_view username, const PasswordHash& credential){      //CREATEHASHED from the log: the account with the hash it was created with, no KDF
+            OpTimer timer(MetricOp::Create);
+
+            if(!validUsername(username)){
+                return timer.result(OpResult::InvalidLength);
+            }
+
+            return timer.result(insertAccount(username, credential));
+        }
+
+        OpResult setCredential(std::string_view username, const PasswordHash& credential){     //SETHASH from the log
+            OpTimer timer(MetricOp::Passwd);
+            AccountHandle account = acquire(username);
+
+            if(!account){
+                return timer.result(OpResult::NotFound);
+            }
+
+            account -> setCredential(credential);
+            return OpResult::Ok;
+        }
+
+        template<typename Visitor>
+        size_t listAccounts(std::string_view prefix, std::string_view after, size_t limit, Visitor&& visit) const{     //One page of names in order, live accounts merged with snapshot accounts nobody has logged into yet
+            std::shared_lock<std::shared_mutex> guard(directory);
+
+            if(snapshot == nullptr || snapshot -> getUnclaimed() == 0){
+                return accounts.listAccounts(prefix, after, limit, visit);
+            }
+
+            vector<std::string_view> live;                  //At most a page of views into the tree, valid while the lock is held
+            accounts.listAccounts(prefix, after, limit, [&live](std::string_view name){
+                live.push_back(name);
+            });
+
+            size_t stored = snapshot -> lowerBound(std::max(prefix, after));
+            size_t next = 0;
+            size_t visited = 0;
+
+            while(visited < limit){
+                while(stored < snapshot -> size() && (snapshot -> isClaimed(stored) || snapshot -> username(stored) == after)){        //Claimed entries already show up as live accounts
+                    stored++;
+                }
+
+                bool haveStored = stored < snapshot -> size() && snapshot -> username(stored).substr(0, prefix.size()) == prefix;
+
+                if(next < live.size() && (!haveStored || live[next] < snapshot -> username(stored))){
+                    visit(live[next++]);
+
+                } else if(haveStored){
+                    visit(snapshot -> username(stored++));
+
+                } else {
+                    break;
+                }
+
+                visited++;
+            }
+
+            return visited;
+        }
+};
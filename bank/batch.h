@@ -0,0 +1,510 @@
+#pragma once                                                        //Line-oriented batch commands and opening the log
+
+#include "menus.h"
+
+class BatchRunner{                                      //Non-interactive front end: executes one command per line against a Bank with no prompts, e.g. "DEPOSIT bob C 100"
+    private:
+        static constexpr size_t groupSize = 1024;      //Replies are held back and released together once the log has committed them
+
+        Bank& bank;
+        std::ostream& sink;
+        std::ostringstream out;                         //Unacknowledged replies
+        HistoryRenderer renderer;                       //Reused by every HISTORY ... <format> command
+        size_t commands;
+        size_t failures;
+        size_t unflushed;
+        bool halted;                                    //The log failed: nothing since the last acknowledged flush is durable, and nothing more will be
+        bool trusted;                                   //False for server sessions: commands that read or write paths on the server, or set stored hashes directly, are refused
+        AccountHandle* session;                         //Untrusted only: the account this connection last logged in as, the one its money and history commands may touch
+
+        static size_t splitTokens(std::string_view line, std::string_view* tokens, size_t maxTokens){         //Whitespace split without allocating, returns the token count (capped at maxTokens + 1 so extras are detectable)
+            size_t count = 0;
+            size_t i = 0;
+
+            while(count <= maxTokens){
+                while(i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')){
+                    i++;
+                }
+
+                if(i == line.size()){
+                    break;
+                }
+
+                size_t start = i;
+
+                while(i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r'){
+                    i++;
+                }
+
+                if(count < maxTokens){
+                    tokens[count] = line.substr(start, i - start);
+                }
+
+                count++;
+            }
+
+            return count;
+        }
+
+        void report(OpResult result){
+            if(result == OpResult::Ok){
+                out << "OK\n";
+                return;
+            }
+
+            out << "ERR " << resultText(result) << "\n";
+            failures++;
+        }
+
+        void reportBalance(OpResult result, SubAccount* account){       //Deposit/withdraw reply carries the resulting balance
+            if(result == OpResult::Ok){
+                out << "OK " << account -> getBalance() << "\n";
+                return;
+            }
+
+            report(result);
+        }
+
+        void usage(std::string_view command){
+            out << "ERR Usage: " << command << "\n";
+            failures++;
+        }
+
+        bool refuseUntrusted(std::string_view command){     //True (and replied) when this runner may not run command
+            if(trusted){
+                return false;
+            }
+
+            out << "ERR Not available over the server: " << command << "\n";
+            failures++;
+            return true;
+        }
+
+        bool refuseUnowned(const AccountHandle& owner, std::string_view username){      //True (and replied) when this session isn't logged in as username -- same reply whether or not it exists
+            if(trusted || (session != nullptr && *session && session -> get() == owner.get())){
+                return false;
+            }
+
+            out << "ERR Not logged in as " << username << "\n";
+            failures++;
+            return true;
+        }
+
+        SubAccount* resolve(std::string_view username, std::string_view accountChoice, AccountHandle& owner){      //nullptr if the user or the C/S choice doesn't exist, owner keeps the account pinned
+            owner = bank.acquire(username);
+
+            if(!owner || accountChoice.size() != 1){
+                return nullptr;
+            }
+
+            return owner -> getSubAccount(accountChoice[0]);
+        }
+
+    public:
+        BatchRunner(Bank& targetBank, std::ostream& output, bool trustedSource = true) : bank(targetBank), sink(output), out(), renderer(), commands(0), failures(0), unflushed(0), halted(false), trusted(trustedSource), session(nullptr) {}
+
+        ~BatchRunner(){
+            flush();
+        }
+
+        bool flush(){                                   //Commit the log, then acknowledge everything since the last flush -- if the commit fails none of it is, and the runner stops
+            if(!halted && !bank.commitJournal()){
+                halted = true;
+                out.str("");
+                out << "ERR Write-ahead log write failed, nothing since the last reply was saved\n";
+                failures++;
+            }
+
+            sink << out.str();
+            sink.flush();
+            out.str("");
+            unflushed = 0;
+            return !halted;
+        }
+
+        void bindSession(AccountHandle* login){         //Untrusted runners are shared by a worker's connections, so each one's login is swapped in before its lines run
+            session = login;
+        }
+
+        void execute(std::string_view line){               //Runs a single command line, blank lines and # comments are skipped
+            std::string_view tokens[7];
+            size_t count = splitTokens(line, tokens, 7);
+
+            if(count == 0 || tokens[0][0] == '#'){
+                return;
+            }
+
+            commands++;
+            std::string_view command = tokens[0];
+
+            if(++unflushed == groupSize){
+                flush();
+            }
+
+            if(halted){
+                out << "ERR Write-ahead log write failed\n";
+                failures++;
+                return;
+            }
+
+            if(command == "CREATE"){
+                if(count != 3){
+                    usage("CREATE <username> <password>");
+                    return;
+                }
+
+                report(bank.createAccount(tokens[1], tokens[2]));
+
+            } else if(command == "LOGIN"){
+                if(count != 3){
+                    usage("LOGIN <username> <password>");
+                    return;
+                }
+
+                AccountHandle account = bank.signIn(tokens[1], tokens[2]);
+                report(account ? OpResult::Ok : OpResult::NotFound);
+
+                if(session != nullptr){                     //A failed login logs the session out
+                    *session = std::move(account);
+                }
+
+            } else if(command == "DELETE"){
+                if(count != 3){
+                    usage("DELETE <username> <password>");
+                    return;
+                }
+
+                report(bank.deleteAccount(tokens[1], tokens[2]));
+
+            } else if(command == "PASSWD"){
+                if(count != 4){
+                    usage("PASSWD <username> <old password> <new password>");
+                    return;
+                }
+
+                report(bank.updatePassword(tokens[1], tokens[2], tokens[3]));
+
+            } else if(command == "CREATEHASHED" || command == "SETHASH" || command == "PURGE"){        //What the log records for CREATE/PASSWD/DELETE: the stored hash instead of the password, so replay skips the KDF and the log holds no passwords
+                bool purge = command == "PURGE";
+                PasswordHash credential;
+
+                if(count != (purge ? 2u : 3u) || (!purge && !decodeHash(tokens[2], credential))){
+                    usage(purge ? "PURGE <username>" : command == "SETHASH" ? "SETHASH <username> <hash>" : "CREATEHASHED <username> <hash>");
+                    return;
+                }
+
+                if(refuseUntrusted(command)){               //Would let a client set a password without knowing the old one
+                    return;
+                }
+
+                report(purge ? bank.purgeAccount(tokens[1]) : command == "SETHASH" ? bank.setCredential(tokens[1], credential) : bank.createHashed(tokens[1], credential));
+
+            } else if(command == "DEPOSIT" || command == "WITHDRAW"){
+                Money amount;
+                int64_t timestamp = 0;                      //at= is how the log restores record times on replay, otherwise it's now
+
+                if(count < 4 || count > 5 || !parseMoney(tokens[3], amount) || (count == 5 && (tokens[4].substr(0, 3) != "at=" || !parseMicros(tokens[4].substr(3), timestamp)))){
+                    usage(command == "DEPOSIT" ? "DEPOSIT <username> <C|S> <amount> [at=<micros>]" : "WITHDRAW <username> <C|S> <amount> [at=<micros>]");
+                    return;
+                }
+
+                AccountHandle owner;
+                SubAccount* account = resolve(tokens[1], tokens[2], owner);
+
+                if(refuseUnowned(owner, tokens[1])){
+                    return;
+                }
+
+                if(account == nullptr){
+                    Metrics::reject(command == "DEPOSIT" ? MetricOp::Deposit : MetricOp::Withdraw, OpResult::NotFound);
+                    report(OpResult::NotFound);
+                    return;
+                }
+
+                char choice = tokens[2][0];
+                reportBalance(command == "DEPOSIT" ? owner -> deposit(choice, amount, timestamp) : owner -> withdraw(choice, amount, timestamp), account);
+
+            } else if(command == "TRANSFER"){            //Replies "OK <from balance> <to balance>"
+                Money amount;
+                int64_t timestamp = 0;
+
+                if(count < 6 || count > 7 || !parseMoney(tokens[5], amount) || (count == 7 && (tokens[6].substr(0, 3) != "at=" || !parseMicros(tokens[6].substr(3), timestamp)))){
+                    usage("TRANSFER <from username> <C|S> <to username> <C|S> <amount> [at=<micros>]");
+                    return;
+                }
+
+                AccountHandle from, to;
+                SubAccount* source = resolve(tokens[1], tokens[2], from);
+
+                if(refuseUnowned(from, tokens[1])){         //Only the source has to be the session's, anyone can be paid
+                    return;
+                }
+
+                SubAccount* target = resolve(tokens[3], tokens[4], to);
+
+                if(source == nullptr || target == nullptr){
+                    Metrics::reject(MetricOp::Transfer, OpResult::NotFound);
+                    report(OpResult::NotFound);
+                    return;
+                }
+
+                OpResult result = from -> transfer(tokens[2][0], *to.get(), tokens[4][0], amount, timestamp);
+
+                if(result != OpResult::Ok){
+                    report(result);
+                    return;
+                }
+
+                out << "OK " << source -> getBalance() << " " << target -> getBalance() << "\n";
+
+            } else if(command == "HISTORY"){
+                RenderFormat format = RenderFormat::Text;
+
+                if(count < 3 || count > 4 || (count == 4 && !parseRenderFormat(tokens[3], format))){
+                    usage("HISTORY <username> <C|S> [text|csv|json]");
+                    return;
+                }
+
+                AccountHandle owner;
+                SubAccount* account = resolve(tokens[1], tokens[2], owner);
+
+                if(refuseUnowned(owner, tokens[1])){
+                    return;
+                }
+
+                if(account == nullptr){
+                    Metrics::reject(MetricOp::History, OpResult::NotFound);
+                    report(OpResult::NotFound);
+                    return;
+                }
+
+                if(count == 4){                             //Full rendering through the buffered renderer
+                    account -> renderHistory(renderer, format, out);
+                    out << "OK\n";
+                    return;
+                }
+
+                OpTimer timer(MetricOp::History);
+                size_t records = account -> readHistory([this](const Transaction& record){         //One compact line per record: type, old balance, change, new balance
+                    Money change = record.getBalanceChange();
+                    out << "  " << typeName(record.getType()) << " " << record.getOldBalance() << " " << (change < Money() ? "-" : "+") << change.magnitude() << " " << record.getNewBalance() << "\n";
+                });
+
+                out << "OK " << records << " records\n";
+
+            } else if(command == "ASOF" || command == "BETWEEN"){      //ASOF <user> <C|S> <micros> replies "OK <balance>"; BETWEEN <user> <C|S> <from> <to> lists the records stamped in that range
+                bool asOf = command == "ASOF";
+                int64_t from = 0, to = 0;
+
+                if(count != (asOf ? 4u : 5u) || !parseMicros(tokens[3], from) || (!asOf && !parseMicros(tokens[4], to))){
+                    usage(asOf ? "ASOF <username> <C|S> <micros>" : "BETWEEN <username> <C|S> <from micros> <to micros>");
+                    return;
+                }
+
+                AccountHandle owner;
+                SubAccount* account = resolve(tokens[1], tokens[2], owner);
+
+                if(refuseUnowned(owner, tokens[1])){
+                    return;
+                }
+
+                if(account == nullptr){
+                    Metrics::reject(MetricOp::History, OpResult::NotFound);
+                    report(OpResult::NotFound);
+                    return;
+                }
+
+                OpTimer timer(MetricOp::History);
+
+                if(asOf){
+                    out << "OK " << account -> balanceAsOf(from) << "\n";
+                    return;
+                }
+
+                size_t records = account -> readHistoryBetween(from, to, [this](const Transaction& record){            //HISTORY's compact line with the time in front
+                    Money change = record.getBalanceChange();
+                    out << "  " << record.getTimestamp() << " " << typeName(record.getType()) << " " << record.getOldBalance() << " " << (change < Money() ? "-" : "+") << change.magnitude() << " " << record.getNewBalance() << "\n";
+                });
+
+                out << "OK " << records << " records\n";
+
+            } else if(command == "SUMMARY"){               //Statement totals without walking the records, "OK deposits=<n> +<sum> withdrawals=<n> -<sum> transfers_in=<n> +<sum> transfers_out=<n> -<sum> low=<balance> high=<balance>"
+                if(count != 3){
+                    usage("SUMMARY <username> <C|S>");
+                    return;
+                }
+
+                AccountHandle owner;
+                SubAccount* account = resolve(tokens[1], tokens[2], owner);
+
+                if(refuseUnowned(owner, tokens[1])){
+                    return;
+                }
+
+                if(account == nullptr){
+                    Metrics::reject(MetricOp::History, OpResult::NotFound);
+                    report(OpResult::NotFound);
+                    return;
+                }
+
+                OpTimer timer(MetricOp::History);
+                HistorySummary summary = account -> summarizeHistory();
+                out << "OK deposits=" << summary.depositCount << " +" << summary.deposits << " withdrawals=" << summary.withdrawalCount << " -" << summary.withdrawals.magnitude()
+                    << " transfers_in=" << summary.transferInCount << " +" << summary.transfersIn << " transfers_out=" << summary.transferOutCount << " -" << summary.transfersOut.magnitude()
+                    << " low=" << summary.lowBalance << " high=" << summary.highBalance << "\n";
+
+            } else if(command == "LIST"){                  //LIST [prefix=<p>] [after=<name>] [limit=<n>], names in order, ending "OK <count> next=<name>" when more may follow
+                std::string_view prefix, after;
+                size_t limit = 100;
+                bool valid = true;
+
+                for(size_t i = 1; i < count && i < 4; i++){
+                    std::string_view option = tokens[i];
+
+                    if(option.substr(0, 7) == "prefix="){
+                        prefix = option.substr(7);
+
+                    } else if(option.substr(0, 6) == "after="){
+                        after = option.substr(6);
+
+                    } else if(option.substr(0, 6) == "limit="){
+                        auto [end, error] = std::from_chars(option.data() + 6, option.data() + option.size(), limit);
+                        valid = valid && error == std::errc() && end == option.data() + option.size() && limit > 0 && limit <= 10000;
+
+                    } else {
+                        valid = false;
+                    }
+                }
+
+                if(count > 4 || !valid){
+                    usage("LIST [prefix=<prefix>] [after=<username>] [limit=<1-10000>]");
+                    return;
+                }
+
+                string last;
+                size_t listed = bank.listAccounts(prefix, after, limit, [this, &last](std::string_view name){
+                    out << "  " << name << "\n";
+                    last.assign(name);
+                });
+
+                out << "OK " << listed;
+
+                if(listed == limit){
+                    out << " next=" << last;
+                }
+
+                out << "\n";
+
+            } else if(command == "METRICS"){               //Prometheus text inline, or written to a file when a path is given
+                if(count > 2){
+                    usage("METRICS [path]");
+                    return;
+                }
+
+                if(count == 1){
+                    Metrics::write(out);
+                    out << "OK\n";
+                    return;
+                }
+
+                if(refuseUntrusted(command)){
+                    return;
+                }
+
+                report(Metrics::writeFile(string(tokens[1])) ? OpResult::Ok : OpResult::NotFound);
+
+            } else if(command == "EXPORT" || command == "IMPORT"){      //EXPORT <path> [username] / IMPORT <path>, replying "OK <accounts> accounts <records> records <bytes> bytes"
+                bool exporting = command == "EXPORT";
+
+                if(count < 2 || count > (exporting ? 3u : 2u)){
+                    usage(exporting ? "EXPORT <path> [username]" : "IMPORT <path>");
+                    return;
+                }
+
+                if(refuseUntrusted(command)){
+                    return;
+                }
+
+                ExportStats stats;
+                string path(tokens[1]);
+                bool done = exporting ? bank.exportAccounts(path, count == 3 ? tokens[2] : std::string_view(), stats) : bank.importAccounts(path, stats);
+
+                if(!done){
+                    report(OpResult::NotFound);
+                    return;
+                }
+
+                out << "OK " << stats.accounts << " accounts " << stats.records << " records " << stats.bytes << " bytes";
+
+                if(stats.skipped > 0){
+                    out << " " << stats.skipped << " skipped";
+                }
+
+                out << "\n";
+
+            } else if(command == "SNAPSHOT"){
+                if(count != 2){
+                    usage("SNAPSHOT <path>");
+                    return;
+                }
+
+                if(refuseUntrusted(command)){
+                    return;
+                }
+
+                report(bank.writeSnapshot(string(tokens[1])) ? OpResult::Ok : OpResult::NotFound);
+
+            } else {
+                out << "ERR Unknown command: " << command << "\n";
+                failures++;
+            }
+        }
+
+        void run(std::istream& in){
+            string line;
+
+            while(!halted && getline(in, line)){
+                execute(line);
+            }
+
+            flush();
+        }
+
+        size_t getCommands() const{
+            return commands;
+        }
+
+        size_t getFailures() const{
+            return failures;
+        }
+};
+
+inline bool openJournal(Bank& bank, const string& path, Durability policy){    //Replays an existing log (past whatever the loaded snapshot already covers) into bank, then attaches it so new changes append to it
+    std::ostream discard(nullptr);                              //Replay replies go nowhere
+    uint64_t validEnd;
+
+    {
+        BatchRunner replay(bank, discard);
+
+        validEnd = WriteAheadLog::replay(path, [&replay](std::string_view line){
+            replay.execute(line);
+        }, bank.snapshotJournalOffset());
+    }
+
+    struct stat info;
+
+    if(::stat(path.c_str(), &info) == 0 && uint64_t(info.st_size) > validEnd && ::truncate(path.c_str(), validEnd) != 0){       //Cut a torn tail so new records start on a clean line
+        std::cerr << "Could not repair write-ahead log " << path << "\n";
+        return false;
+    }
+
+    auto log = std::make_unique<WriteAheadLog>(path, policy);
+
+    if(!log -> isOpen()){
+        std::cerr << "Could not open write-ahead log " << path << "\n";
+        return false;
+    }
+
+    bank.attachJournal(std::move(log));
+    return true;
+}
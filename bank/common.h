@@ -0,0 +1,307 @@
+#pragma once                                                        //Money, operation results and the text rules every other header builds on
+
+#include <iostream>
+#include <string>
+#include <limits>
+#include <tuple>
+#include <stdexcept>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <new>
+#include <cmath>
+#include <cstdint>
+#include <compare>
+#include <string_view>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <coroutine>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <charconv>
+#include <cstdlib>
+#include <random>
+#include <openssl/core_names.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using std::cout, std::cin, std::getline, std::string, std::tuple, std::exception, std::numeric_limits, std::streamsize, std::vector;         //Namespace directives for simplicity's sake, don't want to use blanket
+
+#ifdef BANK_COUNT_ALLOCATIONS                                       //Benchmark builds only (cmake -DBANK_COUNT_ALLOCATIONS=ON), everything else keeps the standard allocator
+struct AllocationCounter{                                           //Per-thread heap allocation count, fed by the global operator new in tools/bench.cpp -- benchmarks diff it around a loop
+    static constexpr bool enabled = true;
+    static thread_local uint64_t allocations;
+    static thread_local uint64_t bytes;
+};
+
+inline thread_local uint64_t AllocationCounter::allocations = 0;
+inline thread_local uint64_t AllocationCounter::bytes = 0;
+#else
+struct AllocationCounter{                                           //Counting compiled out: both counts stay zero, so the diffs cost nothing and readers check enabled first
+    static constexpr bool enabled = false;
+    static constexpr uint64_t allocations = 0;
+    static constexpr uint64_t bytes = 0;
+};
+#endif
+
+class Money{                                                        //Fixed-point amount stored as integer cents, replaces double so balances never drift; + and - are overflow checked
+    private:
+        int64_t cents;
+
+        constexpr explicit Money(int64_t rawCents, int) : cents(rawCents) {}           //Tagged so plain integers can't silently become cents
+
+    public:
+        constexpr Money() : cents(0) {}
+
+        static constexpr Money fromCents(int64_t rawCents){
+            return Money(rawCents, 0);
+        }
+
+        static constexpr Money dollars(int64_t wholeDollars){
+            return Money(wholeDollars * 100, 0);
+        }
+
+        constexpr int64_t getCents() const{
+            return cents;
+        }
+
+        Money operator+(Money other) const{
+            int64_t result;
+
+            if(__builtin_add_overflow(cents, other.cents, &result)){
+                throw std::overflow_error("balance overflow");
+            }
+
+            return Money(result, 0);
+        }
+
+        Money operator-(Money other) const{
+            int64_t result;
+
+            if(__builtin_sub_overflow(cents, other.cents, &result)){
+                throw std::overflow_error("balance underflow");
+            }
+
+            return Money(result, 0);
+        }
+
+        Money operator-() const{
+            return Money() - *this;
+        }
+
+        Money& operator+=(Money other){
+            return *this = *this + other;
+        }
+
+        Money& operator-=(Money other){
+            return *this = *this - other;
+        }
+
+        Money magnitude() const{                                    //Absolute value, used when displaying withdrawals
+            return cents < 0 ? -*this : *this;
+        }
+
+        constexpr auto operator<=>(const Money&) const = default;
+
+        string toString() const{                                    //Always two decimal places, e.g. "-20.00"
+            int64_t whole = cents / 100;
+            int64_t fraction = cents % 100;
+            string text = (cents < 0 && whole == 0) ? "-0" : std::to_string(whole);
+            fraction = fraction < 0 ? -fraction : fraction;
+
+            return text + (fraction < 10 ? ".0" : ".") + std::to_string(fraction);
+        }
+};
+
+inline std::ostream& operator<<(std::ostream& out, Money amount){
+    return out << amount.toString();
+}
+
+inline bool parseMicros(std::string_view token, int64_t& micros){   //Positive microseconds since the epoch, as stamped on history records
+    auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), micros);
+    return error == std::errc() && end == token.data() + token.size() && micros > 0;
+}
+
+inline bool parseCount(std::string_view token, unsigned& count){    //Plain decimal that fits an unsigned -- no sign, no trailing junk, unlike strtoul
+    auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), count);
+    return error == std::errc() && end == token.data() + token.size();
+}
+
+inline bool parseMoney(std::string_view token, Money& amount){     //Accepts "100", "100.5" or "100.25"; anything else (including a third decimal) is rejected
+    size_t i = 0;
+    bool negative = false;
+
+    if(!token.empty() && (token[0] == '-' || token[0] == '+')){
+        negative = token[0] == '-';
+        i++;
+    }
+
+    int64_t whole = 0, fraction = 0;
+    size_t digits = 0, fractionDigits = 0;
+
+    for(; i < token.size() && token[i] != '.'; i++, digits++){
+        if(token[i] < '0' || token[i] > '9' || whole > 100000000000LL){        //Cap keeps the multiply below from overflowing
+            return false;
+        }
+
+        whole = whole * 10 + (token[i] - '0');
+    }
+
+    if(i < token.size()){                                           //Skip the decimal point, then read at most two digits of cents
+        for(i++; i < token.size(); i++, fractionDigits++){
+            if(token[i] < '0' || token[i] > '9' || fractionDigits == 2){
+                return false;
+            }
+
+            fraction = fraction * 10 + (token[i] - '0');
+        }
+    }
+
+    if(digits == 0 && fractionDigits == 0){
+        return false;
+    }
+
+    if(fractionDigits == 1){
+        fraction *= 10;
+    }
+
+    int64_t total = whole * 100 + fraction;
+    amount = Money::fromCents(negative ? -total : total);
+    return true;
+}
+
+inline std::istream& operator>>(std::istream& in, Money& amount){   //Stream form of parseMoney, sets failbit on a malformed amount
+    string token;
+
+    if(in >> token && !parseMoney(token, amount)){
+        in.setstate(std::ios::failbit);
+    }
+
+    return in;
+}
+
+template<typename NodeType>                             //Generic destructor for linked lists, reduces redundancy
+inline void deleteList(NodeType* head) {
+    NodeType* current = head;
+ 
+    while(current != nullptr) {
+        NodeType* next = current->getNext();
+        delete current;
+        current = next;
+    }
+}
+
+inline string stripSpace(string& str){
+    size_t start = str.find_first_not_of(" \t\n\r\f\v");
+    
+    if (start == string::npos) {
+        return "";
+    }
+    
+    size_t end = str.find_last_not_of(" \t\n\r\f\v");
+    return str.substr(start, end - start + 1);
+}
+
+enum class TransactionType : unsigned char{            //One byte type code instead of a string per record -- the export format keeps it in 2 bits, so 4 types at most
+    Deposit,
+    Withdrawal,
+    TransferOut,                                        //The two halves of a transfer, so they can't be mistaken for cash in or out
+    TransferIn
+};
+
+inline const char* typeName(TransactionType type){
+    switch(type){
+        case TransactionType::Deposit:
+            return "Deposit";
+
+        case TransactionType::Withdrawal:
+            return "Withdrawal";
+
+        case TransactionType::TransferOut:
+            return "TransferOut";
+
+        case TransactionType::TransferIn:
+            return "TransferIn";
+    }
+
+    return "Unknown";
+}
+
+enum class OpResult : unsigned char{                  //Outcome of a non-interactive operation, the prompt-driven flows report these as messages instead
+    Ok,
+    NotFound,
+    AlreadyExists,
+    InvalidLength,
+    OutOfBounds,
+    SameAccount
+};
+
+inline const char* resultText(OpResult result){
+    switch(result){
+        case OpResult::Ok:
+            return "OK";
+
+        case OpResult::NotFound:
+            return "Account info not found.";
+
+        case OpResult::AlreadyExists:
+            return "Username already exists.";
+
+        case OpResult::InvalidLength:
+            return "Must be at least 3 characters or at most 20 characters long.";
+
+        case OpResult::OutOfBounds:
+            return "Amount out of bounds.";
+
+        case OpResult::SameAccount:
+            return "Cannot transfer to the same account.";
+    }
+
+    return "Unknown result.";
+}
+
+inline bool validLength(std::string_view text){           //Shared 3-20 character rule for usernames and passwords
+    return text.length() >= 3 && text.length() <= 20;
+}
+
+inline bool validUsername(std::string_view name){          //validLength plus printable ASCII with no spaces, since names travel as whitespace-separated tokens in the log and the batch protocol
+    for(char c : name){
+        if(static_cast<unsigned char>(c) <= ' ' || static_cast<unsigned char>(c) > '~'){
+            return false;
+        }
+    }
+
+    return validLength(name);
+}
+
+inline int64_t nowMicros(){                             //Wall clock time stamped on history records, microseconds since the epoch
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
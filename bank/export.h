@@ -0,0 +1,317 @@
+#pragma once                                                        //Streaming account export and import
+
+#include "snapshot.h"
+
+struct ExportStats{                                     //What an EXPORT or IMPORT moved
+    uint64_t accounts = 0;
+    uint64_t skipped = 0;                               //Imported accounts whose name was already taken
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+};
+
+class ExportWriter{                                     //Streams accounts out in the compact export format through one 64KB buffer, so memory use doesn't depend on how much is exported
+    private:                                            //Layout: "BANKEXP2", then per account its name, password hash (56 raw bytes) and both sub-accounts (C then S), ending with an empty name
+        static constexpr size_t blockSize = 64 * 1024;
+
+        std::ofstream file;
+        vector<char> buffer;
+        size_t used;
+        uint64_t written;
+        int64_t previousBalance;                        //Delta bases, reset for every sub-account
+        int64_t previousTime;
+
+        void flush(){
+            file.write(buffer.data(), used);
+            written += used;
+            used = 0;
+        }
+
+        void putVarint(uint64_t value){                 //LEB128: 7 bits per byte, high bit set on all but the last
+            if(used + 10 > blockSize){
+                flush();
+            }
+
+            while(value >= 0x80){
+                buffer[used++] = char(value | 0x80);
+                value >>= 7;
+            }
+
+            buffer[used++] = char(value);
+        }
+
+        void putSigned(int64_t value){                  //Zigzag first, so small negative deltas stay short too
+            putVarint((uint64_t(value) << 1) ^ uint64_t(value >> 63));
+        }
+
+        void putBytes(const void* data, size_t size){
+            const char* bytes = static_cast<const char*>(data);
+
+            for(size_t i = 0; i < size; i++){
+                if(used == blockSize){
+                    flush();
+                }
+
+                buffer[used++] = bytes[i];
+            }
+        }
+
+        void putText(std::string_view text){
+            putVarint(text.size());
+            putBytes(text.data(), text.size());
+        }
+
+    public:
+        explicit ExportWriter(const string& path) : file(path, std::ios::binary | std::ios::trunc), buffer(blockSize), used(0), written(0), previousBalance(0), previousTime(0) {
+            memcpy(buffer.data(), "BANKEXP2", 8);
+            used = 8;
+        }
+
+        bool isOpen() const{
+            return bool(file);
+        }
+
+        void beginAccount(std::string_view username, const PasswordHash& credential){
+            putText(username);
+            putBytes(&credential, sizeof(credential));
+        }
+
+        void beginSubAccount(Money balance, uint64_t records){
+            putSigned(balance.getCents());
+            putVarint(records);
+            previousBalance = 0;
+            previousTime = 0;
+        }
+
+        void putRecord(TransactionType type, int64_t oldCents, int64_t changeCents, int64_t timestamp){     //Usually 4-7 bytes: the old balance is almost always the previous new balance, and times only move forward
+            putVarint((((uint64_t(changeCents) << 1) ^ uint64_t(changeCents >> 63)) << 2) | static_cast<uint8_t>(type));      //Low 2 bits are the type code
+            putSigned(oldCents - previousBalance);
+            putSigned(timestamp - previousTime);
+            previousBalance = oldCents + changeCents;
+            previousTime = timestamp;
+        }
+
+        void putRecord(const Transaction& record){
+            putRecord(record.getType(), record.getOldBalance().getCents(), record.getBalanceChange().getCents(), record.getTimestamp());
+        }
+
+        bool finish(){                                  //End marker, then everything still buffered; false if any write failed
+            putVarint(0);
+            flush();
+            file.close();
+            return bool(file);
+        }
+
+        uint64_t bytesWritten() const{
+            return written + used;
+        }
+};
+
+class ExportReader{                                     //Pulls accounts and records back out of an export one at a time, through the same fixed buffer, so nothing is staged in between
+    private:
+        static constexpr size_t blockSize = 64 * 1024;
+
+        std::ifstream file;
+        vector<char> buffer;
+        size_t position;
+        size_t filled;
+        uint64_t consumed;
+        bool failed;
+        bool legacy;                                    //Version 1 file, which carries passwords instead of hashes
+        char username[21];
+        uint8_t usernameLength;
+        PasswordHash credential;
+        int64_t previousBalance;
+        int64_t previousTime;
+        int64_t finalBalance;                           //The sub-account's stated balance, its last record has to land on it
+        uint64_t remaining;                             //Records left in the current sub-account
+
+        bool getByte(uint8_t& byte){
+            if(position == filled){
+                consumed += filled;
+                file.read(buffer.data(), blockSize);
+                filled = size_t(file.gcount());
+                position = 0;
+
+                if(filled == 0){
+                    failed = true;
+                    return false;
+                }
+            }
+
+            byte = uint8_t(buffer[position++]);
+            return true;
+        }
+
+        bool getVarint(uint64_t& value){
+            value = 0;
+            uint8_t byte;
+
+            for(int shift = 0; shift < 64; shift += 7){
+                if(!getByte(byte)){
+                    return false;
+                }
+
+                value |= uint64_t(byte & 0x7f) << shift;
+
+                if((byte & 0x80) == 0){
+                    return true;
+                }
+            }
+
+            failed = true;                              //More than 10 bytes, not something the writer produces
+            return false;
+        }
+
+        bool getSigned(int64_t& value){
+            uint64_t raw;
+
+            if(!getVarint(raw)){
+                return false;
+            }
+
+            value = int64_t(raw >> 1) ^ -int64_t(raw & 1);
+            return true;
+        }
+
+        bool getText(char (&text)[21], uint8_t& length, bool allowEmpty){      //Names and passwords are 3-20 characters, anything else means a damaged file
+            uint64_t size;
+
+            if(!getVarint(size) || (size == 0 && allowEmpty)){
+                length = 0;
+                return !failed;
+            }
+
+            if(size > 20 || size < 3){
+                failed = true;
+                return false;
+            }
+
+            for(size_t i = 0; i < size; i++){
+                uint8_t byte;
+
+                if(!getByte(byte)){
+                    return false;
+                }
+
+                text[i] = char(byte);
+            }
+
+            length = uint8_t(size);
+            return true;
+        }
+
+    public:
+        explicit ExportReader(const string& path) : file(path, std::ios::binary), buffer(blockSize), position(0), filled(0), consumed(0), failed(false), legacy(false),
+                                                    username(), usernameLength(0), credential(), previousBalance(0), previousTime(0), finalBalance(0), remaining(0) {
+            char magic[8];
+
+            for(char& c : magic){
+                uint8_t byte = 0;
+                getByte(byte);
+                c = char(byte);
+            }
+
+            legacy = memcmp(magic, "BANKEXP1", 8) == 0;
+            failed = failed || (!legacy && memcmp(magic, "BANKEXP2", 8) != 0);
+        }
+
+        bool ok() const{
+            return !failed;
+        }
+
+        bool nextAccount(){                             //False at the end marker (or on damage, check ok())
+            if(!getText(username, usernameLength, true) || usernameLength == 0){
+                return false;
+            }
+
+            if(!validUsername(getUsername())){          //Nothing CREATE would refuse gets in this way either
+                failed = true;
+                return false;
+            }
+
+            if(legacy){                                 //Hashed on the way in with the current settings, so importing an old file costs a KDF per account
+                char password[21];
+                uint8_t passwordLength;
+
+                if(!getText(password, passwordLength, false)){
+                    return false;
+                }
+
+                credential = PasswordHasher::hash(std::string_view(password, passwordLength));
+                return true;
+            }
+
+            uint8_t* bytes = reinterpret_cast<uint8_t*>(&credential);
+
+            for(size_t i = 0; i < sizeof(credential); i++){
+                if(!getByte(bytes[i])){
+                    return false;
+                }
+            }
+
+            if(!validHashSettings(HashScheme(credential.scheme), credential.cost, credential.blockSize, credential.parallelism)){
+                failed = true;
+                return false;
+            }
+
+            return true;
+        }
+
+        std::string_view getUsername() const{
+            return std::string_view(username, usernameLength);
+        }
+
+        const PasswordHash& getCredential() const{
+            return credential;
+        }
+
+        bool beginSubAccount(Money& balance, uint64_t& records){       //False on damage, including a balance that no records explain
+            int64_t cents;
+
+            if(!getSigned(cents) || !getVarint(records)){
+                return false;
+            }
+
+            if(records == 0 && cents != 0){
+                failed = true;
+                return false;
+            }
+
+            balance = Money::fromCents(cents);
+            previousBalance = 0;
+            previousTime = 0;
+            finalBalance = cents;
+            remaining = records;
+            return true;
+        }
+
+        bool nextRecord(TransactionType& type, Money& oldBalance, Money& change, int64_t& timestamp){
+            uint64_t head;
+            int64_t balanceDelta, timeDelta;
+
+            if(!getVarint(head) || !getSigned(balanceDelta) || !getSigned(timeDelta)){
+                return false;
+            }
+
+            uint64_t zigzag = head >> 2;
+            int64_t changeCents = int64_t(zigzag >> 1) ^ -int64_t(zigzag & 1);
+
+            type = TransactionType(head & 3);
+            oldBalance = Money::fromCents(previousBalance + balanceDelta);
+            change = Money::fromCents(changeCents);
+            timestamp = previousTime + timeDelta;
+            previousBalance = oldBalance.getCents() + changeCents;
+            previousTime = timestamp;
+
+            if(remaining > 0 && --remaining == 0 && previousBalance != finalBalance){         //History and balance disagree, importing it would leave an account whose records don't add up
+                failed = true;
+                return false;
+            }
+
+            return true;
+        }
+
+        uint64_t bytesRead() const{
+            return consumed + position;
+        }
+};
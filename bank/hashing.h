@@ -0,0 +1,406 @@
+#pragma once                                                        //PBKDF2 and scrypt through OpenSSL, and the password hasher with its login cache
+
+#include "history.h"
+
+inline void fillRandom(void* destination, size_t size){    //Kernel CSPRNG, for salts and the login cache key
+    uint8_t* bytes = static_cast<uint8_t*>(destination);
+
+    while(size > 0){
+        ssize_t got = ::getrandom(bytes, size, 0);
+
+        if(got < 0){
+            if(errno == EINTR){
+                continue;
+            }
+
+            throw std::runtime_error("getrandom failed");
+        }
+
+        bytes += got;
+        size -= size_t(got);
+    }
+}
+
+inline bool equalConstantTime(const uint8_t* first, const uint8_t* second, size_t size){  //Looks at every byte whatever the first difference, so the time taken says nothing about where it was
+    return CRYPTO_memcmp(first, second, size) == 0;
+}
+
+class HmacSha256{                                       //HMAC-SHA-256 through OpenSSL's EVP_MAC, with one context per thread so mac() never allocates
+    private:
+        string key;
+
+        static EVP_MAC_CTX* threadContext(){            //Fetched and set to SHA-256 once per thread, each mac() only re-keys it
+            static thread_local std::unique_ptr<EVP_MAC_CTX, decltype(&EVP_MAC_CTX_free)> context(nullptr, &EVP_MAC_CTX_free);
+
+            if(context == nullptr){
+                EVP_MAC* hmac = EVP_MAC_fetch(nullptr, "HMAC", nullptr);
+                context.reset(hmac == nullptr ? nullptr : EVP_MAC_CTX_new(hmac));
+                EVP_MAC_free(hmac);
+                char digest[] = "SHA256";
+                OSSL_PARAM params[] = {OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0), OSSL_PARAM_construct_end()};
+
+                if(context == nullptr || EVP_MAC_CTX_set_params(context.get(), params) != 1){
+                    context.reset();
+                    throw std::runtime_error("HMAC-SHA-256 unavailable");
+                }
+            }
+
+            return context.get();
+        }
+
+    public:
+        HmacSha256(const void* secret, size_t size) : key(static_cast<const char*>(secret), size) {}
+
+        void mac(const void* first, size_t firstSize, const void* second, size_t secondSize, uint8_t (&result)[32]) const{     //MAC of first followed by second, result may alias either
+            EVP_MAC_CTX* context = threadContext();
+            size_t written = 0;
+
+            if(EVP_MAC_init(context, reinterpret_cast<const uint8_t*>(key.data()), key.size(), nullptr) != 1
+                || EVP_MAC_update(context, static_cast<const uint8_t*>(first), firstSize) != 1
+                || EVP_MAC_update(context, static_cast<const uint8_t*>(second), secondSize) != 1
+                || EVP_MAC_final(context, result, &written, sizeof(result)) != 1 || written != sizeof(result)){
+                throw std::runtime_error("HMAC-SHA-256 failed");
+            }
+        }
+};
+
+inline void pbkdf2Sha256(std::string_view password, const uint8_t* salt, size_t saltSize, uint32_t iterations, uint8_t* output, size_t outputSize){ //RFC 8018 PBKDF2 with HMAC-SHA-256 as the PRF, OpenSSL's PKCS5_PBKDF2_HMAC
+    if(PKCS5_PBKDF2_HMAC(password.data(), int(password.size()), salt, int(saltSize), int(iterations), EVP_sha256(), int(outputSize), output) != 1){
+        throw std::runtime_error("PBKDF2 failed");
+    }
+}
+
+inline void scryptDerive(std::string_view password, const uint8_t* salt, size_t saltSize, unsigned costLog2, size_t blockSize, size_t parallelism, uint8_t* output, size_t outputSize){       //RFC 7914 scrypt, OpenSSL's EVP_PBE_scrypt
+    uint64_t rounds = uint64_t(1) << costLog2;
+    uint64_t memoryLimit = 128 * blockSize * (rounds + 2 + parallelism);       //What EVP_PBE_scrypt allocates for these settings, its own 32MB default would refuse some that validHashSettings allows
+
+    if(EVP_PBE_scrypt(password.data(), password.size(), salt, saltSize, rounds, blockSize, parallelism, memoryLimit, output, outputSize) != 1){
+        throw std::runtime_error("scrypt failed");
+    }
+}
+
+enum class HashScheme : uint8_t{                        //Stored in every hash, so accounts keep verifying after the settings change
+    Pbkdf2Sha256 = 1,
+    Scrypt = 2
+};
+
+struct HashSettings{                                    //How new password hashes are made, text form "scrypt[:log2 N[:r[:p]]]" or "pbkdf2[:iterations]"
+    HashScheme scheme = HashScheme::Scrypt;
+    uint32_t cost = 14;                                 //scrypt log2 N, PBKDF2 iterations -- the default is scrypt's interactive-login setting, 16MB and tens of ms
+    uint8_t blockSize = 8;                              //scrypt r
+    uint8_t parallelism = 1;                            //scrypt p
+};
+
+struct PasswordHash{                                    //What an account keeps instead of its password, fixed size so it sits inline in the account and in snapshot rows
+    uint8_t scheme;
+    uint8_t blockSize;
+    uint8_t parallelism;
+    uint8_t reserved;
+    uint32_t cost;
+    uint8_t salt[16];
+    uint8_t key[32];
+};
+
+inline bool validHashSettings(HashScheme scheme, uint64_t cost, uint64_t blockSize, uint64_t parallelism){  //Keeps a damaged file or a typo from asking for terabytes or years
+    if(scheme == HashScheme::Pbkdf2Sha256){
+        return cost >= 1 && cost <= 10000000;
+    }
+
+    return scheme == HashScheme::Scrypt && cost >= 1 && cost <= 24 && blockSize >= 1 && blockSize <= 32 && parallelism >= 1 && parallelism <= 16 && ((128 * blockSize) << cost) <= (uint64_t(1) << 30);
+}
+
+inline bool parseHashSettings(std::string_view text, HashSettings& settings){
+    std::string_view fields[4];
+    size_t count = 0;
+
+    while(true){
+        size_t colon = text.find(':');
+
+        if(count == 4){
+            return false;
+        }
+
+        fields[count++] = text.substr(0, colon);
+
+        if(colon == std::string_view::npos){
+            break;
+        }
+
+        text.remove_prefix(colon + 1);
+    }
+
+    uint64_t numbers[3] = {0, 8, 1};
+
+    for(size_t i = 1; i < count; i++){
+        auto [end, error] = std::from_chars(fields[i].data(), fields[i].data() + fields[i].size(), numbers[i - 1]);
+
+        if(error != std::errc() || end != fields[i].data() + fields[i].size()){
+            return false;
+        }
+    }
+
+    if(fields[0] == "scrypt"){
+        HashSettings chosen{HashScheme::Scrypt, count > 1 ? uint32_t(numbers[0]) : 14, uint8_t(numbers[1]), uint8_t(numbers[2])};
+
+        if(!validHashSettings(chosen.scheme, count > 1 ? numbers[0] : 14, numbers[1], numbers[2])){
+            return false;
+        }
+
+        settings = chosen;
+        return true;
+    }
+
+    if(fields[0] == "pbkdf2" && count <= 2 && validHashSettings(HashScheme::Pbkdf2Sha256, count > 1 ? numbers[0] : 600000, 0, 0)){
+        settings = HashSettings{HashScheme::Pbkdf2Sha256, count > 1 ? uint32_t(numbers[0]) : 600000, 0, 0};
+        return true;
+    }
+
+    return false;
+}
+
+inline string describeHashSettings(const HashSettings& settings){
+    if(settings.scheme == HashScheme::Pbkdf2Sha256){
+        return "pbkdf2:" + std::to_string(settings.cost);
+    }
+
+    return "scrypt:" + std::to_string(settings.cost) + ":" + std::to_string(settings.blockSize) + ":" + std::to_string(settings.parallelism);
+}
+
+inline string encodeHash(const PasswordHash& hash){     //One token for the log: "scrypt$<log2 N>$<r>$<p>$<salt>$<key>" or "pbkdf2$<iterations>$<salt>$<key>", salt and key in hex
+    static const char digits[] = "0123456789abcdef";
+    string text = HashScheme(hash.scheme) == HashScheme::Scrypt ? "scrypt$" + std::to_string(hash.cost) + "$" + std::to_string(hash.blockSize) + "$" + std::to_string(hash.parallelism) : "pbkdf2$" + std::to_string(hash.cost);
+
+    auto appendHex = [&text](const uint8_t* bytes, size_t size){
+        text += '$';
+
+        for(size_t i = 0; i < size; i++){
+            text += digits[bytes[i] >> 4];
+            text += digits[bytes[i] & 15];
+        }
+    };
+
+    appendHex(hash.salt, sizeof(hash.salt));
+    appendHex(hash.key, sizeof(hash.key));
+    return text;
+}
+
+inline bool decodeHash(std::string_view text, PasswordHash& hash){
+    std::string_view fields[6];
+    size_t count = 0;
+
+    while(true){
+        size_t dollar = text.find('$');
+
+        if(count == 6){
+            return false;
+        }
+
+        fields[count++] = text.substr(0, dollar);
+
+        if(dollar == std::string_view::npos){
+            break;
+        }
+
+        text.remove_prefix(dollar + 1);
+    }
+
+    bool scrypt = fields[0] == "scrypt";
+
+    if(count != (scrypt ? 6u : 4u) || (!scrypt && fields[0] != "pbkdf2")){
+        return false;
+    }
+
+    uint64_t numbers[3] = {0, 0, 0};
+
+    for(size_t i = 1; i < count - 2; i++){
+        auto [end, error] = std::from_chars(fields[i].data(), fields[i].data() + fields[i].size(), numbers[i - 1]);
+
+        if(error != std::errc() || end != fields[i].data() + fields[i].size()){
+            return false;
+        }
+    }
+
+    PasswordHash decoded{};
+    decoded.scheme = uint8_t(scrypt ? HashScheme::Scrypt : HashScheme::Pbkdf2Sha256);
+
+    if(!validHashSettings(HashScheme(decoded.scheme), numbers[0], numbers[1], numbers[2])){
+        return false;
+    }
+
+    decoded.cost = uint32_t(numbers[0]);
+    decoded.blockSize = uint8_t(numbers[1]);
+    decoded.parallelism = uint8_t(numbers[2]);
+
+    auto hex = [](std::string_view digits, uint8_t* bytes, size_t size){
+        if(digits.size() != 2 * size){
+            return false;
+        }
+
+        for(size_t i = 0; i < 2 * size; i++){
+            char c = digits[i];
+            int value = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+
+            if(value < 0){
+                return false;
+            }
+
+            bytes[i / 2] = uint8_t(i % 2 == 0 ? value << 4 : bytes[i / 2] | value);
+        }
+
+        return true;
+    };
+
+    if(!hex(fields[count - 2], decoded.salt, sizeof(decoded.salt)) || !hex(fields[count - 1], decoded.key, sizeof(decoded.key))){
+        return false;
+    }
+
+    hash = decoded;
+    return true;
+}
+
+class PasswordHasher{                                   //Process-wide hashing settings and the verified-login cache -- configure before threads start; verify() goes by whatever each stored hash says
+    private:
+        struct CacheEntry{                              //Keyed digest of (stored hash, password) from a login that passed, so the same login again skips the KDF until it expires -- never handed to a client, so it's no session token and a hit still needs the password
+            uint8_t token[32];
+            int64_t expires;
+        };
+
+        static constexpr size_t cacheSlots = 16384;     //Direct-mapped on the salt, so each account holds at most one entry
+        static constexpr size_t cacheStripes = 64;
+
+        static HashSettings settings;
+        static int64_t cacheMicros;                     //0 turns the cache off
+        static CacheEntry cache[cacheSlots];            //Sessions live with the connection that logged in (SessionServer), this only spares the KDF when the same user signs in again, e.g. from a new connection
+        static std::mutex stripes[cacheStripes];
+
+        static const HmacSha256& cacheKey(){            //Random per process, so a token is worthless outside it and a restart drops every entry
+            static const HmacSha256 key = [](){
+                uint8_t secret[32];
+                fillRandom(secret, sizeof(secret));
+                return HmacSha256(secret, sizeof(secret));
+            }();
+
+            return key;
+        }
+
+        static void derive(const PasswordHash& stored, std::string_view password, uint8_t (&key)[32]){
+            if(HashScheme(stored.scheme) == HashScheme::Scrypt){
+                scryptDerive(password, stored.salt, sizeof(stored.salt), stored.cost, stored.blockSize, stored.parallelism, key, sizeof(key));
+
+            } else {
+                pbkdf2Sha256(password, stored.salt, sizeof(stored.salt), stored.cost, key, sizeof(key));
+            }
+        }
+
+    public:
+        static void configure(const HashSettings& chosen){
+            settings = chosen;
+        }
+
+        static const HashSettings& current(){
+            return settings;
+        }
+
+        static void setCacheSeconds(unsigned seconds){
+            cacheMicros = int64_t(seconds) * 1000000;
+
+            for(CacheEntry& entry : cache){
+                entry.expires = 0;
+            }
+        }
+
+        static PasswordHash hash(std::string_view password){         //Fresh salt, current settings -- the slow part of creating an account or changing a password, so callers do it outside their locks
+            PasswordHash result{};
+            result.scheme = uint8_t(settings.scheme);
+            result.blockSize = settings.blockSize;
+            result.parallelism = settings.parallelism;
+            result.cost = settings.cost;
+            fillRandom(result.salt, sizeof(result.salt));
+            derive(result, password, result.key);
+            return result;
+        }
+
+        static bool verify(const PasswordHash& stored, std::string_view attempt){        //Constant-time compare of the derived key, through the cache when it's on; a failed attempt always pays the full KDF, so guessing gets no cheaper, and a new password changes the stored hash the digest covers
+            if(!validHashSettings(HashScheme(stored.scheme), stored.cost, stored.blockSize, stored.parallelism)){
+                return false;
+            }
+
+            uint8_t token[32];
+            size_t slot = 0;
+
+            if(cacheMicros > 0){
+                cacheKey().mac(&stored, sizeof(stored), attempt.data(), attempt.size(), token);
+                memcpy(&slot, stored.salt, sizeof(slot));
+                slot &= cacheSlots - 1;
+
+                std::lock_guard<std::mutex> guard(stripes[slot % cacheStripes]);
+
+                if(cache[slot].expires > nowMicros() && equalConstantTime(cache[slot].token, token, sizeof(token))){
+                    return true;
+                }
+            }
+
+            uint8_t key[32];
+            derive(stored, attempt, key);
+
+            if(!equalConstantTime(key, stored.key, sizeof(key))){
+                return false;
+            }
+
+            if(cacheMicros > 0){
+                std::lock_guard<std::mutex> guard(stripes[slot % cacheStripes]);
+                memcpy(cache[slot].token, token, sizeof(token));
+                cache[slot].expires = nowMicros() + cacheMicros;
+            }
+
+            return true;
+        }
+
+        static void burn(std::string_view attempt){      //A verification's worth of work against nothing, so an unknown username answers as slowly as a wrong password
+            PasswordHash decoy{};
+            decoy.scheme = uint8_t(settings.scheme);
+            decoy.blockSize = settings.blockSize;
+            decoy.parallelism = settings.parallelism;
+            decoy.cost = settings.cost;
+            uint8_t key[32];
+            derive(decoy, attempt, key);
+            equalConstantTime(key, decoy.key, sizeof(key));
+        }
+};
+
+inline HashSettings PasswordHasher::settings;
+inline int64_t PasswordHasher::cacheMicros = 300 * 1000000LL; //Five minutes
+inline PasswordHasher::CacheEntry PasswordHasher::cache[PasswordHasher::cacheSlots];
+inline std::mutex PasswordHasher::stripes[PasswordHasher::cacheStripes];
+
+inline bool checkHashVectors(std::ostream& report, bool thorough){ //Published known answers (RFC 4231, RFC 7914) through the calls the password hashes make, for the hashes test and --bench login -- thorough adds RFC 7914's 1MB scrypt vector, which takes tens of ms
+    auto hex = [](const uint8_t* bytes, size_t size){
+        string text;
+
+        for(size_t i = 0; i < size; i++){
+            text += "0123456789abcdef"[bytes[i] >> 4];
+            text += "0123456789abcdef"[bytes[i] & 15];
+        }
+
+        return text;
+    };
+
+    uint8_t digest[32];
+    HmacSha256("Jefe", 4).mac("what do ya want ", 16, "for nothing?", 12, digest);
+    bool hmacOk = hex(digest, 32) == "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843";
+
+    uint8_t derived[64];
+    pbkdf2Sha256("passwd", reinterpret_cast<const uint8_t*>("salt"), 4, 1, derived, 64);
+    bool pbkdf2Ok = hex(derived, 64) == "55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783";
+
+    scryptDerive("", reinterpret_cast<const uint8_t*>(""), 0, 4, 1, 1, derived, 64);
+    bool scryptOk = hex(derived, 64) == "77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906";
+
+    if(thorough){
+        scryptDerive("password", reinterpret_cast<const uint8_t*>("NaCl"), 4, 10, 8, 16, derived, 64);
+        scryptOk = scryptOk && hex(derived, 64) == "fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b3731622eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640";
+    }
+
+    report << "known answers: hmac " << (hmacOk ? "ok" : "FAILED") << ", pbkdf2 " << (pbkdf2Ok ? "ok" : "FAILED") << ", scrypt " << (scryptOk ? "ok" : "FAILED") << "\n";
+    return hmacOk && pbkdf2Ok && scryptOk;
+}
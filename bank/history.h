@@ -0,0 +1,627 @@
+#pragma once                                                        //Transaction histories, their column kernels and renderers
+
+#include "pool.h"
+
+class Transaction{                          //One history record as handed to visitors, decoded from a TransactionChunk's columns -- new balance is stored, old balance is derived
+    private:
+        Money oldBalance;
+        Money balanceChange;
+        int64_t timestamp;                      //Microseconds since the epoch, 0 if unknown
+        TransactionType type;
+
+    public:        
+        Transaction(TransactionType w, Money x, Money y, int64_t z = 0) : oldBalance(x), balanceChange(y), timestamp(z), type(w) {}
+
+        TransactionType getType() const{
+            return type;
+        }
+
+        Money getOldBalance() const{
+            return oldBalance;
+        }
+
+        Money getBalanceChange() const{
+            return balanceChange;
+        }
+
+        Money getNewBalance() const{
+            return oldBalance + balanceChange;
+        }
+
+        int64_t getTimestamp() const{
+            return timestamp;
+        }
+
+        void displayTransaction() const{                //Method to be called by TransactionHistory class
+            cout << "\n***************************************\n";
+            cout << "Transaction type: " << typeName(type) << "\n";
+            cout << "\nOld Balance: $" << oldBalance << "\n";
+            if(balanceChange > Money()){
+                cout << "Transaction: +$" << balanceChange << "\n";
+
+            } else {
+                cout << "Transaction: -$" << balanceChange.magnitude() << "\n";                //Convert to positive for display
+            }
+
+            cout << "End Balance: $" << getNewBalance() << "\n";
+        }
+};
+
+class TransactionChunk{                     //One arena block: header followed in the same pool block by one column per field (balance, amount, timestamp, type), linked in chronological order
+    private:
+        uint32_t capacity;
+        uint32_t count;
+        size_t sizeClass;
+        TransactionChunk* next;
+
+        int64_t* column(size_t index) const{            //Columns live directly after the header, capacity entries each: 0 balance after, 1 amount, 2 timestamp, then the type bytes
+            return reinterpret_cast<int64_t*>(const_cast<TransactionChunk*>(this) + 1) + index * capacity;
+        }
+
+        explicit TransactionChunk(size_t blockClass) : capacity(uint32_t(recordsIn(blockClass))), count(0), sizeClass(blockClass), next(nullptr) {}
+
+    public:
+        static constexpr size_t recordBytes = 3 * sizeof(int64_t) + sizeof(TransactionType);
+
+        static constexpr size_t recordsIn(size_t blockClass){       //Capacity is whatever fills the block, so a chunk never leaves class slack unused
+            return (BlockSizes::classBytes(blockClass) - sizeof(TransactionChunk)) / recordBytes;
+        }
+
+        static TransactionChunk* create(size_t blockClass){        //nullptr if the pool is out of memory
+            void* block = NodePool::allocate(blockClass);
+            return block == nullptr ? nullptr : new (block) TransactionChunk(blockClass);
+        }
+
+        static void destroy(TransactionChunk* chunk){             //Columns are plain integers, so the block just goes back
+            NodePool::release(chunk, chunk -> sizeClass);
+        }
+
+        size_t getSizeClass() const{
+            return sizeClass;
+        }
+
+        bool full() const{
+            return count == capacity;
+        }
+
+        void append(TransactionType type, Money newBalance, Money balanceChange, int64_t timestamp){        //Caller checks full() first
+            column(0)[count] = newBalance.getCents();
+            column(1)[count] = balanceChange.getCents();
+            column(2)[count] = timestamp;
+            types()[count] = static_cast<uint8_t>(type);
+            count++;
+        }
+
+        size_t size() const{
+            return count;
+        }
+
+        size_t getCapacity() const{
+            return capacity;
+        }
+
+        const int64_t* balances() const{                 //Balance after each record, in cents
+            return column(0);
+        }
+
+        const int64_t* amounts() const{                  //Signed change in cents, withdrawals are negative
+            return column(1);
+        }
+
+        const int64_t* timestamps() const{
+            return column(2);
+        }
+
+        uint8_t* types() const{
+            return reinterpret_cast<uint8_t*>(column(3));
+        }
+
+        Transaction at(size_t i) const{
+            Money change = Money::fromCents(amounts()[i]);
+            return Transaction(TransactionType(types()[i]), Money::fromCents(balances()[i]) - change, change, timestamps()[i]);
+        }
+
+        TransactionChunk* getNext() const{
+            return next;
+        }
+
+        void setNext(TransactionChunk* newNext){
+            next = newNext;
+        }
+};
+
+struct ColumnKernels{                                   //Aggregations over one chunk's columns: an AVX2 version where the CPU has it and a scalar one everywhere else
+    static bool vectorized;                             //Picked once at startup, the benchmark flips it to time both
+
+    static int64_t sumWhereScalar(const int64_t* values, const uint8_t* types, size_t n, uint8_t type){
+        int64_t total = 0;
+
+        for(size_t i = 0; i < n; i++){
+            total += values[i] & -int64_t(types[i] == type);           //Mask rather than branch, the types are close to random
+        }
+
+        return total;
+    }
+
+    static void minMaxScalar(const int64_t* values, size_t n, int64_t& low, int64_t& high){
+        for(size_t i = 0; i < n; i++){
+            low = std::min(low, values[i]);
+            high = std::max(high, values[i]);
+        }
+    }
+
+    static size_t countWhereScalar(const uint8_t* types, size_t n, uint8_t type){
+        size_t matches = 0;
+
+        for(size_t i = 0; i < n; i++){
+            matches += types[i] == type;
+        }
+
+        return matches;
+    }
+
+#if defined(__x86_64__)
+    __attribute__((target("avx2"))) static int64_t sumWhereAvx2(const int64_t* values, const uint8_t* types, size_t n, uint8_t type){      //8 records per step: widen the type bytes to 64-bit lanes, mask the amounts, add
+        __m256i wanted = _mm256_set1_epi64x(type);
+        __m256i first = _mm256_setzero_si256(), second = _mm256_setzero_si256();
+        size_t i = 0;
+
+        for(; i + 8 <= n; i += 8){
+            int64_t codes;
+            memcpy(&codes, types + i, sizeof(codes));
+            __m128i packed = _mm_cvtsi64_si128(codes);
+            __m256i lowMask = _mm256_cmpeq_epi64(_mm256_cvtepu8_epi64(packed), wanted);
+            __m256i highMask = _mm256_cmpeq_epi64(_mm256_cvtepu8_epi64(_mm_srli_si128(packed, 4)), wanted);
+            first = _mm256_add_epi64(first, _mm256_and_si256(lowMask, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i))));
+            second = _mm256_add_epi64(second, _mm256_and_si256(highMask, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i + 4))));
+        }
+
+        alignas(32) int64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(first, second));
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sumWhereScalar(values + i, types + i, n - i, type);
+    }
+
+    __attribute__((target("avx2"))) static void minMaxAvx2(const int64_t* values, size_t n, int64_t& low, int64_t& high){      //No 64-bit min/max in AVX2, so compare and blend
+        __m256i lows[2] = {_mm256_set1_epi64x(low), _mm256_set1_epi64x(low)};
+        __m256i highs[2] = {_mm256_set1_epi64x(high), _mm256_set1_epi64x(high)};
+        size_t i = 0;
+
+        for(; i + 8 <= n; i += 8){                      //Two independent accumulators, so each blend doesn't wait on the previous one
+            for(int half = 0; half < 2; half++){
+                __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i + 4 * half));
+                lows[half] = _mm256_blendv_epi8(lows[half], value, _mm256_cmpgt_epi64(lows[half], value));
+                highs[half] = _mm256_blendv_epi8(highs[half], value, _mm256_cmpgt_epi64(value, highs[half]));
+            }
+        }
+
+        __m256i lowest = _mm256_blendv_epi8(lows[0], lows[1], _mm256_cmpgt_epi64(lows[0], lows[1]));
+        __m256i highest = _mm256_blendv_epi8(highs[0], highs[1], _mm256_cmpgt_epi64(highs[1], highs[0]));
+        alignas(32) int64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), lowest);
+        low = std::min({low, lanes[0], lanes[1], lanes[2], lanes[3]});
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), highest);
+        high = std::max({high, lanes[0], lanes[1], lanes[2], lanes[3]});
+        minMaxScalar(values + i, n - i, low, high);
+    }
+
+    __attribute__((target("avx2"))) static size_t countWhereAvx2(const uint8_t* types, size_t n, uint8_t type){        //32 type bytes per step, byte counters folded with SAD before they can wrap
+        __m256i wanted = _mm256_set1_epi8(char(type));
+        __m256i totals = _mm256_setzero_si256();
+        size_t i = 0;
+
+        while(i + 32 <= n){
+            __m256i counters = _mm256_setzero_si256();
+
+            for(size_t step = 0; step < 255 && i + 32 <= n; step++, i += 32){
+                __m256i match = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(types + i)), wanted);
+                counters = _mm256_sub_epi8(counters, match);            //A match is -1
+            }
+
+            totals = _mm256_add_epi64(totals, _mm256_sad_epu8(counters, _mm256_setzero_si256()));
+        }
+
+        alignas(32) int64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), totals);
+        return size_t(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + countWhereScalar(types + i, n - i, type);
+    }
+
+    static bool detect(){
+        return __builtin_cpu_supports("avx2");
+    }
+#else
+    static bool detect(){
+        return false;
+    }
+#endif
+
+    static int64_t sumWhere(const int64_t* values, const uint8_t* types, size_t n, uint8_t type){
+#if defined(__x86_64__)
+        if(vectorized){
+            return sumWhereAvx2(values, types, n, type);
+        }
+#endif
+        return sumWhereScalar(values, types, n, type);
+    }
+
+    static void minMax(const int64_t* values, size_t n, int64_t& low, int64_t& high){
+#if defined(__x86_64__)
+        if(vectorized){
+            minMaxAvx2(values, n, low, high);
+            return;
+        }
+#endif
+        minMaxScalar(values, n, low, high);
+    }
+
+    static size_t countWhere(const uint8_t* types, size_t n, uint8_t type){
+#if defined(__x86_64__)
+        if(vectorized){
+            return countWhereAvx2(types, n, type);
+        }
+#endif
+        return countWhereScalar(types, n, type);
+    }
+};
+
+inline bool ColumnKernels::vectorized = ColumnKernels::detect();
+
+struct HistorySummary{                                  //What statements and audits want from a history without looking at each record
+    Money deposits;
+    Money withdrawals;                                  //Negative, as stored
+    size_t depositCount = 0;
+    size_t withdrawalCount = 0;
+    Money transfersIn;
+    Money transfersOut;                                 //Negative too
+    size_t transferInCount = 0;
+    size_t transferOutCount = 0;
+    Money lowBalance;                                   //Over the balance after each record, zero when there are no records
+    Money highBalance;
+};
+
+class TransactionHistory{           //Append-only chunked arena for transaction history -- records are packed into blocks that double in size, so appends are O(1) and iteration is mostly sequential
+    private:
+        static constexpr size_t firstChunkClass = BlockSizes::classFor(sizeof(TransactionChunk) + 8 * TransactionChunk::recordBytes);      //Most accounts only see a handful of records, so start small
+        static constexpr size_t maxChunkClass = BlockSizes::classCount - 1;          //128KB blocks (~5400 records) for heavy accounts
+
+        struct Checkpoint{                  //Where a chunk starts in time -- balances are stored per record, so this is all a time query needs to land near its answer
+            int64_t firstTimestamp;
+            const TransactionChunk* chunk;
+        };
+
+        TransactionChunk* head = nullptr;
+        TransactionChunk* tail = nullptr;
+        size_t records;
+        vector<Checkpoint> checkpoints;     //One per chunk, only built once there's a second chunk so small histories never allocate it
+
+        void releaseChunks(){               //Whole chunks go back to the pool, not individual records
+            while(head != nullptr){
+                TransactionChunk* next = head -> getNext();
+                TransactionChunk::destroy(head);
+                head = next;
+            }
+
+            tail = nullptr;
+            checkpoints.clear();
+            checkpoints.shrink_to_fit();
+        }
+
+        const TransactionChunk* chunkAt(int64_t micros, bool inclusive) const{     //Last chunk starting at or before micros (strictly before if !inclusive), nullptr if none does
+            if(checkpoints.empty()){
+                bool starts = head != nullptr && head -> size() > 0 && (inclusive ? head -> timestamps()[0] <= micros : head -> timestamps()[0] < micros);
+                return starts ? head : nullptr;
+            }
+
+            auto after = inclusive ? std::upper_bound(checkpoints.begin(), checkpoints.end(), micros, [](int64_t value, const Checkpoint& checkpoint){
+                                         return value < checkpoint.firstTimestamp;
+                                     })
+                                   : std::lower_bound(checkpoints.begin(), checkpoints.end(), micros, [](const Checkpoint& checkpoint, int64_t value){
+                                         return checkpoint.firstTimestamp < value;
+                                     });
+
+            return after == checkpoints.begin() ? nullptr : std::prev(after) -> chunk;
+        }
+
+    public:
+        TransactionHistory() : head(nullptr), tail(nullptr), records(0) {}             //Simple constructor for head pointer
+
+        ~TransactionHistory(){
+            releaseChunks();
+        }
+
+        TransactionHistory(const TransactionHistory&) = delete;
+        TransactionHistory& operator=(const TransactionHistory&) = delete;
+
+        void clear(){                       //Drop every record, used when an account is rebuilt from a snapshot
+            releaseChunks();
+            records = 0;
+        }
+
+        int64_t addRecord(TransactionType type, Money oldBalance, Money balanceChange, int64_t timestamp = 0){      //Append to the tail chunk, opening a larger one when it fills up; returns the time stamped on it
+            if(timestamp == 0){                 //0 means now
+                timestamp = nowMicros();
+            }
+
+            if(tail != nullptr && tail -> size() > 0){          //Never behind the previous record, so the time queries can binary search even if the clock steps back
+                timestamp = std::max(timestamp, tail -> timestamps()[tail -> size() - 1]);
+            }
+
+            if(tail == nullptr || tail -> full()){
+                size_t sizeClass = tail == nullptr ? firstChunkClass : std::min(tail -> getSizeClass() + 2, maxChunkClass);      //Two classes up is twice the bytes
+                TransactionChunk* newChunk = TransactionChunk::create(sizeClass);
+
+                if(newChunk == nullptr){                    //Failure handling if the pool cannot map more memory
+                    cout << "Error in transaction memory allocation: out of memory\n";
+                    return timestamp;
+                }
+
+                if(head == nullptr){                  //If head is null, set both head and tail to new chunk
+                    head = newChunk;
+                    tail = newChunk;
+
+                } else {                            //If head is not null, set next pointer of tail to new chunk, set tail to new chunk
+                    if(checkpoints.empty()){
+                        checkpoints.push_back({head -> timestamps()[0], head});
+                    }
+
+                    checkpoints.push_back({timestamp, newChunk});
+                    tail -> setNext(newChunk);
+                    tail = newChunk;
+                }
+            }
+
+            tail -> append(type, oldBalance + balanceChange, balanceChange, timestamp);
+            records++;
+            return timestamp;
+        }
+
+        Money balanceAsOf(int64_t micros) const{        //Balance after the last record stamped at or before micros, zero before the first one
+            const TransactionChunk* chunk = chunkAt(micros, true);
+
+            if(chunk == nullptr){
+                return Money();
+            }
+
+            const int64_t* times = chunk -> timestamps();
+            size_t index = std::upper_bound(times, times + chunk -> size(), micros) - times;        //At least 1, the chunk starts at or before micros
+            return Money::fromCents(chunk -> balances()[index - 1]);
+        }
+
+        template<typename Visitor>
+        size_t forEachBetween(int64_t from, int64_t to, Visitor&& visit) const{        //Records stamped in [from, to] in order, found by binary search rather than a walk from the head; returns how many
+            const TransactionChunk* chunk = chunkAt(from, false);
+            size_t index = 0;
+
+            if(chunk == nullptr){
+                chunk = head;
+
+            } else {
+                const int64_t* times = chunk -> timestamps();
+                index = std::lower_bound(times, times + chunk -> size(), from) - times;
+            }
+
+            size_t visited = 0;
+
+            for(; chunk != nullptr; chunk = chunk -> getNext(), index = 0){
+                for(; index < chunk -> size(); index++){
+                    if(chunk -> timestamps()[index] > to){
+                        return visited;
+                    }
+
+                    visit(chunk -> at(index));
+                    visited++;
+                }
+            }
+
+            return visited;
+        }
+
+        template<typename Kernel>
+        void forEachChunk(Kernel&& kernel) const{       //Hands each chunk's columns to kernel, for aggregates that don't need Transaction objects
+            for(const TransactionChunk* chunk = head; chunk != nullptr; chunk = chunk -> getNext()){
+                kernel(*chunk);
+            }
+        }
+
+        Money sumOf(TransactionType type) const{        //Total change over records of one type, withdrawals come out negative
+            int64_t total = 0;
+            forEachChunk([&](const TransactionChunk& chunk){
+                total += ColumnKernels::sumWhere(chunk.amounts(), chunk.types(), chunk.size(), static_cast<uint8_t>(type));
+            });
+            return Money::fromCents(total);
+        }
+
+        size_t countOf(TransactionType type) const{
+            size_t matches = 0;
+            forEachChunk([&](const TransactionChunk& chunk){
+                matches += ColumnKernels::countWhere(chunk.types(), chunk.size(), static_cast<uint8_t>(type));
+            });
+            return matches;
+        }
+
+        std::pair<Money, Money> balanceRange() const{   //Lowest and highest balance after any record, zeros if there are none
+            int64_t low = std::numeric_limits<int64_t>::max(), high = std::numeric_limits<int64_t>::min();
+            forEachChunk([&](const TransactionChunk& chunk){
+                ColumnKernels::minMax(chunk.balances(), chunk.size(), low, high);
+            });
+            return records == 0 ? std::make_pair(Money(), Money()) : std::make_pair(Money::fromCents(low), Money::fromCents(high));
+        }
+
+        HistorySummary summarize() const{
+            HistorySummary summary;
+            summary.deposits = sumOf(TransactionType::Deposit);
+            summary.withdrawals = sumOf(TransactionType::Withdrawal);
+            summary.depositCount = countOf(TransactionType::Deposit);
+            summary.withdrawalCount = countOf(TransactionType::Withdrawal);
+            summary.transfersIn = sumOf(TransactionType::TransferIn);
+            summary.transfersOut = sumOf(TransactionType::TransferOut);
+            summary.transferInCount = countOf(TransactionType::TransferIn);
+            summary.transferOutCount = countOf(TransactionType::TransferOut);
+            std::tie(summary.lowBalance, summary.highBalance) = balanceRange();
+            return summary;
+        }
+
+        template<typename Visitor>
+        void forEach(Visitor&& visit) const{            //Chronological walk, chunk by chunk
+            for(TransactionChunk* chunk = head; chunk != nullptr; chunk = chunk -> getNext()){
+                for(size_t i = 0; i < chunk -> size(); i++){
+                    visit(chunk -> at(i));
+                }
+            }
+        }
+
+        size_t size() const{
+            return records;
+        }
+
+        void displayRecords(){                //Records are stored in insertion order, so this iterates chronologically
+            forEach([](const Transaction& record){
+                record.displayTransaction();
+            });
+        }
+};
+
+enum class RenderFormat : unsigned char{
+    Text,                                               //Same layout displayTransaction prints
+    Csv,
+    Json
+};
+
+inline bool parseRenderFormat(std::string_view text, RenderFormat& format){
+    if(text == "text"){
+        format = RenderFormat::Text;
+
+    } else if(text == "csv"){
+        format = RenderFormat::Csv;
+
+    } else if(text == "json"){
+        format = RenderFormat::Json;
+
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+class HistoryRenderer{                                  //Formats records into one reusable buffer with to_chars and hands the sink large blocks, instead of ~10 stream insertions per record
+    private:
+        static constexpr size_t blockSize = 64 * 1024;
+        static constexpr size_t maxRecordBytes = 256;  //Worst case for one formatted record, flush before the buffer could overflow
+
+        char* buffer;
+        size_t used;
+        std::ostream* sink;
+        uint64_t written;
+
+        void append(std::string_view text){
+            memcpy(buffer + used, text.data(), text.size());
+            used += text.size();
+        }
+
+        void appendMoney(int64_t cents){                //Same text as Money::toString, e.g. "-20.00"
+            uint64_t magnitude = cents < 0 ? 0 - uint64_t(cents) : uint64_t(cents);
+
+            if(cents < 0){
+                buffer[used++] = '-';
+            }
+
+            used = std::to_chars(buffer + used, buffer + blockSize, magnitude / 100).ptr - buffer;
+            uint64_t fraction = magnitude % 100;
+            buffer[used++] = '.';
+            buffer[used++] = char('0' + fraction / 10);
+            buffer[used++] = char('0' + fraction % 10);
+        }
+
+        void appendRecord(const Transaction& record, RenderFormat format, bool first){
+            if(used + maxRecordBytes > blockSize){
+                flush();
+            }
+
+            int64_t change = record.getBalanceChange().getCents();
+
+            switch(format){
+                case RenderFormat::Text:
+                    append("\n***************************************\nTransaction type: ");
+                    append(typeName(record.getType()));
+                    append("\n\nOld Balance: $");
+                    appendMoney(record.getOldBalance().getCents());
+                    append(change > 0 ? "\nTransaction: +$" : "\nTransaction: -$");
+                    appendMoney(change < 0 ? -change : change);
+                    append("\nEnd Balance: $");
+                    appendMoney(record.getNewBalance().getCents());
+                    append("\n");
+                    break;
+
+                case RenderFormat::Csv:
+                    append(typeName(record.getType()));
+                    append(",");
+                    appendMoney(record.getOldBalance().getCents());
+                    append(",");
+                    appendMoney(change);
+                    append(",");
+                    appendMoney(record.getNewBalance().getCents());
+                    append("\n");
+                    break;
+
+                case RenderFormat::Json:
+                    append(first ? "\n{\"type\":\"" : ",\n{\"type\":\"");
+                    append(typeName(record.getType()));
+                    append("\",\"old_balance\":");
+                    appendMoney(record.getOldBalance().getCents());
+                    append(",\"change\":");
+                    appendMoney(change);
+                    append(",\"new_balance\":");
+                    appendMoney(record.getNewBalance().getCents());
+                    append("}");
+                    break;
+            }
+        }
+
+    public:
+        HistoryRenderer() : buffer(new char[blockSize]), used(0), sink(nullptr), written(0) {}
+
+        ~HistoryRenderer(){
+            delete[] buffer;
+        }
+
+        HistoryRenderer(const HistoryRenderer&) = delete;
+        HistoryRenderer& operator=(const HistoryRenderer&) = delete;
+
+        void flush(){
+            if(sink != nullptr && used > 0){
+                sink -> write(buffer, used);
+            }
+
+            written += used;
+            used = 0;
+        }
+
+        void render(const TransactionHistory& history, RenderFormat format, std::ostream& out){        //Whole history in one format, the sink sees 64KB writes
+            sink = &out;
+
+            if(format == RenderFormat::Csv){
+                append("type,old_balance,change,new_balance\n");
+
+            } else if(format == RenderFormat::Json){
+                append("[");
+            }
+
+            bool first = true;
+
+            history.forEach([&](const Transaction& record){
+                appendRecord(record, format, first);
+                first = false;
+            });
+
+            if(format == RenderFormat::Json){
+                append(first ? "]\n" : "\n]\n");
+            }
+
+            flush();
+            sink = nullptr;
+        }
+
+        uint64_t getWritten() const{                    //Bytes produced since construction, used for throughput numbers
+            return written;
+        }
+};
@@ -0,0 +1,334 @@
+#pragma once                                                        //The write-ahead log and its durability policies
+
+#include "snapshotFormat.h"
+
+enum class Durability : unsigned char{                //When a logged operation counts as durable
+    PerOp,                                              //write + fdatasync inside every append
+    Group,                                              //Appends are buffered, committers share one fdatasync (leader/follower group commit)
+    Async                                               //Appends are buffered and flushed by the background thread, commit never waits
+};
+
+inline bool syncDirectoryOf(const string& path){                    //fsync the directory holding path, so a file just created or renamed there survives a crash
+    size_t slash = path.rfind('/');
+    string directory = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    bool synced = fd >= 0 && ::fsync(fd) == 0;
+
+    if(fd >= 0){
+        ::close(fd);
+    }
+
+    return synced;
+}
+
+inline bool replaceDurably(const string& temporary, const string& path){     //Syncs temporary, renames it over path, then syncs the directory -- after a crash path holds the old file or all of the new one, never a partial one
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CLOEXEC);
+    bool synced = fd >= 0 && ::fsync(fd) == 0;
+
+    if(fd >= 0){
+        ::close(fd);
+    }
+
+    if(!synced || std::rename(temporary.c_str(), path.c_str()) != 0){
+        ::unlink(temporary.c_str());
+        return false;
+    }
+
+    return syncDirectoryOf(path);
+}
+
+class WriteAheadLog{                                    //Append-only operation log, one batch-format command per line (e.g. "DEPOSIT bob C 100.00"), replayed on startup to rebuild Bank
+    private:
+        string path;
+        int fd;
+        Durability policy;
+        std::chrono::microseconds interval;             //Background flush period for Group/Async
+        std::mutex lock;
+        std::condition_variable flushed;                //Signalled whenever durableLsn moves
+        std::condition_variable wake;                   //Wakes the background flusher early
+        string pending;                                 //Appended but not yet written
+        uint64_t appendedLsn;
+        uint64_t durableLsn;
+        uint64_t syncs;
+        bool flushing;
+        bool stopping;
+        bool failed;                                    //A write or sync failed: nothing past durableLsn may ever be acknowledged, and nothing more is written after the gap
+        uint64_t appendedBytes;                         //Where the log ends once everything appended so far is written
+        std::shared_mutex fence;                        //Shared from a change until its record is appended, exclusive while a snapshot captures, so the snapshot's offset splits the log exactly at what it saw
+        std::thread flusher;
+
+        static thread_local uint64_t lastAppended;      //Lets commit() wait for exactly what this thread appended
+
+        bool writeAll(const char* data, size_t size){
+            while(size > 0){
+                ssize_t written = ::write(fd, data, size);
+
+                if(written < 0 && errno == EINTR){
+                    continue;
+                }
+
+                if(written < 0){
+                    return false;
+                }
+
+                data += written;
+                size -= written;
+            }
+
+            return true;
+        }
+
+        void flushLocked(std::unique_lock<std::mutex>& guard){         //Caller becomes the group leader: writes everything pending with the lock dropped, then syncs once
+            flushing = true;
+            string batch;
+            batch.swap(pending);
+            uint64_t upTo = appendedLsn;
+            bool failedBefore = failed;
+            guard.unlock();
+
+            bool written = !failedBefore && writeAll(batch.data(), batch.size()) && ::fdatasync(fd) == 0;      //A failed fdatasync can't be retried safely, the kernel may already have dropped the dirty pages
+
+            guard.lock();
+            settle(written, upTo);
+            flushing = false;
+            flushed.notify_all();
+        }
+
+        void settle(bool written, uint64_t upTo){       //Caller holds lock: durableLsn only ever moves past records that were written and synced
+            if(written){
+                durableLsn = upTo;
+                syncs++;
+
+            } else if(!failed){
+                failed = true;
+                std::cerr << "Write-ahead log write failed: " << std::strerror(errno) << "\n";
+            }
+        }
+
+        void flusherLoop(){
+            std::unique_lock<std::mutex> guard(lock);
+
+            while(!stopping){
+                wake.wait_for(guard, interval);
+
+                if(!pending.empty() && !flushing){
+                    flushLocked(guard);
+                }
+            }
+        }
+
+    public:
+        WriteAheadLog(const string& logPath, Durability durability, std::chrono::microseconds flushInterval = std::chrono::microseconds(2000)) :
+            path(logPath), fd(::open(logPath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0600)), policy(durability), interval(flushInterval),
+            appendedLsn(0), durableLsn(0), syncs(0), flushing(false), stopping(false), failed(false), appendedBytes(0) {
+
+            struct stat info;
+
+            if(fd >= 0 && ::fstat(fd, &info) == 0){
+                appendedBytes = info.st_size;
+            }
+
+            if(fd >= 0 && policy != Durability::PerOp){
+                flusher = std::thread(&WriteAheadLog::flusherLoop, this);
+            }
+        }
+
+        ~WriteAheadLog(){                               //Stops the flusher and makes everything appended durable before closing
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                stopping = true;
+                wake.notify_all();
+            }
+
+            if(flusher.joinable()){
+                flusher.join();
+            }
+
+            if(fd >= 0){
+                std::unique_lock<std::mutex> guard(lock);
+
+                if(!pending.empty()){
+                    flushLocked(guard);
+                }
+
+                ::close(fd);
+            }
+        }
+
+        WriteAheadLog(const WriteAheadLog&) = delete;
+        WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+        bool isOpen() const{
+            return fd >= 0;
+        }
+
+        uint64_t append(const string& record){          //Record must already be applied in memory; it isn't acknowledged until commit() returns -- returns its log sequence number
+            std::unique_lock<std::mutex> guard(lock);
+            uint64_t lsn = lastAppended = ++appendedLsn;
+            appendedBytes += record.size() + 1;
+
+            if(policy == Durability::PerOp){            //No grouping, the lock is held across the sync so records stay in order
+                string line = record + '\n';
+                settle(!failed && writeAll(line.data(), line.size()) && ::fdatasync(fd) == 0, lsn);
+                return lsn;
+            }
+
+            pending += record;
+            pending += '\n';
+
+            if(pending.size() >= (1 << 20)){            //Don't let the buffer grow without bound between flushes
+                wake.notify_one();
+            }
+
+            return lsn;
+        }
+
+        static void adopt(uint64_t lsn){                //Makes this thread's next commit() wait for a record another thread appended on its behalf
+            lastAppended = std::max(lastAppended, lsn);
+        }
+
+        bool commit(){                                  //Blocks until this thread's appends are durable (Group waits for a sync, PerOp already synced, Async never waits) -- false if they never will be, the caller must not acknowledge them
+            std::unique_lock<std::mutex> guard(lock);
+
+            if(policy == Durability::Async){
+                return !failed;
+            }
+
+            uint64_t target = std::min(lastAppended, appendedLsn);        //lastAppended may be left over from another log instance
+
+            while(durableLsn < target){
+                if(failed){
+                    return false;
+                }
+
+                if(!flushing){
+                    flushLocked(guard);
+
+                } else {
+                    flushed.wait(guard);                //Another committer is leading a flush, ride along on its sync
+                }
+            }
+
+            return true;
+        }
+
+        static std::shared_lock<std::shared_mutex> admit(WriteAheadLog* log){        //Held by a change until its record is appended (an empty lock without a log)
+            return log == nullptr ? std::shared_lock<std::shared_mutex>() : std::shared_lock<std::shared_mutex>(log -> fence);
+        }
+
+        std::unique_lock<std::shared_mutex> quiesce(){  //Waits out changes in flight and holds off new ones, so what the caller reads matches endOffset()
+            return std::unique_lock<std::shared_mutex>(fence);
+        }
+
+        uint64_t endOffset(){                           //Byte offset just past the last record appended
+            std::lock_guard<std::mutex> guard(lock);
+            return appendedBytes;
+        }
+
+        bool flushAll(){                                //Write and sync everything appended so far -- false if that didn't make it to disk
+            std::unique_lock<std::mutex> guard(lock);
+
+            while(flushing){
+                flushed.wait(guard);
+            }
+
+            if(!pending.empty()){
+                flushLocked(guard);
+            }
+
+            return !failed;
+        }
+
+        bool hasFailed(){
+            std::lock_guard<std::mutex> guard(lock);
+            return failed;
+        }
+
+        bool preserve(const string& source, string& copy){         //Copies source next to the log and syncs it, so a record naming the copy replays the same however the original changes -- false (and no copy) on any error
+            copy = path + "." + std::to_string(endOffset()) + ".import";
+            int in = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+            int out = in < 0 ? -1 : ::open(copy.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+            vector<char> buffer(64 * 1024);
+            bool copied = out >= 0;
+
+            while(copied){
+                ssize_t got = ::read(in, buffer.data(), buffer.size());
+
+                if(got < 0 && errno == EINTR){
+                    continue;
+                }
+
+                if(got <= 0){
+                    copied = got == 0;
+                    break;
+                }
+
+                for(size_t done = 0; copied && done < size_t(got); ){
+                    ssize_t put = ::write(out, buffer.data() + done, size_t(got) - done);
+                    copied = put > 0 || (put < 0 && errno == EINTR);
+                    done += put > 0 ? size_t(put) : 0;
+                }
+            }
+
+            copied = copied && ::fdatasync(out) == 0;
+
+            for(int fd : {in, out}){
+                if(fd >= 0){
+                    ::close(fd);
+                }
+            }
+
+            if(!copied && out >= 0){
+                ::unlink(copy.c_str());
+            }
+
+            return copied;
+        }
+
+        uint64_t getSyncs(){
+            std::lock_guard<std::mutex> guard(lock);
+            return syncs;
+        }
+
+        static uint64_t replay(const string& path, const std::function<void(std::string_view)>& apply, uint64_t startOffset = 0){          //Feeds every complete line from startOffset on back through apply, returns the offset just past the last complete line (a torn tail from a crash is skipped)
+            std::ifstream file(path, std::ios::binary);
+
+            if(!file){
+                return 0;
+            }
+
+            file.seekg(startOffset);
+            uint64_t validEnd = startOffset;
+            string line;
+
+            while(getline(file, line)){
+                if(file.eof()){                         //No trailing newline means the write never finished
+                    break;
+                }
+
+                apply(line);
+                validEnd += line.size() + 1;
+            }
+
+            return validEnd;
+        }
+};
+
+inline thread_local uint64_t WriteAheadLog::lastAppended = 0;
+
+inline bool parseDurability(const string& text, Durability& policy){
+    if(text == "fsync"){
+        policy = Durability::PerOp;
+
+    } else if(text == "group"){
+        policy = Durability::Group;
+
+    } else if(text == "async"){
+        policy = Durability::Async;
+
+    } else {
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,580 @@
+#pragma once                                                        //The interactive menus as resumable sessions
+
+#include "bank.h"
+
+class MenuFlow{                                         //Coroutine type for the menu flows: starts suspended, and co_await on one runs it to completion before the caller carries on
+    public:
+        struct promise_type{
+            std::coroutine_handle<> continuation;       //Flow that awaited this one, resumed straight from final_suspend
+            std::exception_ptr failure;                 //What escaped the flow's body, rethrown in whoever awaited or started it
+
+            struct Finish{
+                bool await_ready() const noexcept{
+                    return false;
+                }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> flow) noexcept{
+                    std::coroutine_handle<> caller = flow.promise().continuation;
+                    return caller ? caller : std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept{}
+            };
+
+            MenuFlow get_return_object(){
+                return MenuFlow(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            std::suspend_always initial_suspend() const noexcept{
+                return {};
+            }
+
+            Finish final_suspend() const noexcept{
+                return {};
+            }
+
+            void return_void() const noexcept{}
+
+            void unhandled_exception() noexcept{         //Kept rather than thrown here, so the flow still reaches final_suspend and its caller is resumed (and later destroyed) normally
+                failure = std::current_exception();
+            }
+
+            __attribute__((noinline)) static void* operator new(size_t size){     //Counted, so --bench sessions can report what a parked session costs -- noinline keeps GCC from pairing the heap calls inside with the frame's and warning
+                void* frame = ::operator new(size);
+                frameBytes.fetch_add(int64_t(size), std::memory_order_relaxed);
+                return frame;
+            }
+
+            __attribute__((noinline)) static void operator delete(void* frame, size_t size) noexcept{
+                frameBytes.fetch_sub(int64_t(size), std::memory_order_relaxed);
+                ::operator delete(frame, size);
+            }
+        };
+
+    private:
+        std::coroutine_handle<promise_type> flow;
+
+        static std::atomic<int64_t> frameBytes;        //Bytes held by live frames, for --bench sessions
+
+        explicit MenuFlow(std::coroutine_handle<promise_type> handle) : flow(handle) {}
+
+    public:
+        MenuFlow() : flow(nullptr) {}
+
+        MenuFlow(MenuFlow&& other) noexcept : flow(std::exchange(other.flow, nullptr)) {}
+
+        MenuFlow& operator=(MenuFlow&& other) noexcept{
+            std::swap(flow, other.flow);
+            return *this;
+        }
+
+        MenuFlow(const MenuFlow&) = delete;
+        MenuFlow& operator=(const MenuFlow&) = delete;
+
+        ~MenuFlow(){                                    //Destroying a parked flow destroys the flows it is awaiting too, they live in its frame
+            if(flow){
+                flow.destroy();
+            }
+        }
+
+        void start(){                                   //Runs a top-level flow up to its first prompt
+            flow.resume();
+            rethrowFailure();
+        }
+
+        void rethrowFailure() const{                    //For top-level flows, which have no awaiting flow to rethrow in: call after each resume
+            if(flow && flow.done() && flow.promise().failure){
+                std::rethrow_exception(flow.promise().failure);
+            }
+        }
+
+        bool done() const{
+            return !flow || flow.done();
+        }
+
+        bool await_ready() const noexcept{
+            return false;
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept{
+            flow.promise().continuation = caller;
+            return flow;
+        }
+
+        void await_resume() const{
+            if(flow.promise().failure){
+                std::rethrow_exception(flow.promise().failure);
+            }
+        }
+
+        static int64_t liveFrameBytes(){
+            return frameBytes.load(std::memory_order_relaxed);
+        }
+};
+
+inline std::atomic<int64_t> MenuFlow::frameBytes(0);
+
+class MenuSession{                                      //The prompt-driven menus as coroutines: a prompt parks the session instead of blocking a thread in cin, so one thread can drive any number of them a line at a time
+    private:
+        template<typename InputType>
+        class Prompt{                                   //Awaiter behind ask(): parks the flow until feed() has a word for it, then converts it (a bad amount prints the error and fails)
+            private:
+                MenuSession& session;
+                InputType& input;
+                std::string_view errorMessage;
+
+            public:
+                Prompt(MenuSession& owner, InputType& target, std::string_view message) : session(owner), input(target), errorMessage(message) {}
+
+                bool await_ready() const noexcept{
+                    return false;
+                }
+
+                void await_suspend(std::coroutine_handle<> flow) noexcept{
+                    session.waiting = flow;
+                }
+
+                bool await_resume(){                    //False (with the message printed) when the answer didn't parse or input was terminated
+                    return session.take(input, errorMessage);
+                }
+        };
+
+        Bank& bank;
+        std::ostringstream buffer;                      //Output when the session isn't writing straight to a stream
+        std::ostream& out;
+        MenuFlow menu;
+        std::coroutine_handle<> waiting;                //Innermost flow parked on a prompt
+        std::string_view answer;                        //Word being handed to it, only valid inside feed()
+        bool terminated;                                //Input ended instead of answering
+        bool halted;                                    //Parked in halt() after a log failure
+
+        bool take(string& input, std::string_view){
+            if(terminated){
+                out << "\nInput termination detected. Press enter twice to return to previous menu.\n";
+                return false;
+            }
+
+            input.assign(answer);
+            return true;
+        }
+
+        bool take(Money& input, std::string_view errorMessage){
+            if(terminated){
+                out << "\nInput termination detected. Press enter twice to return to previous menu.\n";
+                return false;
+            }
+
+            if(!parseMoney(answer, input)){
+                out << errorMessage << "\n";
+                return false;
+            }
+
+            return true;
+        }
+
+        template<typename InputType>
+        Prompt<InputType> ask(InputType& input, std::string_view prompt, std::string_view errorMessage = "Invalid input. Please try again."){
+            out << prompt << "\n";
+            return Prompt<InputType>(*this, input, errorMessage);
+        }
+
+        void resume(){
+            std::coroutine_handle<> flow = std::exchange(waiting, nullptr);
+            flow.resume();
+            answer = std::string_view();
+            menu.rethrowFailure();
+        }
+
+        MenuFlow halt(){                                //The log lost a write: the change just made isn't durable and nothing after it can be, so the session parks here for good instead of acknowledging
+            out << "Write-ahead log write failed, the last change was not saved. Stopping.\n";
+            halted = true;
+            co_await std::suspend_always{};
+        }
+
+        MenuFlow validate(Money& input, Money min, Money max){         //Reprompts until the amount is within bounds, max reflecting the account's limit
+            while(input < min || input > max){
+                noteValidateRejection();
+                co_await ask(input, "Invalid input. Please try again (Max of $" + max.toString() + ").\n");
+            }
+        }
+
+        template<typename Account>
+        MenuFlow deposit(Account& account){             //Deposit logic -- All accounts currently function as debit accounts, too tired to change that right now
+            Money depositAmount;
+
+            if(!co_await ask(depositAmount, "How much would you like to deposit? (0 to cancel)")){
+                co_return;
+            }
+
+            co_await validate(depositAmount, Money(), Account::depositLimit());
+
+            if(depositAmount == Money()){                    //0 cancels, the account would refuse it anyway
+                co_return;
+            }
+
+            if(account.applyDeposit(depositAmount) != OpResult::Ok){
+                out << "Deposit rejected.\n";
+            }
+
+            if(!account.commitJournal()){
+                co_await halt();
+            }
+        }
+
+        template<typename Account>
+        MenuFlow withdraw(Account& account){
+            Money withdrawAmount;
+
+            if(!co_await ask(withdrawAmount, "How much would you like to withdraw? (0 to cancel)")){
+                co_return;
+            }
+
+            co_await validate(withdrawAmount, Money(), account.withdrawLimit());
+
+            if(withdrawAmount == Money()){                    //0 cancels, the account would refuse it anyway
+                co_return;
+            }
+
+            if(account.applyWithdraw(withdrawAmount) != OpResult::Ok){         //Another session can spend the balance between the limit shown and this call
+                out << "Withdrawal rejected.\n";
+            }
+
+            if(!account.commitJournal()){
+                co_await halt();
+            }
+        }
+
+        MenuFlow bankingFunctions(BankAccount& account){        //Bulk of the program stored here
+            while(true){
+                out << "\nWelcome, " << account.getUsername() << "\n";
+                out << "Checking balance: $" << account.getChecking().getBalance() << "\n";
+                out << "Savings balance: $" << account.getSavings().getBalance() << "\n";
+
+                string actionChoice;
+
+                if(!co_await ask(actionChoice, "Would you like to deposit (D), withdraw (W), view history (H), or logout (X)?\n")){
+                    continue;
+                }
+
+                if(actionChoice == "D" || actionChoice == "d"){
+                    string accountChoice;
+
+                    if(!co_await ask(accountChoice, "Which account would you like to deposit to? (C for checking, S for savings, X to cancel)")){
+                        continue;
+                    }
+
+                    if(accountChoice == "C" || accountChoice == "c"){
+                        co_await deposit(account.getChecking());
+
+                    } else if(accountChoice == "S" || accountChoice == "s"){
+                        co_await deposit(account.getSavings());
+
+                    } else if(accountChoice != "X" && accountChoice != "x"){
+                        out << "Invalid account.\n";
+                    }
+
+                } else if(actionChoice == "W" || actionChoice == "w"){              //Same as deposit entirely, just will call withdraw instead -- which logically translates to a negative deposit
+                    string accountChoice;
+
+                    if(!co_await ask(accountChoice, "Which account would you like to withdraw from? (C for checking, S for savings, X to cancel)")){
+                        continue;
+                    }
+
+                    if(accountChoice == "C" || accountChoice == "c"){
+                        co_await withdraw(account.getChecking());
+
+                    } else if(accountChoice == "S" || accountChoice == "s"){
+                        co_await withdraw(account.getSavings());
+
+                    } else if(accountChoice != "X" && accountChoice != "x"){
+                        out << "Invalid account.\n";
+                    }
+
+                } else if(actionChoice == "H" || actionChoice == "h"){              //Display history per account, see TransactionHistory class
+                    string accountChoice;
+
+                    if(!co_await ask(accountChoice, "Which account would you like to view history for? (C for checking, S for savings, X to cancel)")){
+                        continue;
+                    }
+
+                    if(accountChoice == "C" || accountChoice == "c"){
+                        account.getChecking().showHistory(out);
+
+                    } else if(accountChoice == "S" || accountChoice == "s"){
+                        account.getSavings().showHistory(out);
+
+                    } else if(accountChoice != "X" && accountChoice != "x"){
+                        out << "Invalid account.\n";
+                    }
+
+                } else if(actionChoice == "X" || actionChoice == "x"){          //End this menu function and return to login menu
+                    co_return;
+                }
+            }
+        }
+
+        MenuFlow createAccount(){                       //Looks repetitive, but this gathers the info that Bank::createAccount gets called with
+            string username, password;
+
+            while(true){                    //Gathers input for username with an exit option. For testing purposes, username/pass are only required to be 3 characters long
+                if(!co_await ask(username, "Username? (minimum 3 characters, maximum 20, X to cancel, no spaces)")){
+                    continue;
+                }
+
+                username = stripSpace(username);
+
+                if(username == "X" || username == "x"){
+                    co_return;
+                }
+
+                if(username.length() < 3 || username.length() > 20){
+                    out << "Username must be at least 3 characters or at most 20 characters long.\n";
+                    continue;
+                }
+
+                if(!validUsername(username)){               //Names are single tokens in the log, so this keeps what the menu creates replayable
+                    out << "Username can't contain spaces or control characters.\n";
+                    continue;
+                }
+
+                if(bank.accountExists(username)){
+                    out << "Username already exists.\n";
+                    continue;
+                }
+
+                break;
+            }
+
+            while(true){                    //Same as above, but for password
+                if(!co_await ask(password, "Password? (minimum 3 characters, maximum 20, X to cancel, spaces allowed)")){
+                    continue;
+                }
+
+                if(password == "X" || password == "x"){
+                    co_return;
+                }
+
+                if(password.length() < 3 || password.length() > 20){
+                    out << "Password must be at least 3 characters or at most 20 characters long.\n";
+                    continue;
+                }
+
+                break;
+            }
+
+            if(bank.createAccount(username, password) != OpResult::Ok){         //Someone else may have taken the name while the password was being typed
+                out << "Username already exists.\n";
+                co_return;
+            }
+
+            if(!bank.commitJournal()){
+                co_await halt();
+            }
+
+            out << "\nAccount " << username << " created successfully!\n";
+        }
+
+        MenuFlow updateAccount(){                       //Simple account update flow
+            string username, password, newPass;
+
+            while(true){                    //Gathers input for account details with an exit option
+                out << "\nFirst, please login; press X to exit.\n";
+
+                if(!co_await ask(username, "Username? (minimum 3 characters, maximum 20, X to cancel)")){
+                    continue;
+                }
+
+                if(username == "X" || username == "x"){
+                    co_return;
+                }
+
+                if(username.length() < 3 || username.length() > 20){
+                    out << "Username must be at least 3 characters long or at most 20 characters long.\n";
+                    continue;
+                }
+
+                if(!co_await ask(password, "Password? (minimum 3 characters, maximum 20, X to cancel)")){
+                    continue;
+                }
+
+                if(password == "X" || password == "x"){
+                    co_return;
+                }
+
+                AccountHandle current = bank.signIn(username, password);
+
+                if(current){
+                    while(true){                    //Gathers input for new password with an exit option
+                        if(!co_await ask(newPass, "New password? (minimum 3 characters, maximum 20, X to cancel)")){
+                            continue;
+                        }
+
+                        if(newPass == "X" || newPass == "x"){
+                            co_return;
+                        }
+
+                        if(newPass.length() < 3 || newPass.length() > 20){
+                            out << "Password must be at least 3 characters long or at most 20 characters long.\n";
+                            continue;
+                        }
+
+                        break;
+                    }
+
+                    current -> setPassword(newPass);
+
+                    if(!bank.commitJournal()){
+                        co_await halt();
+                    }
+
+                    out << "Password updated successfully!\n";
+                    co_return;
+                }
+
+                out << "Account info not found.\n";
+            }
+        }
+
+        MenuFlow displayAccounts(){                     //This exists purely for testing purposes, would *never* be part of a finished product -- for an end user, anyway -- alphabetical, a page at a time
+            const size_t pageSize = 20;
+            string after;
+
+            while(true){
+                string last;
+
+                size_t shown = bank.listAccounts("", after, pageSize, [this, &last, &after](std::string_view name){
+                    if(last.empty() && after.empty()){
+                        out << "\nAccounts:\n";
+                    }
+
+                    out << name << "\n";
+                    last.assign(name);
+                });
+
+                if(shown == 0 && after.empty()){
+                    out << "No accounts exist.\n";
+                    co_return;
+                }
+
+                if(shown < pageSize){
+                    co_return;
+                }
+
+                string choice;
+
+                if(!co_await ask(choice, "Next page (N) or return (X)?") || (choice != "N" && choice != "n")){
+                    co_return;
+                }
+
+                after = last;
+            }
+        }
+
+        MenuFlow login(){
+            while(true){                    //See mainMenu -- Gathers input for account details with an exit option
+                string username, password;
+                out << "\nLogin page; press X to exit.\n";
+
+                if(!co_await ask(username, "Username?")){
+                    continue;
+                }
+
+                if(username == "X" || username == "x"){
+                    co_return;
+                }
+
+                if(!co_await ask(password, "Password?")){
+                    continue;
+                }
+
+                if(password == "X" || password == "x"){
+                    co_return;
+                }
+
+                AccountHandle current = bank.signIn(username, password);            //Held in the frame, so the account stays pinned while the session is parked
+
+                if(current){
+                    co_await bankingFunctions(*current.get());
+                    co_return;
+                }
+
+                out << "Account info not found.\n";
+            }
+        }
+
+        MenuFlow mainMenu(){                            //The initial menu loop, the session ends when it returns
+            while(true){
+                out << "\nWelcome! Please create an account (C), login (L), update account (U), list existing accounts (A), or exit (X).\n";
+                string mainMenuChoice;
+
+                if(!co_await ask(mainMenuChoice, "Menu choice?")){
+                    continue;
+                }
+
+                if(mainMenuChoice == "C" || mainMenuChoice == "c"){
+                    co_await createAccount();
+
+                } else if(mainMenuChoice == "L" || mainMenuChoice == "l"){
+                    co_await login();
+
+                } else if(mainMenuChoice == "U" || mainMenuChoice == "u"){
+                    co_await updateAccount();
+
+                } else if(mainMenuChoice == "A" || mainMenuChoice == "a"){
+                    co_await displayAccounts();
+
+                } else if(mainMenuChoice == "X" || mainMenuChoice == "x"){
+                    co_return;
+
+                } else {
+                    out << "Please select a menu choice.\n";
+                }
+            }
+        }
+
+    public:
+        MenuSession(Bank& targetBank, std::ostream& output) : bank(targetBank), buffer(), out(output), menu(), waiting(nullptr), answer(), terminated(false), halted(false) {}
+
+        explicit MenuSession(Bank& targetBank) : MenuSession(targetBank, buffer) {}            //Buffers its output, collect it with takeOutput()
+
+        MenuSession(const MenuSession&) = delete;
+        MenuSession& operator=(const MenuSession&) = delete;
+
+        void start(){                                   //Prints the main menu and parks at its first prompt
+            menu = mainMenu();
+            menu.start();
+        }
+
+        void feed(std::string_view line){               //One line of input: its first word answers the waiting prompt and the rest is dropped, blank lines are skipped like cin >> skips them
+            size_t start = line.find_first_not_of(" \t\r\f\v");
+
+            if(start == std::string_view::npos || !waiting){
+                return;
+            }
+
+            answer = line.substr(start, line.find_first_of(" \t\r\f\v", start) - start);
+            resume();
+        }
+
+        void terminate(){                               //Input was ended (Ctrl-D at a terminal), the waiting prompt prints the termination notice and fails
+            if(waiting){
+                terminated = true;
+                resume();
+                terminated = false;
+            }
+        }
+
+        bool finished() const{
+            return halted || menu.done();
+        }
+
+        bool failed() const{                            //Stopped on a log failure rather than by the user
+            return halted;
+        }
+
+        string takeOutput(){
+            string text = buffer.str();
+            buffer.str("");
+            return text;
+        }
+};
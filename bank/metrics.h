@@ -0,0 +1,333 @@
+#pragma once                                                        //Per-operation counters, latency histograms and the file exporter
+
+#include "common.h"
+
+enum class MetricOp : unsigned char{Login, Create, Delete, Passwd, Deposit, Withdraw, History, Transfer, Count};
+
+const char* const metricOpNames[] = {"login", "create", "delete", "passwd", "deposit", "withdraw", "history", "transfer"};
+const char* const rejectionNames[] = {"ok", "not_found", "already_exists", "invalid_length", "out_of_bounds", "same_account"};         //Indexed by OpResult
+
+class LatencyHistogram{                                 //HDR-style log-linear buckets: 16 linear steps per power of two, so any value lands within 6.25% of its bucket's lower bound
+    public:
+        static constexpr size_t bucketCount = 976;      //Covers the whole uint64_t nanosecond range
+
+        static size_t bucketOf(uint64_t nanoseconds){
+            if(nanoseconds < 16){
+                return size_t(nanoseconds);
+            }
+
+            unsigned exponent = 63 - __builtin_clzll(nanoseconds);
+            return size_t(((exponent - 3) << 4) | ((nanoseconds >> (exponent - 4)) & 15));
+        }
+
+        static uint64_t lowerBound(size_t bucket){
+            if(bucket < 16){
+                return bucket;
+            }
+
+            unsigned exponent = unsigned(bucket >> 4) + 3;
+            return uint64_t(16 | (bucket & 15)) << (exponent - 4);
+        }
+
+    private:
+        std::atomic<uint64_t> counts[bucketCount];
+        std::atomic<uint64_t> total;
+        std::atomic<uint64_t> sumNanoseconds;
+
+    public:
+        LatencyHistogram() : counts(), total(0), sumNanoseconds(0) {}
+
+        void record(uint64_t nanoseconds){
+            counts[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+            total.fetch_add(1, std::memory_order_relaxed);
+            sumNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+        }
+
+        uint64_t count() const{
+            return total.load(std::memory_order_relaxed);
+        }
+
+        uint64_t sum() const{
+            return sumNanoseconds.load(std::memory_order_relaxed);
+        }
+
+        uint64_t countBelow(uint64_t bound) const{      //Observations in buckets that end at or before bound, exact when bound is a power of two
+            uint64_t below = 0;
+
+            for(size_t i = 0; i + 1 < bucketCount && lowerBound(i + 1) <= bound; i++){
+                below += counts[i].load(std::memory_order_relaxed);
+            }
+
+            return below;
+        }
+
+        uint64_t percentile(double fraction) const{     //Lower bound of the bucket holding that rank, 0 when empty
+            uint64_t rank = uint64_t(std::ceil(fraction * double(count())));
+            uint64_t seen = 0;
+
+            for(size_t i = 0; i < bucketCount; i++){
+                seen += counts[i].load(std::memory_order_relaxed);
+
+                if(seen >= std::max<uint64_t>(rank, 1)){
+                    return lowerBound(i);
+                }
+            }
+
+            return 0;
+        }
+};
+
+class MetricShard{                                      //One thread's exact counters -- only the owner writes, so bumps are plain adds with no locked instruction
+    public:
+        static constexpr size_t opCount = size_t(MetricOp::Count);
+
+    private:
+        static std::mutex registry;
+        static vector<MetricShard*> live;
+        static uint64_t retiredOperations[opCount];     //Totals of threads that have exited
+        static uint64_t retiredAllocations[opCount];
+
+        std::atomic<uint64_t> operations[opCount];
+        std::atomic<uint64_t> allocations[opCount];
+
+        static void bump(std::atomic<uint64_t>& counter, uint64_t amount){
+            counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+    public:
+        MetricShard() : operations(), allocations() {
+            std::lock_guard<std::mutex> guard(registry);
+            live.push_back(this);
+        }
+
+        ~MetricShard(){
+            std::lock_guard<std::mutex> guard(registry);
+            live.erase(std::find(live.begin(), live.end(), this));
+
+            for(size_t op = 0; op < opCount; op++){
+                retiredOperations[op] += operations[op].load(std::memory_order_relaxed);
+                retiredAllocations[op] += allocations[op].load(std::memory_order_relaxed);
+            }
+        }
+
+        MetricShard(const MetricShard&) = delete;
+        MetricShard& operator=(const MetricShard&) = delete;
+
+        static MetricShard& local(){
+            static thread_local MetricShard shard;
+            return shard;
+        }
+
+        void count(MetricOp op, uint64_t allocationsMade){
+            bump(operations[size_t(op)], 1);
+
+            if(allocationsMade != 0){
+                bump(allocations[size_t(op)], allocationsMade);
+            }
+        }
+
+        static void totals(MetricOp op, uint64_t& operationTotal, uint64_t& allocationTotal){      //Sum over live and exited threads
+            std::lock_guard<std::mutex> guard(registry);
+            operationTotal = retiredOperations[size_t(op)];
+            allocationTotal = retiredAllocations[size_t(op)];
+
+            for(const MetricShard* shard : live){
+                operationTotal += shard -> operations[size_t(op)].load(std::memory_order_relaxed);
+                allocationTotal += shard -> allocations[size_t(op)].load(std::memory_order_relaxed);
+            }
+        }
+};
+
+inline std::mutex MetricShard::registry;
+inline vector<MetricShard*> MetricShard::live;
+inline uint64_t MetricShard::retiredOperations[MetricShard::opCount] = {};
+inline uint64_t MetricShard::retiredAllocations[MetricShard::opCount] = {};
+
+struct Metrics{                                         //Process-wide operation metrics: exact counts, rejections and allocations, latency sampled one op in sampleEvery per thread
+    static constexpr size_t opCount = size_t(MetricOp::Count);
+    static constexpr size_t reasonCount = sizeof(rejectionNames) / sizeof(rejectionNames[0]);
+
+    static std::atomic<bool> enabled;
+    static std::atomic<uint32_t> sampleEvery;           //Two clock reads cost about as much as a deposit, so timing every op would double it
+    static LatencyHistogram latency[opCount];
+    static std::atomic<uint64_t> rejections[opCount][reasonCount];
+    static std::atomic<uint64_t> validateRejections;    //Out-of-bounds amounts reprompted by validate()
+
+    static void reject(MetricOp op, OpResult result){
+        rejections[size_t(op)][size_t(result)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void write(std::ostream& out){               //Prometheus text exposition format
+        static const double seconds = 1e-9;
+
+        uint64_t operations[opCount];
+        uint64_t allocations[opCount];
+
+        for(size_t op = 0; op < opCount; op++){
+            MetricShard::totals(MetricOp(op), operations[op], allocations[op]);
+        }
+
+        out << "# HELP bank_operations_total Operations attempted.\n# TYPE bank_operations_total counter\n";
+        for(size_t op = 0; op < opCount; op++){
+            out << "bank_operations_total{op=\"" << metricOpNames[op] << "\"} " << operations[op] << "\n";
+        }
+
+        out << "# HELP bank_rejections_total Operations refused, by reason.\n# TYPE bank_rejections_total counter\n";
+        for(size_t op = 0; op < opCount; op++){
+            for(size_t reason = 1; reason < reasonCount; reason++){
+                uint64_t rejected = rejections[op][reason].load(std::memory_order_relaxed);
+
+                if(rejected > 0){
+                    out << "bank_rejections_total{op=\"" << metricOpNames[op] << "\",reason=\"" << rejectionNames[reason] << "\"} " << rejected << "\n";
+                }
+            }
+        }
+
+        out << "# HELP bank_validate_rejections_total Amounts reprompted at the interactive prompt.\n# TYPE bank_validate_rejections_total counter\n";
+        out << "bank_validate_rejections_total " << validateRejections.load(std::memory_order_relaxed) << "\n";
+
+        if(AllocationCounter::enabled){                 //Left out rather than reported as zero when counting is compiled out
+            out << "# HELP bank_allocations_total Heap allocations made inside operations.\n# TYPE bank_allocations_total counter\n";
+            for(size_t op = 0; op < opCount; op++){
+                out << "bank_allocations_total{op=\"" << metricOpNames[op] << "\"} " << allocations[op] << "\n";
+            }
+        }
+
+        out << "# HELP bank_operation_duration_seconds Sampled operation latency.\n# TYPE bank_operation_duration_seconds histogram\n";
+        for(size_t op = 0; op < opCount; op++){
+            const LatencyHistogram& histogram = latency[op];
+
+            for(unsigned exponent = 6; exponent <= 36; exponent++){            //64ns to ~69s, powers of two line up with bucket edges so these counts are exact
+                out << "bank_operation_duration_seconds_bucket{op=\"" << metricOpNames[op] << "\",le=\"" << double(uint64_t(1) << exponent) * seconds << "\"} " << histogram.countBelow(uint64_t(1) << exponent) << "\n";
+            }
+
+            out << "bank_operation_duration_seconds_bucket{op=\"" << metricOpNames[op] << "\",le=\"+Inf\"} " << histogram.count() << "\n";
+            out << "bank_operation_duration_seconds_sum{op=\"" << metricOpNames[op] << "\"} " << double(histogram.sum()) * seconds << "\n";
+            out << "bank_operation_duration_seconds_count{op=\"" << metricOpNames[op] << "\"} " << histogram.count() << "\n";
+        }
+
+        out << "# HELP bank_operation_latency_seconds Sampled latency quantiles from the full-resolution histogram.\n# TYPE bank_operation_latency_seconds gauge\n";
+        for(size_t op = 0; op < opCount; op++){
+            for(double quantile : {0.5, 0.9, 0.99, 0.999}){
+                out << "bank_operation_latency_seconds{op=\"" << metricOpNames[op] << "\",quantile=\"" << quantile << "\"} " << double(latency[op].percentile(quantile)) * seconds << "\n";
+            }
+        }
+    }
+
+    static bool writeFile(const string& path){          //Temp file and rename, so a scraper never reads half a dump
+        string temporary = path + ".tmp";
+
+        {
+            std::ofstream file(temporary, std::ios::trunc);
+
+            if(!file){
+                return false;
+            }
+
+            write(file);
+
+            if(!file.flush()){
+                return false;
+            }
+        }
+
+        return std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+};
+
+inline std::atomic<bool> Metrics::enabled(true);
+inline std::atomic<uint32_t> Metrics::sampleEvery(64);
+inline LatencyHistogram Metrics::latency[Metrics::opCount];
+inline std::atomic<uint64_t> Metrics::rejections[Metrics::opCount][Metrics::reasonCount];
+inline std::atomic<uint64_t> Metrics::validateRejections(0);
+
+inline void noteValidateRejection(){
+    Metrics::validateRejections.fetch_add(1, std::memory_order_relaxed);
+}
+
+class OpTimer{                                          //Counts one operation on scope exit, and times every sampleEvery-th one on this thread
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        static thread_local uint32_t countdown;
+
+        MetricOp op;
+        bool active;
+        bool timed;
+        uint64_t allocationsBefore;
+        Clock::time_point start;
+
+    public:
+        explicit OpTimer(MetricOp timedOp) : op(timedOp), active(Metrics::enabled.load(std::memory_order_relaxed)), timed(false), allocationsBefore(AllocationCounter::allocations), start() {
+            if(active && countdown-- == 0){
+                countdown = Metrics::sampleEvery.load(std::memory_order_relaxed) - 1;
+                timed = true;
+                start = Clock::now();
+            }
+        }
+
+        ~OpTimer(){
+            if(!active){
+                return;
+            }
+
+            if(timed){
+                Metrics::latency[size_t(op)].record(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()));
+            }
+
+            MetricShard::local().count(op, AllocationCounter::allocations - allocationsBefore);
+        }
+
+        OpTimer(const OpTimer&) = delete;
+        OpTimer& operator=(const OpTimer&) = delete;
+
+        OpResult result(OpResult outcome){              //Pass-through that also counts a rejection
+            if(outcome != OpResult::Ok){
+                Metrics::reject(op, outcome);
+            }
+
+            return outcome;
+        }
+};
+
+inline thread_local uint32_t OpTimer::countdown = 0;
+
+class MetricsExporter{                                          //Rewrites the metrics file every interval from a background thread, and once more on shutdown
+    private:
+        string path;
+        std::chrono::seconds interval;
+        std::mutex lock;
+        std::condition_variable wake;
+        bool stopping;
+        std::thread writer;
+
+        void run(){
+            std::unique_lock<std::mutex> guard(lock);
+
+            while(!stopping){
+                if(interval.count() == 0){
+                    wake.wait(guard, [this](){ return stopping; });
+
+                } else if(!wake.wait_for(guard, interval, [this](){ return stopping; })){
+                    Metrics::writeFile(path);
+                }
+            }
+        }
+
+    public:
+        MetricsExporter(const string& filePath, unsigned seconds) : path(filePath), interval(seconds), lock(), wake(), stopping(false), writer(&MetricsExporter::run, this) {}
+
+        ~MetricsExporter(){
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+            }
+
+            wake.notify_one();
+            writer.join();
+            Metrics::writeFile(path);
+        }
+
+        MetricsExporter(const MetricsExporter&) = delete;
+        MetricsExporter& operator=(const MetricsExporter&) = delete;
+};
@@ -0,0 +1,243 @@
+#pragma once                                                        //Size-class pool for account nodes and history chunks
+
+#include "metrics.h"
+
+struct BlockSizes{                                      //Size classes for pooled blocks: 64B, 96B, 128B, 192B ... 128KB -- two per power of two, so at most a third of a block is slack
+    static constexpr size_t classCount = 23;
+
+    static constexpr size_t classBytes(size_t sizeClass){
+        return size_t(sizeClass % 2 == 0 ? 64 : 96) << (sizeClass / 2);
+    }
+
+    static constexpr size_t classFor(size_t bytes){             //Smallest class that fits, classCount if none does
+        size_t sizeClass = 0;
+
+        while(sizeClass < classCount && classBytes(sizeClass) < bytes){
+            sizeClass++;
+        }
+
+        return sizeClass;
+    }
+};
+
+class NodePool{                                         //Per-thread caches in front of one locked free list per class, fresh blocks carved from 1MB mmap spans -- classes past 16KB go to the heap, which maps big blocks and unmaps them on free
+    private:
+        static constexpr size_t pooledClasses = BlockSizes::classFor(16 * 1024) + 1;
+        static constexpr size_t spanBytes = size_t(1) << 20;        //Carved front to back as blocks are needed, so untouched blocks cost no RSS
+        static constexpr size_t cacheBlocks = 64;
+
+        struct FreeBlock{
+            FreeBlock* next;
+        };
+
+        struct Central{                                 //Shared state of one class, only touched when a thread cache runs dry or overflows
+            std::mutex lock;
+            FreeBlock* free = nullptr;
+            size_t freeBlocks = 0;
+            char* cursor = nullptr;                     //Uncarved remainder of the newest span
+            char* end = nullptr;
+        };
+
+        enum class CacheState : unsigned char{Unused, Live, Retired};
+
+        static constexpr size_t cacheLimit(size_t sizeClass){       //Small classes cache 64 blocks, larger ones fewer so an idle thread can't sit on much more than 256KB a class
+            return std::clamp<size_t>((size_t(256) << 10) / BlockSizes::classBytes(sizeClass), 2, cacheBlocks);
+        }
+
+        static void* takeCentral(size_t sizeClass){     //One block from the class's free list or the newest span, nullptr once mmap fails -- caller holds the class lock
+            Central& central = centrals[sizeClass];
+            size_t bytes = BlockSizes::classBytes(sizeClass);
+
+            if(central.free != nullptr){
+                FreeBlock* block = central.free;
+                central.free = block -> next;
+                central.freeBlocks--;
+                return block;
+            }
+
+            if(size_t(central.end - central.cursor) < bytes){
+                void* span = ::mmap(nullptr, spanBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+                if(span == MAP_FAILED){
+                    failures.fetch_add(1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+
+                mappedBytes.fetch_add(spanBytes, std::memory_order_relaxed);
+                central.cursor = static_cast<char*>(span);
+                central.end = central.cursor + spanBytes;
+            }
+
+            void* block = central.cursor;
+            central.cursor += bytes;
+            return block;
+        }
+
+        static void putCentral(void* block, size_t sizeClass){     //Caller holds the class lock
+            Central& central = centrals[sizeClass];
+            FreeBlock* freed = static_cast<FreeBlock*>(block);
+            freed -> next = central.free;
+            central.free = freed;
+            central.freeBlocks++;
+        }
+
+        class ThreadCache{                              //Blocks this thread freed or refilled, handed back to the central lists when the thread exits
+            private:
+                void* blocks[pooledClasses][cacheBlocks];
+                size_t counts[pooledClasses];
+
+                bool refill(size_t sizeClass){          //Half a cache worth in one locked batch
+                    size_t wanted = std::max<size_t>(cacheLimit(sizeClass) / 2, 1);
+                    std::lock_guard<std::mutex> guard(centrals[sizeClass].lock);
+
+                    while(counts[sizeClass] < wanted){
+                        void* block = takeCentral(sizeClass);
+
+                        if(block == nullptr){
+                            break;
+                        }
+
+                        blocks[sizeClass][counts[sizeClass]++] = block;
+                    }
+
+                    return counts[sizeClass] > 0;
+                }
+
+                void giveBack(size_t sizeClass, size_t amount){         //The oldest `amount` blocks, the recently freed (still cache-hot) ones stay
+                    if(amount == 0){
+                        return;
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> guard(centrals[sizeClass].lock);
+
+                        for(size_t i = 0; i < amount; i++){
+                            putCentral(blocks[sizeClass][i], sizeClass);
+                        }
+                    }
+
+                    counts[sizeClass] -= amount;
+                    std::copy(blocks[sizeClass] + amount, blocks[sizeClass] + amount + counts[sizeClass], blocks[sizeClass]);
+                }
+
+            public:
+                ThreadCache() : blocks(), counts() {
+                    cacheState = CacheState::Live;
+                }
+
+                ~ThreadCache(){                         //Later thread_local destructors may still free blocks, so from here on this thread goes straight to the central lists
+                    for(size_t sizeClass = 0; sizeClass < pooledClasses; sizeClass++){
+                        giveBack(sizeClass, counts[sizeClass]);
+                    }
+
+                    cacheState = CacheState::Retired;
+                }
+
+                ThreadCache(const ThreadCache&) = delete;
+                ThreadCache& operator=(const ThreadCache&) = delete;
+
+                void* pop(size_t sizeClass){
+                    if(counts[sizeClass] == 0 && !refill(sizeClass)){
+                        return nullptr;
+                    }
+
+                    return blocks[sizeClass][--counts[sizeClass]];
+                }
+
+                void push(void* block, size_t sizeClass){
+                    if(counts[sizeClass] == cacheLimit(sizeClass)){         //Full: the older half goes back in one locked batch
+                        giveBack(sizeClass, cacheLimit(sizeClass) / 2);
+                    }
+
+                    blocks[sizeClass][counts[sizeClass]++] = block;
+                }
+        };
+
+        static Central centrals[pooledClasses];
+        static std::atomic<uint64_t> failures;
+        static std::atomic<uint64_t> mappedBytes;
+        static thread_local CacheState cacheState;      //Trivially destructible, so it can still be read while the thread's other thread_locals are torn down
+
+        static ThreadCache* cache(){                    //nullptr once this thread's cache is gone
+            if(cacheState == CacheState::Retired){
+                return nullptr;
+            }
+
+            static thread_local ThreadCache local;
+            return &local;
+        }
+
+    public:
+        static std::atomic<bool> passthrough;           //Benchmarks only: send everything to the global heap instead, flip only while no pooled block is live
+        static thread_local uint64_t allocations;       //Blocks handed out on this thread, benchmarks diff it like AllocationCounter
+
+        static void* allocate(size_t sizeClass){        //nullptr when memory runs out (counted in getFailures), never throws
+            allocations++;
+
+            if(sizeClass >= pooledClasses || passthrough.load(std::memory_order_relaxed)){
+                void* block = ::operator new(BlockSizes::classBytes(sizeClass), std::nothrow);
+
+                if(block == nullptr){
+                    failures.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                return block;
+            }
+
+            ThreadCache* local = cache();
+
+            if(local != nullptr){
+                return local -> pop(sizeClass);
+            }
+
+            std::lock_guard<std::mutex> guard(centrals[sizeClass].lock);
+            return takeCentral(sizeClass);
+        }
+
+        static void release(void* block, size_t sizeClass){
+            if(block == nullptr){
+                return;
+            }
+
+            if(sizeClass >= pooledClasses || passthrough.load(std::memory_order_relaxed)){
+                ::operator delete(block);
+                return;
+            }
+
+            ThreadCache* local = cache();
+
+            if(local != nullptr){
+                local -> push(block, sizeClass);
+                return;
+            }
+
+            std::lock_guard<std::mutex> guard(centrals[sizeClass].lock);
+            putCentral(block, sizeClass);
+        }
+
+        static uint64_t getFailures(){
+            return failures.load(std::memory_order_relaxed);
+        }
+
+        static uint64_t getMappedBytes(){               //Spans only, blocks past 16KB are the heap's
+            return mappedBytes.load(std::memory_order_relaxed);
+        }
+
+        static uint64_t getIdleBytes(){                 //Freed blocks parked on the central lists, not counting what thread caches hold
+            uint64_t idle = 0;
+
+            for(size_t sizeClass = 0; sizeClass < pooledClasses; sizeClass++){
+                std::lock_guard<std::mutex> guard(centrals[sizeClass].lock);
+                idle += centrals[sizeClass].freeBlocks * BlockSizes::classBytes(sizeClass);
+            }
+
+            return idle;
+        }
+};
+
+inline NodePool::Central NodePool::centrals[NodePool::pooledClasses];
+inline std::atomic<uint64_t> NodePool::failures(0);
+inline std::atomic<uint64_t> NodePool::mappedBytes(0);
+inline thread_local NodePool::CacheState NodePool::cacheState = NodePool::CacheState::Unused;
+inline std::atomic<bool> NodePool::passthrough(false);
+inline thread_local uint64_t NodePool::allocations = 0;
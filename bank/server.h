@@ -0,0 +1,447 @@
+#pragma once                                                        //Socket server multiplexing batch or menu sessions
+
+#include "batch.h"
+
+struct ServerAddress{                                           //Where --serve listens and --load connects: a Unix socket path, or host:port over TCP
+    bool tcp = false;
+    sockaddr_un local{};
+    sockaddr_in inet{};
+
+    const sockaddr* get() const{
+        return tcp ? reinterpret_cast<const sockaddr*>(&inet) : reinterpret_cast<const sockaddr*>(&local);
+    }
+
+    socklen_t size() const{
+        return tcp ? sizeof(inet) : sizeof(local);
+    }
+};
+
+inline bool parseServerAddress(const string& text, ServerAddress& address){       //"127.0.0.1:7000" or "localhost:7000" is TCP, anything else is a socket path -- TCP is loopback only, since the protocol sends passwords in the clear
+    size_t colon = text.rfind(':');
+
+    if(colon != string::npos && text.find('/') == string::npos){
+        string host = text.substr(0, colon);
+        unsigned port = 0;
+        auto [end, error] = std::from_chars(text.data() + colon + 1, text.data() + text.size(), port);
+
+        if(error != std::errc() || end != text.data() + text.size() || port == 0 || port > 65535){
+            return false;
+        }
+
+        address.tcp = true;
+        address.inet.sin_family = AF_INET;
+        address.inet.sin_port = htons(uint16_t(port));
+        return inet_pton(AF_INET, host == "localhost" ? "127.0.0.1" : host.c_str(), &address.inet.sin_addr) == 1 && ntohl(address.inet.sin_addr.s_addr) >> 24 == 127;
+    }
+
+    if(text.empty() || text.size() >= sizeof(address.local.sun_path)){
+        return false;
+    }
+
+    address.local.sun_family = AF_UNIX;
+    std::memcpy(address.local.sun_path, text.data(), text.size());
+    return true;
+}
+
+inline void raiseDescriptorLimit(){                             //Thousands of sessions need thousands of descriptors, so take the hard limit
+    rlimit limit;
+
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max){
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+class SessionServer{                                            //--serve: one epoll loop accepts connections and waits for input, a worker pool runs each complete line through a BatchRunner and writes the replies
+    private:
+        static constexpr size_t readSize = 65536;              //Most one turn reads from a connection, so a client streaming commands can't hold a worker forever
+        static constexpr size_t maxLine = 4096;                 //A partial line longer than this is refused and the connection closed
+
+        struct Connection{                                      //Registered EPOLLONESHOT, so between a wakeup and its re-arm only one thread ever touches it
+            int fd;
+            string input;                                       //Received bytes past the last complete line
+            string output;                                      //Replies the socket hasn't taken yet
+            size_t written;                                     //How much of output is already sent
+            bool closing;                                       //Peer is done sending (or broke the protocol), close once output drains
+            std::unique_ptr<MenuSession> menu;                  //Set in --menu mode, lines go to it instead of the batch runner
+            AccountHandle login;                                //Batch mode: set by LOGIN, and what DEPOSIT, WITHDRAW, TRANSFER and the history commands must name
+            Connection* nextReady;
+            Connection* prev;
+            Connection* next;
+        };
+
+        static std::atomic<int> signalTarget;                   //Eventfd the signal handler pokes, -1 when no server is running
+
+        Bank& bank;
+        ServerAddress address;
+        bool menus;
+        int listener;
+        int poller;
+        int wakeup;
+        std::mutex lock;                                        //Guards the ready queue, the open list and the counters
+        std::condition_variable ready;
+        Connection* readyHead;                                  //Connections with events, FIFO through nextReady
+        Connection* readyTail;
+        Connection* open;                                       //Every live connection, so shutdown can close the idle ones too
+        bool stopping;
+        size_t accepted;
+        size_t commands;
+        size_t failures;
+
+        static void onSignal(int){
+            uint64_t one = 1;
+            int target = signalTarget.load();
+
+            if(target >= 0){
+                ssize_t ignored = ::write(target, &one, sizeof(one));
+                (void)ignored;
+            }
+        }
+
+        bool arm(Connection* connection, int operation){        //Backed-up output waits for EPOLLOUT alone, so a slow reader stops being read from
+            epoll_event event{};
+            event.events = EPOLLONESHOT | (connection -> written < connection -> output.size() ? EPOLLOUT : EPOLLIN);
+            event.data.ptr = connection;
+            return epoll_ctl(poller, operation, connection -> fd, &event) == 0;
+        }
+
+        void release(Connection* connection){                  //Closing the socket also drops it from the epoll set
+            ::close(connection -> fd);
+            std::lock_guard<std::mutex> guard(lock);
+
+            (connection -> prev != nullptr ? connection -> prev -> next : open) = connection -> next;
+
+            if(connection -> next != nullptr){
+                connection -> next -> prev = connection -> prev;
+            }
+
+            delete connection;
+        }
+
+        void acceptAll(){
+            while(true){
+                int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+                if(fd < 0){
+                    if(errno == EINTR || errno == ECONNABORTED){
+                        continue;
+                    }
+
+                    if(errno != EAGAIN && errno != EWOULDBLOCK){
+                        std::cerr << "accept failed: " << std::strerror(errno) << "\n";
+                    }
+
+                    return;
+                }
+
+                if(address.tcp){
+                    int on = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                }
+
+                Connection* connection = new Connection{fd, string(), string(), 0, false, nullptr, AccountHandle(), nullptr, nullptr, nullptr};
+
+                if(menus){                                      //The welcome menu goes out first, arm() waits for EPOLLOUT while it's pending
+                    connection -> menu = std::make_unique<MenuSession>(bank);
+                    connection -> menu -> start();
+                    connection -> output = connection -> menu -> takeOutput();
+                }
+
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    connection -> next = open;
+
+                    if(open != nullptr){
+                        open -> prev = connection;
+                    }
+
+                    open = connection;
+                    accepted++;
+                }
+
+                if(!arm(connection, EPOLL_CTL_ADD)){
+                    release(connection);
+                }
+            }
+        }
+
+        static bool deliver(Connection& connection){            //Writes until done or the socket is full, false on a dead peer
+            while(connection.written < connection.output.size()){
+                ssize_t sent = ::send(connection.fd, connection.output.data() + connection.written, connection.output.size() - connection.written, MSG_NOSIGNAL);
+
+                if(sent < 0){
+                    if(errno == EINTR){
+                        continue;
+                    }
+
+                    return errno == EAGAIN || errno == EWOULDBLOCK;
+                }
+
+                connection.written += size_t(sent);
+            }
+
+            connection.output.clear();
+            connection.written = 0;
+            return true;
+        }
+
+        bool serve(Connection& connection, BatchRunner& runner, std::ostringstream& replies){      //One turn for a connection that woke up: send what's owed, read, run complete lines, reply -- false once it should be closed
+            if(!deliver(connection)){
+                return false;
+            }
+
+            if(connection.written < connection.output.size()){
+                return true;
+            }
+
+            if(!connection.closing){
+                char buffer[readSize];
+                ssize_t received = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+
+                if(received > 0){
+                    connection.input.append(buffer, size_t(received));
+
+                } else if(received == 0){
+                    connection.closing = true;
+
+                } else if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                    return false;
+                }
+            }
+
+            std::string_view input = connection.input;
+            size_t start = 0;
+            runner.bindSession(&connection.login);
+
+            auto run = [&connection, &runner](std::string_view line){
+                if(connection.menu != nullptr){
+                    connection.menu -> feed(line);
+
+                } else {
+                    runner.execute(line);
+                }
+            };
+
+            for(size_t end = input.find('\n'); end != std::string_view::npos; end = input.find('\n', start)){
+                run(input.substr(start, end - start));
+                start = end + 1;
+            }
+
+            if(connection.closing && start < input.size() && input.size() - start <= maxLine){     //Last line without a newline, as --batch would run it
+                run(input.substr(start));
+                start = input.size();
+            }
+
+            connection.input.erase(0, start);
+            runner.bindSession(nullptr);
+            bool saved = runner.flush();                        //Commits the log before any of these replies can go out
+            connection.output += replies.view();
+            replies.str("");
+
+            if(connection.menu != nullptr){                     //The menus commit their own changes before printing the outcome
+                connection.output += connection.menu -> takeOutput();
+                connection.closing = connection.closing || connection.menu -> finished();
+                saved = saved && !connection.menu -> failed();
+            }
+
+            if(!saved){                                         //Nothing more can be acknowledged, so shut the whole server down rather than keep serving
+                connection.closing = true;
+                onSignal(0);
+            }
+
+            if(connection.input.size() > maxLine){
+                connection.output += "ERR Line too long\n";
+                connection.input.clear();
+                connection.closing = true;
+            }
+
+            if(!deliver(connection)){
+                return false;
+            }
+
+            return !connection.closing || connection.written < connection.output.size();
+        }
+
+        void work(){
+            std::ostringstream replies;
+            BatchRunner runner(bank, replies, false);
+
+            while(true){
+                Connection* connection;
+
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    ready.wait(guard, [this](){ return stopping || readyHead != nullptr; });
+
+                    if(stopping){
+                        break;
+                    }
+
+                    connection = readyHead;
+                    readyHead = connection -> nextReady;
+
+                    if(readyHead == nullptr){
+                        readyTail = nullptr;
+                    }
+                }
+
+                if(!serve(*connection, runner, replies) || !arm(connection, EPOLL_CTL_MOD)){
+                    release(connection);
+                }
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            commands += runner.getCommands();
+            failures += runner.getFailures();
+        }
+
+        void enqueue(Connection* connection){
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                connection -> nextReady = nullptr;
+                (readyTail != nullptr ? readyTail -> nextReady : readyHead) = connection;
+                readyTail = connection;
+            }
+
+            ready.notify_one();
+        }
+
+        bool claimPath(){                                       //Removes a stale socket left by a crashed server, but never a live one or anything that isn't a socket
+            struct stat info;
+
+            if(::stat(address.local.sun_path, &info) != 0){
+                return true;
+            }
+
+            if(!S_ISSOCK(info.st_mode)){
+                std::cerr << address.local.sun_path << " exists and is not a socket\n";
+                return false;
+            }
+
+            int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            bool live = probe >= 0 && connect(probe, address.get(), address.size()) == 0;
+
+            if(probe >= 0){
+                ::close(probe);
+            }
+
+            if(live){
+                std::cerr << "Another server is listening on " << address.local.sun_path << "\n";
+                return false;
+            }
+
+            return ::unlink(address.local.sun_path) == 0;
+        }
+
+    public:
+        SessionServer(Bank& targetBank, const ServerAddress& where, bool menuSessions) : bank(targetBank), address(where), menus(menuSessions), listener(-1), poller(-1), wakeup(-1), lock(), ready(),
+            readyHead(nullptr), readyTail(nullptr), open(nullptr), stopping(false), accepted(0), commands(0), failures(0) {
+            if(!address.tcp && !claimPath()){
+                return;
+            }
+
+            listener = socket(address.tcp ? AF_INET : AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            int on = 1;
+
+            if(listener >= 0 && address.tcp){
+                setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            }
+
+            if(listener < 0 || bind(listener, address.get(), address.size()) != 0 || listen(listener, SOMAXCONN) != 0){
+                std::cerr << "Could not listen: " << std::strerror(errno) << "\n";
+                return;
+            }
+
+            poller = epoll_create1(EPOLL_CLOEXEC);
+            wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.ptr = &listener;
+
+            if(poller < 0 || wakeup < 0 || epoll_ctl(poller, EPOLL_CTL_ADD, listener, &event) != 0){
+                std::cerr << "Could not set up epoll: " << std::strerror(errno) << "\n";
+                return;
+            }
+
+            event.data.ptr = &wakeup;
+            epoll_ctl(poller, EPOLL_CTL_ADD, wakeup, &event);
+        }
+
+        ~SessionServer(){
+            for(int fd : {listener, poller, wakeup}){
+                if(fd >= 0){
+                    ::close(fd);
+                }
+            }
+
+            if(listener >= 0 && !address.tcp){
+                ::unlink(address.local.sun_path);
+            }
+        }
+
+        SessionServer(const SessionServer&) = delete;
+        SessionServer& operator=(const SessionServer&) = delete;
+
+        bool isOpen() const{
+            return poller >= 0 && wakeup >= 0;
+        }
+
+        void run(size_t workerCount){                           //Serves until SIGINT or SIGTERM, then finishes the turns in progress and closes every connection
+            signalTarget = wakeup;
+            struct sigaction action{};
+            action.sa_handler = &SessionServer::onSignal;
+            sigaction(SIGINT, &action, nullptr);
+            sigaction(SIGTERM, &action, nullptr);
+            signal(SIGPIPE, SIG_IGN);
+
+            vector<std::thread> workers;
+
+            for(size_t i = 0; i < workerCount; i++){
+                workers.emplace_back(&SessionServer::work, this);
+            }
+
+            epoll_event events[256];
+            bool running = true;
+
+            while(running){
+                int woken = epoll_wait(poller, events, 256, -1);
+
+                if(woken < 0 && errno != EINTR){
+                    std::cerr << "epoll_wait failed: " << std::strerror(errno) << "\n";
+                    break;
+                }
+
+                for(int i = 0; i < woken; i++){
+                    if(events[i].data.ptr == &listener){
+                        acceptAll();
+
+                    } else if(events[i].data.ptr == &wakeup){
+                        running = false;
+
+                    } else {
+                        enqueue(static_cast<Connection*>(events[i].data.ptr));
+                    }
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+            }
+
+            ready.notify_all();
+
+            for(std::thread& worker : workers){
+                worker.join();
+            }
+
+            while(open != nullptr){
+                release(open);
+            }
+
+            signalTarget = -1;
+            std::cerr << accepted << " sessions, " << commands << " commands, " << failures << " failed\n";
+        }
+};
+
+inline std::atomic<int> SessionServer::signalTarget(-1);
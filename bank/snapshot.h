@@ -0,0 +1,191 @@
+#pragma once                                                        //Writing and mapping snapshot files
+
+#include "accounts.h"
+
+class Snapshot{                                         //Read-only mmap of a snapshot file -- lookups binary search the mapped account table, nothing is copied until an account is claimed
+    private:
+        void* base;
+        size_t length;
+        const SnapshotHeader* header;
+        const SnapshotAccount* table;
+        const SnapshotBalance* balances;
+        const SnapshotRecord* records;
+        vector<uint64_t> claimed;                           //One bit per table entry, set once the account has been materialized (or deleted after that)
+        size_t unclaimed;
+
+        Snapshot() : base(nullptr), length(0), header(nullptr), table(nullptr), balances(nullptr), records(nullptr), unclaimed(0) {}
+
+        static std::string_view field(const char* text){    //NUL padded fixed field -> view
+            return std::string_view(text, strnlen(text, 24));
+        }
+
+    public:
+        ~Snapshot(){
+            if(base != nullptr){
+                ::munmap(base, length);
+            }
+        }
+
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        static std::unique_ptr<Snapshot> open(const string& path){          //Maps and sanity checks the file, nullptr (with a message) if it isn't a usable snapshot
+            int fd = ::open(path.c_str(), O_RDONLY);
+
+            if(fd < 0){
+                std::cerr << "Could not open snapshot " << path << "\n";
+                return nullptr;
+            }
+
+            struct stat info;
+            std::unique_ptr<Snapshot> snapshot(new Snapshot());
+
+            if(::fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(SnapshotHeader)){
+                ::close(fd);
+                std::cerr << "Snapshot " << path << " is truncated.\n";
+                return nullptr;
+            }
+
+            snapshot -> length = info.st_size;
+            void* mapped = ::mmap(nullptr, snapshot -> length, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+
+            if(mapped == MAP_FAILED){
+                std::cerr << "Could not map snapshot " << path << "\n";
+                return nullptr;
+            }
+
+            snapshot -> base = mapped;
+            const char* bytes = static_cast<const char*>(mapped);
+            snapshot -> header = reinterpret_cast<const SnapshotHeader*>(bytes);
+            uint64_t accounts = snapshot -> header -> accountCount;
+            uint64_t recordCount = snapshot -> header -> recordCount;
+
+            if(memcmp(snapshot -> header -> magic, "BANKSNP1", 8) == 0){
+                std::cerr << "Snapshot " << path << " was written by an older version without record times, rebuild it by replaying the write-ahead log.\n";
+                return nullptr;
+            }
+
+            if(memcmp(snapshot -> header -> magic, "BANKSNP2", 8) == 0){
+                std::cerr << "Snapshot " << path << " was written by an older version that kept plain passwords, rebuild it by replaying the write-ahead log.\n";
+                return nullptr;
+            }
+
+            const size_t accountBytes = sizeof(SnapshotAccount) + 2 * sizeof(SnapshotBalance);
+            size_t body = snapshot -> length - sizeof(SnapshotHeader);          //Counts are checked by dividing the file size, a corrupt header can't overflow its way past the check
+
+            if(memcmp(snapshot -> header -> magic, "BANKSNP3", 8) != 0 || accounts > body / accountBytes ||
+               recordCount != (body - accounts * accountBytes) / sizeof(SnapshotRecord) || (body - accounts * accountBytes) % sizeof(SnapshotRecord) != 0){
+                std::cerr << "Snapshot " << path << " is corrupt.\n";
+                return nullptr;
+            }
+
+            snapshot -> table = reinterpret_cast<const SnapshotAccount*>(bytes + sizeof(SnapshotHeader));
+            snapshot -> balances = reinterpret_cast<const SnapshotBalance*>(snapshot -> table + accounts);
+            snapshot -> records = reinterpret_cast<const SnapshotRecord*>(snapshot -> balances + 2 * accounts);
+
+            for(uint64_t i = 0; i < 2 * accounts; i++){         //Every history range has to lie inside the record section, one pass over the balances only
+                const SnapshotBalance& saved = snapshot -> balances[i];
+
+                if(saved.firstRecord > recordCount || saved.recordCount > recordCount - saved.firstRecord){
+                    std::cerr << "Snapshot " << path << " is corrupt.\n";
+                    return nullptr;
+                }
+            }
+
+            for(uint64_t i = 1; i < accounts; i++){             //find() and lowerBound() binary search the table, so it has to be strictly ascending
+                if(!(snapshot -> username(i - 1) < snapshot -> username(i))){
+                    std::cerr << "Snapshot " << path << " is corrupt.\n";
+                    return nullptr;
+                }
+            }
+
+            for(uint64_t i = 0; i < recordCount; i++){          //Types are handed straight to typeName() and the column kernels, so nothing past the last TransactionType gets in
+                if(snapshot -> records[i].type > uint8_t(TransactionType::TransferIn)){
+                    std::cerr << "Snapshot " << path << " is corrupt.\n";
+                    return nullptr;
+                }
+            }
+
+            snapshot -> claimed.assign((accounts + 63) / 64, 0);
+            snapshot -> unclaimed = accounts;
+
+            ::madvise(mapped, snapshot -> length, MADV_RANDOM);          //Logins touch scattered pages, don't read ahead the whole file
+            return snapshot;
+        }
+
+        size_t size() const{
+            return header -> accountCount;
+        }
+
+        uint64_t getJournalOffset() const{
+            return header -> journalOffset;
+        }
+
+        std::string_view username(size_t i) const{
+            return field(table[i].username);
+        }
+
+        const PasswordHash& credential(size_t i) const{
+            return table[i].credential;
+        }
+
+        const SnapshotBalance& balance(size_t i, size_t sub) const{        //sub 0 = checking, 1 = savings
+            return balances[2 * i + sub];
+        }
+
+        const SnapshotRecord* getRecords() const{
+            return records;
+        }
+
+        bool isClaimed(size_t i) const{
+            return (claimed[i / 64] >> (i % 64)) & 1;
+        }
+
+        void claim(size_t i){
+            claimed[i / 64] |= uint64_t(1) << (i % 64);
+            unclaimed--;
+        }
+
+        size_t getUnclaimed() const{
+            return unclaimed;
+        }
+
+        size_t lowerBound(std::string_view name) const{     //First table index whose username is >= name, the table is sorted
+            size_t low = 0, high = header -> accountCount;
+
+            while(low < high){
+                size_t middle = low + (high - low) / 2;
+
+                if(username(middle) < name){
+                    low = middle + 1;
+
+                } else {
+                    high = middle;
+                }
+            }
+
+            return low;
+        }
+
+        long find(std::string_view name) const{             //Table index of an unclaimed account, -1 if it isn't here (or already lives in AccountList)
+            size_t low = 0, high = header -> accountCount;
+
+            while(low < high){
+                size_t middle = low + (high - low) / 2;
+                std::string_view candidate = username(middle);
+
+                if(candidate < name){
+                    low = middle + 1;
+
+                } else if(name < candidate){
+                    high = middle;
+
+                } else {
+                    return isClaimed(middle) ? -1 : long(middle);
+                }
+            }
+
+            return -1;
+        }
+};
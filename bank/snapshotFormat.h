@@ -0,0 +1,29 @@
+#pragma once                                                        //On-disk layout of snapshot files
+
+#include "hashing.h"
+
+struct SnapshotHeader{                      //Snapshot file layout: header, account table (sorted by username), two balances per account, then every history record
+    char magic[8];                          //"BANKSNP3", version 1 files had no record timestamps and version 2 kept plain passwords, both are rejected
+    uint64_t accountCount;
+    uint64_t recordCount;
+    uint64_t journalOffset;                 //Bytes of the write-ahead log already folded into this snapshot
+};
+
+struct SnapshotAccount{                     //NUL padded name (at most 20 characters), then the password hash as the account holds it
+    char username[24];
+    PasswordHash credential;
+};
+
+struct SnapshotBalance{                     //Checking is entry 2i, savings 2i + 1
+    int64_t balanceCents;
+    uint64_t firstRecord;
+    uint64_t recordCount;
+};
+
+struct SnapshotRecord{
+    int64_t oldCents;
+    int64_t changeCents;
+    int64_t timestampMicros;
+    uint8_t type;
+    uint8_t padding[7];
+};
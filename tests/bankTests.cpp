@@ -0,0 +1,876 @@
+#include "../bank/server.h"
+#include <filesystem>
+#include <set>
+
+int failedChecks = 0;
+
+void check(bool condition, const string& what){                //Counts and reports a failed expectation, the test keeps going so one run shows every failure
+    if(!condition){
+        std::cerr << "FAILED: " << what << "\n";
+        failedChecks++;
+    }
+}
+
+string run(Bank& bank, const string& script){                   //Batch replies to script, one per command line
+    std::ostringstream replies;
+
+    {
+        BatchRunner runner(bank, replies);
+        std::istringstream input(script);
+        runner.run(input);
+    }
+
+    return replies.str();
+}
+
+const string workload =                                         //Every kind of change the log records, with fixed timestamps so histories compare exactly
+    "CREATE alice alicepw\n"
+    "CREATE bobby bobbypw\n"
+    "CREATE carol carolpw\n"
+    "DEPOSIT alice C 250.75 at=1700000000000001\n"
+    "DEPOSIT alice S 40 at=1700000000000002\n"
+    "WITHDRAW alice C 50.25 at=1700000000000003\n"
+    "DEPOSIT bobby C 1000 at=1700000000000004\n"
+    "WITHDRAW bobby S 5000 at=1700000000000005\n"
+    "TRANSFER bobby C alice S 125.5 at=1700000000000006\n"
+    "TRANSFER alice C carol C 20 at=1700000000000007\n"
+    "PASSWD carol carolpw carolnew\n"
+    "CREATE dave davepw\n"
+    "DELETE dave davepw\n";
+
+const string queries =                                          //Read-only view of everything workload leaves behind
+    "LIST\n"
+    "LOGIN alice alicepw\n"
+    "LOGIN carol carolnew\n"
+    "LOGIN carol carolpw\n"
+    "LOGIN dave davepw\n"
+    "HISTORY alice C\n"
+    "HISTORY alice S\n"
+    "HISTORY bobby C\n"
+    "HISTORY bobby S\n"
+    "HISTORY carol C json\n"
+    "SUMMARY alice C\n"
+    "SUMMARY bobby C\n"
+    "ASOF alice C 1700000000000004\n"
+    "BETWEEN alice C 1700000000000002 1700000000000007\n";
+
+bool testIndex(const string&){                                  //The open-addressing index agrees with a std::set through growth, tombstones and reinsertion
+    AccountList list;
+    std::set<string> model;
+    PasswordHash credential = PasswordHasher::hash("pass");
+
+    for(size_t i = 0; i < 3000; i++){                           //Grows the table from 16 slots several times over
+        string name = "user" + std::to_string(i);
+        list.addAccount(name, credential);
+        model.insert(name);
+    }
+
+    for(size_t i = 0; i < 3000; i += 3){                        //Leaves tombstones all through the probe chains
+        string name = "user" + std::to_string(i);
+        check(list.deleteAccount(name) == OpResult::Ok, "delete " + name);
+        model.erase(name);
+    }
+
+    check(list.deleteAccount("user0") == OpResult::NotFound, "second delete refused");
+
+    for(size_t i = 0; i < 3000; i += 6){                        //Reuses some of those tombstones
+        string name = "user" + std::to_string(i);
+        list.addAccount(name, credential);
+        model.insert(name);
+    }
+
+    for(size_t i = 0; i < 3100; i++){
+        string name = "user" + std::to_string(i);
+        BankAccount* found = list.findAccount(name);
+        check((found != nullptr) == (model.count(name) == 1), "lookup " + name);
+        check(found == nullptr || found -> getUsername() == name, "lookup " + name + " finds its own account");
+    }
+
+    size_t linked = 0;
+
+    for(BankAccount* account = list.getHead(); account != nullptr; account = account -> getNext()){
+        linked++;
+    }
+
+    check(size_t(list.size()) == model.size() && linked == model.size(), "list and index sizes agree");
+    return failedChecks == 0;
+}
+
+bool testHistory(const string&){                                //Records come back in order and intact across many chunk sizes, and clear() leaves an empty history
+    TransactionHistory history;
+    Money balance;
+    int64_t lastStamp = 0;
+
+    for(int64_t i = 0; i < 20000; i++){                         //Runs through every chunk size class up to the largest
+        Money change = Money::fromCents(i % 7 == 0 ? -(i % 500) : i % 900 + 1);
+        TransactionType type = change < Money() ? TransactionType::Withdrawal : TransactionType::Deposit;
+        lastStamp = history.addRecord(type, balance, change, 1000 + i / 3);
+        balance += change;
+    }
+
+    check(history.size() == 20000, "record count");
+    check(lastStamp == 1000 + 19999 / 3, "explicit timestamps kept");
+
+    int64_t i = 0;
+    Money expected;
+    bool ordered = true;
+
+    history.forEach([&](const Transaction& record){
+        Money change = Money::fromCents(i % 7 == 0 ? -(i % 500) : i % 900 + 1);
+        ordered = ordered && record.getOldBalance() == expected && record.getBalanceChange() == change && record.getNewBalance() == expected + change && record.getTimestamp() == 1000 + i / 3;
+        expected += change;
+        i++;
+    });
+
+    check(ordered && i == 20000 && expected == balance, "records read back in order");
+    check(history.addRecord(TransactionType::Deposit, balance, Money::dollars(1), 5) == lastStamp, "a stamp behind the last record is moved up to it");
+
+    history.clear();
+    size_t left = 0;
+    history.forEach([&left](const Transaction&){ left++; });
+    check(history.size() == 0 && left == 0, "clear empties the history");
+    return failedChecks == 0;
+}
+
+bool testMoney(const string&){                                  //Parsing and printing of amounts, exact to the cent and strict about malformed input
+    struct Case{
+        const char* text;
+        bool valid;
+        int64_t cents;
+    };
+
+    const Case cases[] = {
+        {"100", true, 10000}, {"100.5", true, 10050}, {"100.25", true, 10025}, {"0.01", true, 1}, {".5", true, 50}, {"7.", true, 700},
+        {"-20", true, -2000}, {"+3.10", true, 310}, {"0.1", true, 10}, {"1.234", false, 0}, {"", false, 0}, {"-", false, 0},
+        {".", false, 0}, {"12a", false, 0}, {"1e3", false, 0}, {"1,000", false, 0}, {"99999999999999999999", false, 0},
+    };
+
+    for(const Case& test : cases){
+        Money amount;
+        bool parsed = parseMoney(test.text, amount);
+        check(parsed == test.valid && (!parsed || amount.getCents() == test.cents), string("parse \"") + test.text + "\"");
+    }
+
+    check(Money::fromCents(-5).toString() == "-0.05" && Money::fromCents(-2000).toString() == "-20.00" && Money::fromCents(1234567).toString() == "12345.67", "two decimal places");
+    check(Money::fromCents(10) + Money::fromCents(20) == Money::fromCents(30), "no rounding error where a double would drift");
+
+    bool threw = false;
+
+    try{
+        Money::fromCents(std::numeric_limits<int64_t>::max()) + Money::fromCents(1);
+    } catch(const std::overflow_error&){
+        threw = true;
+    }
+
+    check(threw, "overflow throws instead of wrapping");
+
+    std::istringstream input("12.5 abc");
+    Money first, second;
+    input >> first;
+    check(input && first.getCents() == 1250, "stream form reads an amount");
+    input >> second;
+    check(input.fail(), "stream form fails on junk");
+    return failedChecks == 0;
+}
+
+bool testReplay(const string& directory){                       //A log replayed into an empty bank rebuilds what was acknowledged, and a torn last line is cut
+    string log = directory + "/bank.wal";
+    string expected;
+
+    {
+        Bank bank;
+        check(openJournal(bank, log, Durability::PerOp), "open a new log");
+        string replies = run(bank, workload);
+        check(replies.find("ERR Write-ahead log") == string::npos, "workload acknowledged");
+
+        Bank source;                                            //IMPORT is logged as a copy beside the log, replay has to read it back
+        run(source, "CREATE erin erinpw\nDEPOSIT erin C 77 at=1700000000000008\n");
+        ExportStats exported, imported;
+        check(source.exportAccounts(directory + "/erin.exp", "", exported), "export for import");
+        check(bank.importAccounts(directory + "/erin.exp", imported) && imported.accounts == 1, "import into the logged bank");
+        check(bank.commitJournal(), "commit the import");
+        std::filesystem::remove(directory + "/erin.exp");
+
+        expected = run(bank, queries + "HISTORY erin C\n");
+    }
+
+    {
+        Bank bank;
+        check(openJournal(bank, log, Durability::PerOp), "replay the log");
+        check(run(bank, queries + "HISTORY erin C\n") == expected, "replayed state matches");
+    }
+
+    uint64_t intact = std::filesystem::file_size(log);
+
+    {
+        std::ofstream torn(log, std::ios::app);                 //A crash halfway through appending a record
+        torn << "DEPOSIT alice C 99";
+    }
+
+    {
+        Bank bank;
+        check(openJournal(bank, log, Durability::PerOp), "replay a torn log");
+        check(run(bank, queries + "HISTORY erin C\n") == expected, "torn record ignored");
+        check(std::filesystem::file_size(log) == intact, "torn tail truncated");
+    }
+
+    return failedChecks == 0;
+}
+
+bool testSnapshot(const string& directory){                     //A snapshot loaded into an empty bank answers like the bank that wrote it, before and after accounts are touched
+    string path = directory + "/bank.snap";
+    string expected;
+
+    {
+        Bank bank;
+        run(bank, workload);
+        expected = run(bank, queries);
+        check(bank.writeSnapshot(path), "write the snapshot");
+    }
+
+    {
+        Bank bank;
+        check(bank.loadSnapshot(path), "load the snapshot");
+        check(bank.accountExists("bobby") && !bank.accountExists("dave"), "names from the mapped table");
+        check(run(bank, queries) == expected, "loaded state matches");
+
+        string again = directory + "/again.snap";               //Now partly materialized, the rewrite merges live accounts with the table
+        run(bank, "DEPOSIT bobby C 1 at=1700000000000009\nWITHDRAW bobby C 1 at=1700000000000010\n");
+        check(bank.writeSnapshot(again), "rewrite the snapshot");
+        expected = run(bank, queries);
+
+        Bank reloaded;
+        check(reloaded.loadSnapshot(again), "load the rewritten snapshot");
+        check(run(reloaded, queries) == expected, "rewritten state matches");
+    }
+
+    check(!std::filesystem::exists(path + ".tmp"), "temporary file renamed away");
+
+    auto corrupt = [&path, &directory](size_t offset, const void* bytes, size_t size){      //A damaged copy of the snapshot, which open has to refuse
+        string damaged = directory + "/damaged.snap";
+        std::filesystem::copy_file(path, damaged, std::filesystem::copy_options::overwrite_existing);
+        std::fstream file(damaged, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(offset);
+        file.write(static_cast<const char*>(bytes), size);
+        file.close();
+
+        Bank bank;
+        return !bank.loadSnapshot(damaged);
+    };
+
+    SnapshotAccount first, second;                              //Three accounts: alice, bobby, carol
+    std::ifstream original(path, std::ios::binary);
+    original.seekg(sizeof(SnapshotHeader));
+    original.read(reinterpret_cast<char*>(&first), sizeof(first));
+    original.read(reinterpret_cast<char*>(&second), sizeof(second));
+    original.close();
+
+    check(corrupt(sizeof(SnapshotHeader), &second, sizeof(second)), "duplicate name in the table rejected");
+    SnapshotAccount swapped[2] = {second, first};
+    check(corrupt(sizeof(SnapshotHeader), swapped, sizeof(swapped)), "out of order table rejected");
+
+    uint8_t badType = uint8_t(TransactionType::TransferIn) + 1;
+    size_t firstRecord = sizeof(SnapshotHeader) + 3 * (sizeof(SnapshotAccount) + 2 * sizeof(SnapshotBalance));
+    check(corrupt(firstRecord + offsetof(SnapshotRecord, type), &badType, 1), "unknown record type rejected");
+    return failedChecks == 0;
+}
+
+bool testPool(const string&){                                   //Pooled blocks never overlap, a thread hands its cache back when it exits, freed nodes are reused and big blocks stay on the heap
+    std::set<char*> seen;
+    vector<std::pair<void*, size_t>> blocks;
+
+    for(size_t i = 0; i < 4000; i++){
+        size_t sizeClass = i % 12;
+        char* block = static_cast<char*>(NodePool::allocate(sizeClass));
+        check(block != nullptr && reinterpret_cast<uintptr_t>(block) % 16 == 0, "allocation aligned");
+        std::fill(block, block + BlockSizes::classBytes(sizeClass), char(i));
+        blocks.emplace_back(block, sizeClass);
+        seen.insert(block);
+    }
+
+    check(seen.size() == blocks.size(), "live blocks are distinct");
+    bool intact = true;
+
+    for(size_t i = 0; i < blocks.size(); i++){
+        const char* block = static_cast<const char*>(blocks[i].first);
+        intact = intact && std::all_of(block, block + BlockSizes::classBytes(blocks[i].second), [&](char c){ return c == char(i); });
+    }
+
+    check(intact, "no block overwrote another");
+
+    for(const auto& [block, sizeClass] : blocks){
+        NodePool::release(block, sizeClass);
+    }
+
+    uint64_t idleBefore = NodePool::getIdleBytes();
+    std::thread worker([](){                                    //A class nothing else used, the last 42 it frees sit in its cache until it exits
+        vector<void*> own;
+
+        for(size_t i = 0; i < 500; i++){
+            own.push_back(NodePool::allocate(13));
+        }
+
+        for(void* block : own){
+            NodePool::release(block, 13);
+        }
+    });
+    worker.join();
+    check(NodePool::getIdleBytes() >= idleBefore + 500 * BlockSizes::classBytes(13), "exiting thread returns its cache");
+
+    uint64_t mapped = NodePool::getMappedBytes();
+    void* big = NodePool::allocate(BlockSizes::classCount - 1);
+    check(big != nullptr && NodePool::getMappedBytes() == mapped, "blocks past 16KB come from the heap");
+    NodePool::release(big, BlockSizes::classCount - 1);
+
+    PasswordHash credential = PasswordHasher::hash("pass");
+    AccountList list;
+    auto fill = [&](){
+        for(size_t i = 0; i < 5000; i++){
+            BankAccount* account = list.restoreAccount("user" + std::to_string(i), credential);
+
+            for(size_t r = 0; r < i % 40; r++){
+                account -> deposit('C', Money::fromCents(100));
+            }
+        }
+    };
+
+    fill();
+    mapped = NodePool::getMappedBytes();
+
+    for(int round = 0; round < 3; round++){
+        for(size_t i = 0; i < 5000; i++){
+            list.deleteAccount("user" + std::to_string(i));
+        }
+
+        fill();
+    }
+
+    check(NodePool::getMappedBytes() == mapped, "deleted accounts' nodes and chunks are reused");
+    check(NodePool::getFailures() == 0, "no allocation failed");
+    return failedChecks == 0;
+}
+
+bool testOrdered(const string&){                                //Listings through the B+ tree match a sorted vector as it splits, borrows and merges, whole and a page at a time
+    AccountList list;
+    std::set<string> model;
+    PasswordHash credential = PasswordHasher::hash("pass");
+    std::mt19937_64 engine(11);
+
+    auto compare = [&](const string& phase){
+        vector<string> sorted(model.begin(), model.end());
+        vector<string> listed;
+        list.listAccounts("", "", SIZE_MAX, [&](std::string_view name){ listed.emplace_back(name); });
+        check(listed == sorted, phase + ": full listing in order");
+
+        vector<string> paged;
+        string after;
+
+        while(true){                                            //Page size 7 lands cursors on every position in a 32-key leaf
+            size_t page = list.listAccounts("", after, 7, [&](std::string_view name){ paged.emplace_back(name); });
+
+            if(page == 0){
+                break;
+            }
+
+            after = paged.back();
+        }
+
+        check(paged == sorted, phase + ": paginated listing in order");
+
+        for(const char* prefix : {"a", "b1", "c22", "zz"}){
+            vector<string> expected, found;
+
+            for(const string& name : sorted){
+                if(name.rfind(prefix, 0) == 0 && expected.size() < 20){
+                    expected.push_back(name);
+                }
+            }
+
+            list.listAccounts(prefix, "", 20, [&](std::string_view name){ found.emplace_back(name); });
+            check(found == expected, phase + ": first 20 starting with " + prefix);
+        }
+    };
+
+    vector<string> names;
+
+    for(size_t i = 0; i < 6000; i++){                           //Shared short prefixes, inserted in random order
+        names.push_back(string(1, char('a' + engine() % 3)) + std::to_string(engine() % 100000));
+    }
+
+    std::shuffle(names.begin(), names.end(), engine);
+
+    for(const string& name : names){
+        if(model.insert(name).second){
+            list.addAccount(name, credential);
+        }
+    }
+
+    compare("after inserts");
+    vector<string> present(model.begin(), model.end());
+    std::shuffle(present.begin(), present.end(), engine);
+
+    for(size_t i = 0; i < present.size() * 9 / 10; i++){        //Leaves and branches drop under half full all over the tree
+        check(list.deleteAccount(present[i]) == OpResult::Ok, "delete " + present[i]);
+        model.erase(present[i]);
+
+        if(i % 1000 == 0){
+            compare("mid deletes");
+        }
+    }
+
+    compare("after deletes");
+
+    for(size_t i = 0; i < present.size() / 2; i++){             //Regrow through the same keys
+        list.addAccount(present[i], credential);
+        model.insert(present[i]);
+    }
+
+    compare("after reinserts");
+
+    for(const string& name : vector<string>(model.begin(), model.end())){
+        list.deleteAccount(name);
+        model.erase(name);
+    }
+
+    compare("emptied");
+    check(list.size() == 0, "nothing left");
+    return failedChecks == 0;
+}
+
+bool testNameFilter(const string& directory){                   //Lookups through the counting filter never miss a live name: across deletes and recreation, growth, and the background rebuild after loadSnapshot
+    string path = directory + "/names.snap";
+    auto name = [](size_t i){ return "user" + std::to_string(i); };
+    const size_t count = 60000;                                 //Enough that the rebuild after the load is still running when the first deletes arrive
+
+    {
+        Bank bank;
+
+        for(size_t i = 0; i < count; i++){                      //Well past the initial 1024-name capacity, so the filter is rebuilt bigger on the way
+            check(bank.createAccount(name(i), "secret") == OpResult::Ok, "create " + name(i));
+        }
+
+        for(size_t i = 0; i < count; i += 3){
+            check(bank.deleteAccount(name(i), "secret") == OpResult::Ok, "delete " + name(i));
+        }
+
+        for(size_t i = 0; i < count; i += 6){                    //Deleted then recreated, its counters have been down and back up
+            check(bank.createAccount(name(i), "secret") == OpResult::Ok, "recreate " + name(i));
+        }
+
+        bool found = true, gone = true;
+
+        for(size_t i = 0; i < count; i++){
+            bool live = i % 3 != 0 || i % 6 == 0;
+            found = found && (!live || (bank.accountExists(name(i)) && bank.acquire(name(i))));
+            gone = gone && (live || (!bank.accountExists(name(i)) && !bank.acquire(name(i))));
+        }
+
+        check(found, "every live name found");
+        check(gone, "every deleted name gone");
+        check(bank.writeSnapshot(path), "write the snapshot");
+    }
+
+    Bank bank;
+    check(bank.loadSnapshot(path), "load the snapshot");
+
+    for(size_t i = 1; i < count; i += 3){                        //Racing the rebuild, the first of these land in its pending list and the rest in the finished filter
+        if(i / 3 < 1000){
+            check(bank.createAccount(name(count + i / 3), "secret") == OpResult::Ok, "create " + name(count + i / 3) + " after the load");
+        }
+
+        check(bank.deleteAccount(name(i), "secret") == OpResult::Ok, "delete " + name(i) + " from the snapshot");
+
+        if(i % 6 == 1){
+            check(bank.createAccount(name(i), "secret") == OpResult::Ok, "recreate " + name(i) + " over the snapshot");
+        }
+    }
+
+    bank.waitForNameFilter();
+    bool found = true, gone = true;
+
+    for(size_t i = 0; i < count + 1000; i++){
+        bool live = i >= count || ((i % 3 != 0 || i % 6 == 0) && (i % 3 != 1 || i % 6 == 1));
+        found = found && (!live || (bank.accountExists(name(i)) && bank.acquire(name(i))));
+        gone = gone && (live || (!bank.accountExists(name(i)) && !bank.acquire(name(i))));
+    }
+
+    check(found, "no false negatives after the rebuild");
+    check(gone, "deleted names stay gone after the rebuild");
+    check(bank.signIn(name(1), "secret") && bank.signIn(name(count + 999), "secret"), "recreated and new accounts sign in");
+    return failedChecks == 0;
+}
+
+bool testAsOf(const string&){                                   //Balance-as-of and time-range queries agree with a linear scan right at chunk checkpoints, before the first record and after the last
+    struct Stamped{
+        int64_t time;
+        int64_t balance;
+    };
+
+    auto verify = [](const TransactionHistory& history, const vector<Stamped>& model, const string& what){
+        vector<int64_t> probes = {std::numeric_limits<int64_t>::min(), 0, 1};
+        int64_t previousLast = -1;
+        bool straddles = false;
+
+        history.forEachChunk([&](const TransactionChunk& chunk){        //Every checkpoint exactly, and either side of it
+            int64_t first = chunk.timestamps()[0];
+            probes.insert(probes.end(), {first - 1, first, first + 1});
+            straddles = straddles || first == previousLast;
+            previousLast = chunk.timestamps()[chunk.size() - 1];
+        });
+
+        if(!model.empty()){
+            probes.insert(probes.end(), {model.back().time, model.back().time + 1, std::numeric_limits<int64_t>::max()});
+        }
+
+        bool asOf = true, between = true;
+
+        for(int64_t probe : probes){
+            int64_t expected = 0;
+
+            for(const Stamped& record : model){
+                if(record.time <= probe){
+                    expected = record.balance;
+                }
+            }
+
+            asOf = asOf && history.balanceAsOf(probe).getCents() == expected;
+        }
+
+        for(int64_t from : probes){
+            for(int64_t to : probes){
+                vector<int64_t> expected, found;
+
+                for(const Stamped& record : model){
+                    if(record.time >= from && record.time <= to){
+                        expected.push_back(record.balance);
+                    }
+                }
+
+                size_t visited = history.forEachBetween(from, to, [&found](const Transaction& record){ found.push_back(record.getNewBalance().getCents()); });
+                between = between && found == expected && visited == expected.size();
+            }
+        }
+
+        check(asOf, what + ": balanceAsOf at every edge");
+        check(between, what + ": forEachBetween over every pair of edges");
+        return straddles;
+    };
+
+    TransactionHistory history;
+    vector<Stamped> model;
+    check(!verify(history, model, "empty"), "empty history has no chunks");
+
+    Money balance;
+
+    for(int64_t i = 0; i < 5; i++){                             //One chunk, so no checkpoints yet
+        history.addRecord(TransactionType::Deposit, balance, Money::fromCents(100), 500 + 10 * i);
+        balance += Money::fromCents(100);
+        model.push_back({500 + 10 * i, balance.getCents()});
+    }
+
+    verify(history, model, "single chunk");
+
+    for(int64_t i = 0; i < 5000; i++){                          //Runs of three equal stamps, some of which straddle a chunk boundary
+        Money change = Money::fromCents(i % 5 == 0 ? -30 : 17 + i % 11);
+        int64_t time = 1000 + 10 * (i / 3);
+        history.addRecord(change < Money() ? TransactionType::Withdrawal : TransactionType::Deposit, balance, change, time);
+        balance += change;
+        model.push_back({time, balance.getCents()});
+    }
+
+    check(verify(history, model, "many chunks"), "some chunk starts in the middle of a run of equal stamps");
+    return failedChecks == 0;
+}
+
+bool testExport(const string& directory){                       //Export then import into an empty bank carries credentials and full histories across, and a balance its records don't add up to is refused
+    string path = directory + "/bank.exp";
+    string expected;
+    ExportStats exported, imported;
+
+    {
+        Bank bank;
+        run(bank, workload);
+        expected = run(bank, queries);
+        check(bank.exportAccounts(path, "", exported), "export every account");
+        check(exported.accounts == 3, "three live accounts exported");
+    }
+
+    {
+        Bank bank;
+        check(bank.importAccounts(path, imported), "import every account");
+        check(imported.accounts == exported.accounts && imported.records == exported.records && imported.skipped == 0, "import counts match the export");
+        check(run(bank, queries) == expected, "imported state matches");
+
+        ExportStats twice;
+        check(bank.importAccounts(path, twice) && twice.accounts == 0 && twice.skipped == exported.accounts, "taken names skipped");
+    }
+
+    std::filesystem::resize_file(path, exported.bytes / 2);     //Cut off mid-record: what was read before stays, the rest is refused
+
+    {
+        Bank bank;
+        ExportStats partial;
+        check(!bank.importAccounts(path, partial), "truncated export rejected");
+        check(partial.accounts < exported.accounts, "truncated export stops early");
+    }
+
+    auto forge = [&directory](const string& name, int64_t statedCents, int64_t recordCount){      //One account whose checking balance is stated as statedCents, with recordCount deposits of $1 behind it
+        string forged = directory + "/" + name + ".exp";
+        ExportWriter writer(forged);
+        writer.beginAccount(name, PasswordHasher::hash("pass"));
+        writer.beginSubAccount(Money::fromCents(statedCents), recordCount);
+
+        for(int64_t i = 0; i < recordCount; i++){
+            writer.putRecord(TransactionType::Deposit, 100 * i, 100, 1700000000000000 + i);
+        }
+
+        writer.beginSubAccount(Money(), 0);
+        writer.finish();
+        return forged;
+    };
+
+    Bank bank;
+    ExportStats stats;
+    check(bank.importAccounts(forge("honest", 300, 3), stats) && bank.accountExists("honest"), "balance matching its records imported");
+    check(bank.acquire("honest") -> getSubAccount('C') -> getBalance() == Money::dollars(3), "imported balance kept");
+    check(!bank.importAccounts(forge("inflated", 1000000, 3), stats) && !bank.accountExists("inflated"), "balance past its last record refused");
+    check(!bank.importAccounts(forge("conjured", 500, 0), stats) && !bank.accountExists("conjured"), "balance with no records refused");
+    return failedChecks == 0;
+}
+
+bool testMenus(const string&){                                  //A scripted MenuSession: account creation, a failed login, rejected and accepted deposits and withdrawals, then exit
+    Bank bank;
+    MenuSession session(bank);
+    session.start();
+
+    const char* script[] = {
+        "C", "alice", "secret",
+        "L", "alice", "wrong",
+        "alice", "secret",
+        "D", "C", "abc",                                        //Not an amount: error, back to the account menu
+        "D", "C", "6000", "125.50",                             //Past the $5000 limit: reprompted, then taken
+        "W", "C", "200", "20",                                  //Past balance plus the $20 overdraft: reprompted, then taken
+        "H", "C",
+        "X", "X",
+    };
+
+    for(const char* line : script){
+        check(!session.finished(), string("still running before \"") + line + "\"");
+        session.feed(line);
+    }
+
+    string output = session.takeOutput();
+    check(session.finished() && !session.failed(), "exit ends the session");
+
+    size_t position = 0;
+
+    for(const char* expected : {"Account alice created successfully!", "Account info not found.", "Invalid input. Please try again.",
+                                "Invalid input. Please try again (Max of $5000.00).", "Invalid input. Please try again (Max of $145.50)."}){
+        size_t found = output.find(expected, position);
+        check(found != string::npos, string("output has \"") + expected + "\" in order");
+        position = found == string::npos ? position : found;
+    }
+
+    check(output.find("Deposit rejected.") == string::npos && output.find("Withdrawal rejected.") == string::npos, "validated amounts all went through");
+
+    AccountHandle account = bank.acquire("alice");
+    check(account && account -> getSubAccount('C') -> getBalance() == Money::fromCents(10550), "checking holds 125.50 - 20");
+    check(account && account -> getSubAccount('C') -> historySize() == 2, "two records, the rejected amounts left none");
+    check(account && account -> getSubAccount('S') -> getBalance() == Money::dollars(10), "savings untouched");
+    return failedChecks == 0;
+}
+
+bool testTransfers(const string&){                              //Concurrent transfers, single and settled in batches, never create or lose money, never pass a policy floor and keep every history chained; zero and negative amounts are refused everywhere
+    constexpr size_t accountCount = 6;
+    constexpr size_t threads = 4;
+    constexpr size_t transfers = 2000;
+    constexpr int64_t checkingFloor = CheckingPolicy::minimumBalance.getCents() - CheckingPolicy::overdraft.getCents();
+    constexpr int64_t savingsFloor = SavingsPolicy::minimumBalance.getCents() - SavingsPolicy::overdraft.getCents();
+
+    for(bool batched : {false, true}){
+        Bank bank;
+        vector<string> names;
+
+        for(size_t i = 0; i < accountCount; i++){
+            names.push_back("user" + std::to_string(i));
+            check(bank.createAccount(names.back(), "pass") == OpResult::Ok, "create " + names.back());
+            bank.acquire(names.back()) -> deposit('C', Money::dollars(1000));
+        }
+
+        std::atomic<size_t> accepted(0);
+        vector<std::thread> workers;
+
+        for(size_t t = 0; t < threads; t++){
+            workers.emplace_back([&bank, &names, &accepted, batched, t](){
+                uint64_t seed = 0x9E3779B97F4A7C15ULL * (t + 1);
+                vector<TransferOrder> orders;
+                size_t mine = 0;
+
+                for(size_t i = 0; i < transfers; i++){
+                    seed ^= seed << 13;
+                    seed ^= seed >> 7;
+                    seed ^= seed << 17;
+
+                    TransferOrder order{names[seed % names.size()], (seed >> 20) & 1 ? 'S' : 'C', names[(seed >> 24) % names.size()], (seed >> 21) & 1 ? 'S' : 'C', Money::fromCents(int64_t(100 + (seed >> 32) % 50000)), OpResult::Ok};
+
+                    if(!batched){
+                        mine += bank.transfer(order.fromUser, order.fromChoice, order.toUser, order.toChoice, order.amount) == OpResult::Ok;
+                        continue;
+                    }
+
+                    orders.push_back(order);
+
+                    if(orders.size() == 100 || i + 1 == transfers){
+                        mine += bank.settleTransfers(orders);
+                        orders.clear();
+                    }
+                }
+
+                accepted += mine;
+            });
+        }
+
+        for(std::thread& worker : workers){
+            worker.join();
+        }
+
+        int64_t total = 0;
+        size_t records = 0;
+        size_t incoming = 0, outgoing = 0;
+
+        for(const string& name : names){
+            AccountHandle account = bank.acquire(name);
+
+            for(char code : {'C', 'S'}){
+                SubAccount* sub = account -> getSubAccount(code);
+                auto [balance, count] = sub -> readState();
+                int64_t floorCents = code == 'C' ? checkingFloor : savingsFloor;
+                Money expected;
+                bool chained = true, floored = true;
+
+                sub -> readHistory([&](const Transaction& record){
+                    chained = chained && record.getOldBalance() == expected;
+                    expected = record.getNewBalance();
+                    floored = floored && (record.getType() != TransactionType::TransferOut || expected.getCents() >= floorCents);
+                    incoming += record.getType() == TransactionType::TransferIn;
+                    outgoing += record.getType() == TransactionType::TransferOut;
+                });
+
+                check(chained && expected == balance, name + " " + code + " history chains to its balance");
+                check(floored && balance.getCents() >= floorCents, name + " " + code + " never taken below its policy floor");
+                total += balance.getCents();
+                records += count;
+            }
+        }
+
+        string mode = batched ? "batched" : "single";
+        check(accepted.load() > 0, mode + " transfers went through");
+        check(total == int64_t(accountCount) * Money::dollars(1010).getCents(), mode + " money conserved");
+        check(incoming == accepted.load() && outgoing == accepted.load(), mode + " one record on each side per transfer");
+        check(records == 2 * accountCount + 2 * accepted.load(), mode + " no stray records");
+    }
+
+    Bank bank;
+    check(bank.createAccount("alice", "pass") == OpResult::Ok && bank.createAccount("bob", "pass") == OpResult::Ok, "create alice and bob");
+    AccountHandle alice = bank.acquire("alice");
+    AccountHandle bob = bank.acquire("bob");
+    check(alice -> deposit('C', Money::dollars(100)) == OpResult::Ok, "ordinary deposit");
+
+    for(Money amount : {Money(), Money::fromCents(-1)}){
+        string label = amount.toString();
+        check(alice -> getChecking().applyDeposit(amount) == OpResult::OutOfBounds, "deposit of " + label + " refused");
+        check(alice -> getSavings().applyWithdraw(amount) == OpResult::OutOfBounds, "withdrawal of " + label + " refused");
+        check(bank.transfer("alice", 'C', "alice", 'S', amount) == OpResult::OutOfBounds, "own transfer of " + label + " refused");
+        check(bank.transfer("alice", 'C', "bob", 'C', amount) == OpResult::OutOfBounds, "transfer of " + label + " to bob refused");
+
+        vector<TransferOrder> orders{TransferOrder{"alice", 'C', "bob", 'S', amount, OpResult::Ok}};
+        check(bank.settleTransfers(orders) == 0 && orders[0].result == OpResult::OutOfBounds, "settled transfer of " + label + " refused");
+    }
+
+    check(alice -> getChecking().getBalance() == Money::dollars(100) && alice -> getChecking().historySize() == 1, "refusals left alice's checking alone");
+    check(alice -> getSavings().getBalance() == Money::dollars(10) && alice -> getSavings().historySize() == 1, "refusals left alice's savings alone");
+    check(bob -> getChecking().historySize() == 0 && bob -> getSavings().historySize() == 1, "refusals left bob alone");
+    return failedChecks == 0;
+}
+
+bool testHashes(const string&){                                 //Published vectors through the OpenSSL calls, stored hashes survive the log encoding and still verify, and damaged encodings are refused
+    std::ostringstream report;
+    check(checkHashVectors(report, true), "known answer vectors\n" + report.str());
+    HashSettings previous = PasswordHasher::current();
+
+    for(const char* settings : {"pbkdf2:1000", "scrypt:10:8:1", "scrypt:4:1:2"}){
+        HashSettings parsed;
+        check(parseHashSettings(settings, parsed), string("parse ") + settings);
+        PasswordHasher::configure(parsed);
+
+        PasswordHash stored = PasswordHasher::hash("correct horse");
+        PasswordHash decoded;
+        check(decodeHash(encodeHash(stored), decoded), string("decode ") + settings);
+        check(PasswordHasher::verify(decoded, "correct horse"), string("verify ") + settings);
+        check(PasswordHasher::verify(decoded, "correct horse"), string("verify again through the cache ") + settings);
+        check(!PasswordHasher::verify(decoded, "correct horsf"), string("reject ") + settings);
+        check(memcmp(PasswordHasher::hash("correct horse").salt, stored.salt, sizeof(stored.salt)) != 0, string("fresh salt each time ") + settings);
+    }
+
+    PasswordHasher::configure(previous);
+    PasswordHash unused;
+    check(!decodeHash("pbkdf2$0$00$00", unused) && !decodeHash("scrypt$99$8$1$00$00", unused), "damaged encodings rejected");
+    return failedChecks == 0;
+}
+
+struct TestCase{
+    const char* name;
+    bool (*run)(const string& directory);                       //directory is a fresh scratch directory, removed afterwards
+};
+
+const TestCase testCases[] = {
+    {"index", testIndex},
+    {"history", testHistory},
+    {"money", testMoney},
+    {"replay", testReplay},
+    {"snapshot", testSnapshot},
+    {"pool", testPool},
+    {"ordered", testOrdered},
+    {"names", testNameFilter},
+    {"asof", testAsOf},
+    {"export", testExport},
+    {"menus", testMenus},
+    {"transfers", testTransfers},
+    {"hashes", testHashes},
+};
+
+int main(int argc, char* argv[]){                               //bankTests <name>, one ctest entry per test case
+    if(argc != 2){
+        std::cerr << "Usage: bankTests <test name>\n";
+        return 2;
+    }
+
+    HashSettings cheap;                                         //Hashing speed is beside the point everywhere but the hash test
+    parseHashSettings("pbkdf2:1", cheap);
+    PasswordHasher::configure(cheap);
+
+    const TestCase* selected = nullptr;
+
+    for(const TestCase& test : testCases){
+        if(string(argv[1]) == test.name){
+            selected = &test;
+        }
+    }
+
+    if(selected == nullptr){
+        std::cerr << "Unknown test " << argv[1] << "\n";
+        return 2;
+    }
+
+    char pattern[] = "/tmp/bankTests.XXXXXX";
+
+    if(::mkdtemp(pattern) == nullptr){
+        std::cerr << "Could not create a scratch directory\n";
+        return 2;
+    }
+
+    bool passed = selected -> run(pattern);
+    std::filesystem::remove_all(pattern);
+    cout << selected -> name << (passed ? " passed" : " FAILED") << "\n";
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,2021 @@
+#include "../bank/server.h"
+#include "tools.h"
+
+#ifdef BANK_COUNT_ALLOCATIONS
+__attribute__((noinline)) void* operator new(size_t size){        //noinline keeps GCC from pairing the malloc/free inside with new/delete at call sites and warning
+    AllocationCounter::allocations++;
+    AllocationCounter::bytes += size;
+
+    if(void* memory = std::malloc(size == 0 ? 1 : size)){
+        return memory;
+    }
+
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void* operator new[](size_t size){
+    return ::operator new(size);
+}
+
+__attribute__((noinline)) void operator delete(void* memory) noexcept{
+    std::free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void* memory) noexcept{
+    std::free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void* memory, size_t) noexcept{
+    std::free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void* memory, size_t) noexcept{
+    std::free(memory);
+}
+#endif
+
+const PasswordHash& benchCredential(){                          //"pass" hashed once, for benchmarks that build accounts straight into an AccountList or a snapshot file
+    static const PasswordHash credential = PasswordHasher::hash("pass");
+    return credential;
+}
+
+void benchLookup(const vector<size_t>& sizes){                  //Username lookup latency through the hash index vs the old list walk, run with --bench lookup [account counts...]
+    using Clock = std::chrono::steady_clock;
+
+    cout << "accounts,index_hit_ns,index_miss_ns,list_walk_ns\n";
+
+    for(size_t count : sizes){
+        AccountList list;
+
+        for(size_t i = 0; i < count; i++){
+            list.addAccount("user" + std::to_string(i), benchCredential());
+        }
+
+        const size_t lookups = 1000000;
+        vector<string> hits, misses;
+
+        for(size_t i = 0; i < 4096; i++){                   //Precomputed names keep string building out of the timed loops
+            hits.push_back("user" + std::to_string((i * 2654435761ULL) % count));
+            misses.push_back("nobody" + std::to_string(i));
+        }
+
+        size_t found = 0;
+        auto start = Clock::now();
+        for(size_t i = 0; i < lookups; i++){
+            found += list.findAccount(hits[i & 4095]) != nullptr;
+        }
+        double hitNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / lookups;
+
+        start = Clock::now();
+        for(size_t i = 0; i < lookups; i++){
+            found += list.findAccount(misses[i & 4095]) != nullptr;
+        }
+        double missNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / lookups;
+
+        size_t walks = std::max<size_t>(1, 20000000 / count);        //Old O(n) walk, sampled so the large sizes still finish
+        start = Clock::now();
+        for(size_t i = 0; i < walks; i++){
+            const string& target = hits[i & 4095];
+
+            for(BankAccount* current = list.getHead(); current != nullptr; current = current -> getNext()){
+                if(current -> getUsername() == target){
+                    found++;
+                    break;
+                }
+            }
+        }
+        double walkNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / walks;
+
+        if(found == 0){                                     //Keeps the loops from being optimized away
+            cout << "(no matches)\n";
+        }
+
+        cout << count << "," << hitNs << "," << missNs << "," << walkNs << "\n";
+    }
+}
+
+void benchMoney(const vector<size_t>& sizes){                   //Aggregate sum over a history as int64 cents vs the old double dollars, run with --bench money [record counts...]
+    using Clock = std::chrono::steady_clock;
+
+    cout << "records,money_ns_per_record,double_ns_per_record,money_total,double_total,double_drift_cents\n";
+
+    for(size_t count : sizes){
+        TransactionHistory history;
+        vector<double> legacy;                              //Same amounts in the pre-Money representation
+        legacy.reserve(count);
+
+        uint64_t seed = 88172645463325252ULL;
+        Money balance;
+
+        for(size_t i = 0; i < count; i++){
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+
+            Money amount = Money::fromCents(int64_t(seed % 500000) + 1);           //$0.01 to $5000.00, like validate allows
+            history.addRecord(TransactionType::Deposit, balance, amount);
+            balance += amount;
+            legacy.push_back(amount.getCents() / 100.0);
+        }
+
+        auto start = Clock::now();
+        int64_t cents = 0;
+        history.forEach([&cents](const Transaction& record){
+            cents += record.getBalanceChange().getCents();
+        });
+        double moneyNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+
+        start = Clock::now();
+        double dollars = 0;
+        for(double amount : legacy){
+            dollars += amount;
+        }
+        double doubleNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+
+        Money exact = Money::fromCents(cents);
+        double drift = dollars * 100.0 - double(cents);
+
+        cout << count << "," << moneyNs << "," << doubleNs << "," << exact << "," << std::fixed << dollars << "," << drift << std::defaultfloat << "\n";
+    }
+}
+
+void benchJournal(size_t operations, const vector<size_t>& threadCounts){       //Sustained acknowledged deposits/sec per durability policy, run with --bench wal [ops per thread] [thread counts...]
+    using Clock = std::chrono::steady_clock;
+
+    const string path = "/tmp/bankingSystem-wal-bench.log";
+    const std::pair<const char*, Durability> policies[] = {{"fsync", Durability::PerOp}, {"group", Durability::Group}, {"async", Durability::Async}};
+
+    cout << "policy,threads,operations,seconds,ops_per_sec,syncs\n";
+
+    for(const auto& [policyName, policy] : policies){
+        for(size_t threads : threadCounts){
+            ::unlink(path.c_str());
+            uint64_t syncs = 0;
+            double seconds = 0;
+
+            {
+                Bank bank;
+                bank.attachJournal(std::make_unique<WriteAheadLog>(path, policy));
+
+                for(size_t t = 0; t < threads; t++){        //One account per thread, so the threads share the log and nothing else
+                    bank.createAccount("bench" + std::to_string(t), "pass");
+                }
+
+                bank.commitJournal();
+                auto start = Clock::now();
+                vector<std::thread> workers;
+
+                for(size_t t = 0; t < threads; t++){
+                    BankAccount* account = bank.acquire("bench" + std::to_string(t)).get();          //Never deleted during the run, so the pin isn't needed past this point
+
+                    workers.emplace_back([&bank, account, operations](){
+                        for(size_t i = 0; i < operations; i++){
+                            account -> deposit('C', Money::fromCents(1));
+                            bank.commitJournal();           //Every deposit is acknowledged individually
+                        }
+                    });
+                }
+
+                for(std::thread& worker : workers){
+                    worker.join();
+                }
+
+                seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                syncs = bank.getJournal() -> getSyncs();
+            }
+
+            size_t total = operations * threads;
+            cout << policyName << "," << threads << "," << total << "," << seconds << "," << total / seconds << "," << syncs << "\n";
+        }
+    }
+
+    ::unlink(path.c_str());
+}
+
+bool writeSyntheticSnapshot(const string& path, size_t count){         //Streams a snapshot of `count` accounts straight to disk (names user00000000...), so the benchmark isn't limited by building the bank in memory
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    if(!file){
+        return false;
+    }
+
+    SnapshotHeader header{};
+    memcpy(header.magic, "BANKSNP3", 8);
+    header.accountCount = count;
+    header.recordCount = count * 2;                         //Savings opening deposit plus one checking deposit each
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    char name[32];
+
+    for(size_t i = 0; i < count; i++){
+        SnapshotAccount row{};
+        snprintf(name, sizeof(name), "user%08zu", i);
+        memcpy(row.username, name, strlen(name));
+        row.credential = benchCredential();
+        file.write(reinterpret_cast<const char*>(&row), sizeof(row));
+    }
+
+    for(size_t i = 0; i < count; i++){
+        SnapshotBalance balances[2] = {{10000, 2 * i, 1}, {1000, 2 * i + 1, 1}};
+        file.write(reinterpret_cast<const char*>(balances), sizeof(balances));
+    }
+
+    for(size_t i = 0; i < count; i++){
+        SnapshotRecord records[2] = {{0, 10000, int64_t(i), uint8_t(TransactionType::Deposit), {}}, {0, 1000, int64_t(i), uint8_t(TransactionType::Deposit), {}}};
+        file.write(reinterpret_cast<const char*>(records), sizeof(records));
+    }
+
+    return bool(file);
+}
+
+void benchSnapshot(const vector<size_t>& sizes){                //Startup (map) time, first-login materialization and existence checks served from the mapping, run with --bench snapshot [account counts...]
+    using Clock = std::chrono::steady_clock;
+
+    const string path = "/tmp/bankingSystem-snapshot-bench.snap";
+    cout << "accounts,file_mb,startup_us,first_login_us,exists_ns\n";
+
+    for(size_t count : sizes){
+        if(!writeSyntheticSnapshot(path, count)){
+            cout << "Could not write " << path << "\n";
+            return;
+        }
+
+        struct stat info;
+        ::stat(path.c_str(), &info);
+
+        auto start = Clock::now();
+        Bank bank;
+        bool loaded = bank.loadSnapshot(path);
+        double startupUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+        if(!loaded){
+            return;
+        }
+
+        char name[32];
+        const size_t logins = 1000;
+        start = Clock::now();
+
+        for(size_t i = 0; i < logins; i++){                 //Cold logins, each one materializes an account
+            snprintf(name, sizeof(name), "user%08zu", size_t((i * 2654435761ULL) % count));
+            bank.acquire(name);
+        }
+
+        double loginUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / logins;
+
+        const size_t checks = 200000;
+        size_t found = 0;
+        start = Clock::now();
+
+        for(size_t i = 0; i < checks; i++){
+            snprintf(name, sizeof(name), "user%08zu", size_t((i * 40503ULL) % count));
+            found += bank.accountExists(name);
+        }
+
+        double existsNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / checks;
+
+        if(found != checks){
+            cout << "(missing accounts)\n";
+        }
+
+        cout << count << "," << info.st_size / 1048576.0 << "," << startupUs << "," << loginUs << "," << existsNs << "\n";
+    }
+
+    ::unlink(path.c_str());
+}
+
+class VirtualSubAccount{                                //Benchmark stand-in for the old design: limits chosen through a virtual call
+    protected:
+        TransactionHistory History;
+        Money balance;
+
+        void post(TransactionType type, Money change, Money newBalance){
+            History.addRecord(type, balance, change);
+            balance = newBalance;
+        }
+
+    public:
+        virtual ~VirtualSubAccount() = default;
+        virtual Money withdrawLimit() const = 0;
+
+        virtual OpResult applyWithdraw(Money withdrawAmount){
+            if(withdrawAmount < Money() || withdrawAmount > withdrawLimit()){
+                return OpResult::OutOfBounds;
+            }
+
+            post(TransactionType::Withdrawal, -withdrawAmount, balance - withdrawAmount);
+            return OpResult::Ok;
+        }
+
+        OpResult applyDeposit(Money depositAmount){
+            if(depositAmount < Money() || depositAmount > Money::dollars(5000)){
+                return OpResult::OutOfBounds;
+            }
+
+            post(TransactionType::Deposit, depositAmount, balance + depositAmount);
+            return OpResult::Ok;
+        }
+};
+
+class VirtualChecking : public VirtualSubAccount{
+    public:
+        Money withdrawLimit() const{
+            return balance + Money::dollars(20);
+        }
+};
+
+class VirtualSavings : public VirtualSubAccount{
+    public:
+        Money withdrawLimit() const{
+            return balance - Money::dollars(10);
+        }
+};
+
+void benchPolicy(size_t operations){                            //Policy templates vs virtual dispatch on the deposit/withdraw path, run with --bench policy [ops]
+    using Clock = std::chrono::steady_clock;
+
+    VirtualChecking virtualChecking;
+    VirtualSavings virtualSavings;
+    VirtualSubAccount* virtualAccounts[2] = {&virtualChecking, &virtualSavings};
+    CheckingAccount checking;
+    SavingsAccount savings;
+
+    for(VirtualSubAccount* account : virtualAccounts){
+        account -> applyDeposit(Money::dollars(5000));
+    }
+
+    checking.applyDeposit(Money::dollars(5000));
+    savings.applyDeposit(Money::dollars(5000));
+
+    Metrics::enabled = false;                                   //The virtual copies aren't instrumented, keep the comparison about dispatch only
+    int64_t sink = 0;
+    auto start = Clock::now();
+    for(size_t i = 0; i < operations; i++){                     //Limit check only, alternating account types
+        sink += virtualAccounts[i & 1] -> withdrawLimit().getCents();
+    }
+    double virtualLimitNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / operations;
+
+    start = Clock::now();
+    for(size_t i = 0; i < operations; i++){
+        sink += (i & 1 ? savings.withdrawLimit() : checking.withdrawLimit()).getCents();
+    }
+    double policyLimitNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / operations;
+
+    start = Clock::now();
+    for(size_t i = 0; i < operations; i++){                     //Full withdraw (rejected every 7th op) + deposit back, history included
+        VirtualSubAccount* account = virtualAccounts[i & 1];
+        Money amount = Money::fromCents(i % 7 == 0 ? 99999999 : 150);
+        sink += account -> applyWithdraw(amount) == OpResult::Ok;
+        account -> applyDeposit(Money::fromCents(150));
+    }
+    double virtualOpNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (2 * operations);
+
+    start = Clock::now();
+    for(size_t i = 0; i < operations; i++){
+        Money amount = Money::fromCents(i % 7 == 0 ? 99999999 : 150);
+
+        if(i & 1){
+            sink += savings.applyWithdraw(amount) == OpResult::Ok;
+            savings.applyDeposit(Money::fromCents(150));
+
+        } else {
+            sink += checking.applyWithdraw(amount) == OpResult::Ok;
+            checking.applyDeposit(Money::fromCents(150));
+        }
+    }
+    double policyOpNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (2 * operations);
+
+    cout << "path,virtual_ns,policy_ns\n";
+    cout << "withdraw_limit," << virtualLimitNs << "," << policyLimitNs << "\n";
+    cout << "deposit_withdraw," << virtualOpNs << "," << policyOpNs << "\n";
+
+    if(sink == 0){
+        cout << "(no work)\n";
+    }
+
+    Metrics::enabled = true;
+}
+
+void benchMetrics(size_t operations){                           //Hot-path cost of the instrumentation, deposit/withdraw pairs with metrics off, sampled and timing every op, run with --bench metrics [ops]
+    using Clock = std::chrono::steady_clock;
+
+    struct Setting{
+        const char* name;
+        bool enabled;
+        uint32_t sampleEvery;
+        double bestNs;
+    };
+
+    Setting settings[] = {{"off", false, 1, 1e300}, {"sampled_1_in_64", true, 64, 1e300}, {"every_op", true, 1, 1e300}};
+    int64_t sink = 0;
+
+    for(int round = 0; round < 5; round++){                     //Interleaved rounds, best of each, so drift hits every setting alike
+        for(Setting& setting : settings){
+            Metrics::enabled = setting.enabled;
+            Metrics::sampleEvery = setting.sampleEvery;
+
+            CheckingAccount account;
+            account.applyDeposit(Money::dollars(5000));
+            auto start = Clock::now();
+
+            for(size_t i = 0; i < operations; i++){
+                sink += account.applyWithdraw(Money::fromCents(i % 7 == 0 ? 99999999 : 150)) == OpResult::Ok;
+                account.applyDeposit(Money::fromCents(150));
+            }
+
+            double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (2 * operations);
+            setting.bestNs = std::min(setting.bestNs, ns);
+        }
+    }
+
+    Metrics::enabled = true;
+    Metrics::sampleEvery = 64;
+
+    cout << "setting,ns_per_op,overhead_pct\n";
+
+    for(const Setting& setting : settings){
+        cout << setting.name << "," << setting.bestNs << "," << 100.0 * (setting.bestNs - settings[0].bestNs) / settings[0].bestNs << "\n";
+    }
+
+    const LatencyHistogram& withdrawals = Metrics::latency[size_t(MetricOp::Withdraw)];
+    cout << "withdraw_p50_ns," << withdrawals.percentile(0.5) << ",p99_ns," << withdrawals.percentile(0.99) << ",p999_ns," << withdrawals.percentile(0.999) << "\n";
+
+    if(sink == 0){
+        cout << "(no work)\n";
+    }
+}
+
+long residentKb(){                                              //Current RSS from /proc/self/statm, 0 if unavailable
+    long pages = 0, resident = 0;
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+
+    if(statm == nullptr){
+        return 0;
+    }
+
+    if(std::fscanf(statm, "%ld %ld", &pages, &resident) != 2){
+        resident = 0;
+    }
+
+    std::fclose(statm);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+double poolRawRate(size_t threadCount, size_t operations){      //Blocks allocated+freed per second, small random classes in batches freed out of order
+    using Clock = std::chrono::steady_clock;
+
+    auto start = Clock::now();
+    vector<std::thread> threads;
+
+    for(size_t t = 0; t < threadCount; t++){
+        threads.emplace_back([operations, t](){
+            std::mt19937_64 engine(t + 1);
+            vector<std::pair<void*, size_t>> live;
+            live.reserve(256);
+
+            for(size_t done = 0; done < operations; done += 256){
+                for(size_t i = 0; i < 256; i++){
+                    size_t sizeClass = engine() % 9;                //64B-1KB, where account nodes and young chunks live
+                    live.emplace_back(NodePool::allocate(sizeClass), sizeClass);
+                }
+
+                std::shuffle(live.begin(), live.end(), engine);
+
+                for(const auto& [block, sizeClass] : live){
+                    NodePool::release(block, sizeClass);
+                }
+
+                live.clear();
+            }
+        });
+    }
+
+    for(std::thread& thread : threads){
+        thread.join();
+    }
+
+    return double(operations * threadCount) / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void poolChurn(bool pooled, size_t accounts, size_t rounds){    //One allocator's row for --bench pool, run in its own process so peak RSS is its own
+    using Clock = std::chrono::steady_clock;
+
+    NodePool::passthrough = !pooled;
+    Metrics::enabled = false;
+
+    std::mt19937_64 engine(7);
+    uint64_t allocationsBefore = NodePool::allocations;
+    double churnSeconds;
+    long liveKb;
+
+    {
+        AccountList list;
+        vector<string> names;
+
+        for(size_t i = 0; i < accounts; i++){
+            names.push_back("user" + std::to_string(i));
+        }
+
+        auto populate = [&](const string& name){               //Uneven history depth so chunk sizes vary like real accounts
+            BankAccount* account = list.restoreAccount(name, benchCredential());
+            size_t depth = engine() % 128;
+
+            for(size_t r = 0; r < depth; r++){
+                account -> deposit(r % 3 == 0 ? 'S' : 'C', Money::fromCents(100));
+            }
+        };
+
+        auto start = Clock::now();
+
+        for(const string& name : names){
+            populate(name);
+        }
+
+        for(size_t round = 0; round < rounds; round++){           //Delete a random half, then bring it back with fresh history
+            vector<size_t> victims;
+
+            for(size_t i = 0; i < accounts; i++){
+                if(engine() & 1){
+                    victims.push_back(i);
+                }
+            }
+
+            for(size_t i : victims){
+                list.deleteAccount(names[i]);
+            }
+
+            for(size_t i : victims){
+                populate(names[i]);
+            }
+        }
+
+        churnSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+        liveKb = residentKb();
+    }
+
+    uint64_t nodes = NodePool::allocations - allocationsBefore;
+    long freedKb = residentKb();                                //After the list is gone: the heap may trim, the pool keeps its spans for reuse
+    double raw1 = poolRawRate(1, 4000000);
+    double raw4 = poolRawRate(4, 1000000);
+
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+
+    cout << (pooled ? "pool" : "heap") << "," << churnSeconds << "," << nodes << "," << uint64_t(nodes / churnSeconds) << "," << uint64_t(raw1) << "," << uint64_t(raw4) << ","
+         << liveKb / 1024.0 << "," << freedKb / 1024.0 << "," << usage.ru_maxrss / 1024.0 << "," << NodePool::getMappedBytes() / 1048576.0 << "," << NodePool::getIdleBytes() / 1048576.0 << ","
+         << NodePool::getFailures() << "\n" << std::flush;
+}
+
+void benchPool(size_t accounts, size_t rounds){                 //Node churn and raw alloc/free rate through the size-class pool vs the global heap, each in its own process, run with --bench pool [accounts] [rounds]
+    cout << "allocator,churn_s,node_allocs,churn_allocs_per_sec,raw_allocs_per_sec_1t,raw_allocs_per_sec_4t,rss_live_mb,rss_freed_mb,peak_rss_mb,pool_mapped_mb,pool_idle_mb,failures\n" << std::flush;
+
+    for(bool pooled : {false, true}){
+        pid_t child = fork();
+
+        if(child == 0){
+            poolChurn(pooled, accounts, rounds);
+            _exit(0);
+        }
+
+        int status = 0;
+        waitpid(child, &status, 0);
+    }
+}
+
+void benchOrdered(const vector<size_t>& sizes){               //Sorted listing, cursor pages and prefix search through the ordered index vs sorting a copy, run with --bench ordered [account counts...]
+    using Clock = std::chrono::steady_clock;
+
+    cout << "accounts,sort_copy_ms,full_scan_ms,page_100_us,prefix_page_us,consistent\n";
+
+    for(size_t count : sizes){
+        std::mt19937_64 engine(count);
+        vector<string> names;
+
+        for(size_t i = 0; i < count; i++){
+            names.push_back("user" + std::to_string(engine() % (count * 10)));
+        }
+
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+        std::shuffle(names.begin(), names.end(), engine);
+
+        AccountList list;
+
+        for(const string& name : names){
+            list.restoreAccount(name, benchCredential());
+        }
+
+        for(size_t i = 0; i < names.size(); i += 3){              //Deletes exercise borrow/merge, the survivors are what every check compares against
+            list.deleteAccount(names[i]);
+        }
+
+        vector<string> expected;
+
+        for(size_t i = 0; i < names.size(); i++){
+            if(i % 3 != 0){
+                expected.push_back(names[i]);
+            }
+        }
+
+        auto start = Clock::now();                              //What an ordered listing costs without the index
+        vector<std::string_view> copy;
+
+        for(BankAccount* current = list.getHead(); current != nullptr; current = current -> getNext()){
+            copy.push_back(current -> getUsername());
+        }
+
+        std::sort(copy.begin(), copy.end());
+        double sortMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        std::sort(expected.begin(), expected.end());
+        vector<std::string_view> scanned;
+
+        start = Clock::now();
+        list.listAccounts("", "", list.size(), [&scanned](std::string_view name){
+            scanned.push_back(name);
+        });
+        double scanMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        bool consistent = scanned.size() == expected.size() && std::equal(scanned.begin(), scanned.end(), expected.begin());
+
+        const size_t pages = 10000;
+        size_t listed = 0;
+        start = Clock::now();
+        for(size_t i = 0; i < pages; i++){
+            listed += list.listAccounts("", expected[(i * 7919) % expected.size()], 100, [](std::string_view){});
+        }
+        double pageUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / pages;
+
+        for(size_t i = 0; i < 200 && consistent; i++){         //Random cursors and prefixes against the sorted copy
+            const string& after = expected[engine() % expected.size()];
+            string prefix = after.substr(0, 4 + engine() % 3);
+            vector<std::string_view> page;
+
+            list.listAccounts(prefix, after, 50, [&page](std::string_view name){
+                page.push_back(name);
+            });
+
+            auto from = std::upper_bound(expected.begin(), expected.end(), after);
+            size_t matched = 0;
+
+            for(auto it = from; it != expected.end() && matched < 50 && it -> compare(0, prefix.size(), prefix) == 0; ++it){
+                consistent = consistent && matched < page.size() && page[matched] == *it;
+                matched++;
+            }
+
+            consistent = consistent && matched == page.size();
+        }
+
+        start = Clock::now();
+        for(size_t i = 0; i < pages; i++){
+            string prefix = expected[(i * 7919) % expected.size()].substr(0, 6);
+            listed += list.listAccounts(prefix, "", 100, [](std::string_view){});
+        }
+        double prefixUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / pages;
+
+        cout << list.size() << "," << sortMs << "," << scanMs << "," << pageUs << "," << prefixUs << "," << (consistent ? "yes" : "NO") << "\n";
+
+        if(listed == 0){
+            cout << "(nothing listed)\n";
+        }
+    }
+}
+
+void benchBloom(const vector<size_t>& sizes){                  //Existence checks for unknown names with the name filter vs the index + snapshot search it short-circuits, run with --bench bloom [account counts...]
+    using Clock = std::chrono::steady_clock;
+
+    const string path = "/tmp/bankingSystem-bloom-bench.snap";
+    cout << "accounts,filter_mb,build_ms,false_positive_pct,miss_ns,miss_unfiltered_ns,speedup,hit_ns,hit_unfiltered_ns\n";
+
+    for(size_t count : sizes){
+        if(!writeSyntheticSnapshot(path, count)){
+            cout << "Could not write " << path << "\n";
+            return;
+        }
+
+        auto start = Clock::now();
+        Bank bank;
+
+        if(!bank.loadSnapshot(path)){
+            return;
+        }
+
+        bank.waitForNameFilter();
+        double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        std::unique_ptr<Snapshot> table = Snapshot::open(path);        //The lookup path as it was before the filter, over the same file
+        AccountList live;
+        NameFilter filter;                                  //Same sizing as the bank's, built here so its false positives can be counted directly
+        filter.reset(count * 5 / 4);
+
+        for(size_t i = 0; i < count; i++){
+            filter.add(table -> username(i));
+        }
+
+        char name[32];
+        const size_t checks = 1000000;
+        vector<string> hits, misses;                        //Misses sort right after a random real name, so the unfiltered search walks a different path each time
+        std::mt19937_64 engine(count);
+        hits.reserve(checks);
+        misses.reserve(checks);
+
+        for(size_t i = 0; i < checks; i++){
+            snprintf(name, sizeof(name), "user%08zu", size_t(engine() % count));
+            hits.emplace_back(name);
+            snprintf(name, sizeof(name), "user%08zux", size_t(engine() % count));
+            misses.emplace_back(name);
+        }
+
+        size_t passed = 0;
+
+        for(const string& username : misses){
+            passed += filter.mayContain(username);
+        }
+
+        auto timeChecks = [&](bool missing, auto&& exists){     //ns per check
+            const vector<string>& names = missing ? misses : hits;
+            size_t found = 0;
+            auto begin = Clock::now();
+
+            for(const string& username : names){
+                found += exists(username);
+            }
+
+            double ns = std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / checks;
+            return std::make_pair(ns, found);
+        };
+
+        auto filtered = [&bank](const string& username){
+            return bank.accountExists(username);
+        };
+
+        auto unfiltered = [&live, &table](const string& username){
+            return live.findAccount(username) != nullptr || table -> find(username) >= 0;
+        };
+
+        auto [missNs, missFound] = timeChecks(true, filtered);
+        auto [missOldNs, missOldFound] = timeChecks(true, unfiltered);
+        auto [hitNs, hitFound] = timeChecks(false, filtered);
+        auto [hitOldNs, hitOldFound] = timeChecks(false, unfiltered);
+
+        if(missFound != 0 || missOldFound != 0 || hitFound != checks || hitOldFound != checks){
+            cout << "(wrong answers)\n";
+        }
+
+        cout << count << "," << filter.memoryBytes() / 1048576.0 << "," << buildMs << "," << 100.0 * passed / checks << "," << missNs << "," << missOldNs << ","
+             << missOldNs / missNs << "," << hitNs << "," << hitOldNs << "\n";
+    }
+
+    ::unlink(path.c_str());
+}
+
+void benchColumns(const vector<size_t>& sizes){              //History aggregates through the columnar kernels, AVX2 vs scalar, against a record-by-record forEach walk, run with --bench columns [record counts...]
+    using Clock = std::chrono::steady_clock;
+
+    cout << "records,kernel,row_walk_mrec_s,scalar_mrec_s,avx2_mrec_s,agree\n";
+    bool hasAvx2 = ColumnKernels::detect();
+    bool original = ColumnKernels::vectorized;
+
+    for(size_t count : sizes){
+        TransactionHistory history;
+        std::mt19937_64 engine(count);
+        Money balance;
+
+        for(size_t i = 0; i < count; i++){                  //Random walk that never goes negative, roughly 60% deposits
+            Money change = Money::fromCents(int64_t(engine() % 50000));
+
+            if(engine() % 5 < 2 && change <= balance){
+                change = -change;
+            }
+
+            history.addRecord(change < Money() ? TransactionType::Withdrawal : TransactionType::Deposit, balance, change, int64_t(i));
+            balance = balance + change;
+        }
+
+        size_t repeats = std::max<size_t>(1, 50000000 / count);
+
+        auto rate = [&](auto&& kernel){                     //Million records per second, and the last result so the paths can be compared
+            int64_t result = 0;
+            auto start = Clock::now();
+
+            for(size_t r = 0; r < repeats; r++){
+                result = kernel();
+            }
+
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            return std::make_pair(double(count) * repeats / seconds / 1e6, result);
+        };
+
+        struct Kernel{
+            const char* name;
+            std::function<int64_t()> rows;
+            std::function<int64_t()> columns;
+        };
+
+        vector<Kernel> kernels = {
+            {"sum_deposits", [&history]{
+                int64_t total = 0;
+                history.forEach([&total](const Transaction& record){
+                    total += record.getType() == TransactionType::Deposit ? record.getBalanceChange().getCents() : 0;
+                });
+                return total;
+            }, [&history]{
+                return history.sumOf(TransactionType::Deposit).getCents();
+            }},
+            {"sum_withdrawals", [&history]{
+                int64_t total = 0;
+                history.forEach([&total](const Transaction& record){
+                    total += record.getType() == TransactionType::Withdrawal ? record.getBalanceChange().getCents() : 0;
+                });
+                return total;
+            }, [&history]{
+                return history.sumOf(TransactionType::Withdrawal).getCents();
+            }},
+            {"min_max_balance", [&history]{
+                int64_t low = std::numeric_limits<int64_t>::max(), high = std::numeric_limits<int64_t>::min();
+                history.forEach([&](const Transaction& record){
+                    low = std::min(low, record.getNewBalance().getCents());
+                    high = std::max(high, record.getNewBalance().getCents());
+                });
+                return low ^ (high << 1);
+            }, [&history]{
+                auto [low, high] = history.balanceRange();
+                return low.getCents() ^ (high.getCents() << 1);
+            }},
+            {"count_by_type", [&history]{
+                int64_t deposits = 0, withdrawals = 0;
+                history.forEach([&](const Transaction& record){
+                    (record.getType() == TransactionType::Deposit ? deposits : withdrawals)++;
+                });
+                return deposits * 1000003 + withdrawals;
+            }, [&history]{
+                return int64_t(history.countOf(TransactionType::Deposit)) * 1000003 + int64_t(history.countOf(TransactionType::Withdrawal));
+            }}
+        };
+
+        for(const Kernel& kernel : kernels){
+            auto rows = rate(kernel.rows);
+            ColumnKernels::vectorized = false;
+            auto scalar = rate(kernel.columns);
+            ColumnKernels::vectorized = hasAvx2;
+            auto avx2 = hasAvx2 ? rate(kernel.columns) : scalar;
+            bool agree = rows.second == scalar.second && scalar.second == avx2.second;
+
+            cout << count << "," << kernel.name << "," << rows.first << "," << scalar.first << ",";
+
+            if(hasAvx2){
+                cout << avx2.first;
+
+            } else {
+                cout << "n/a";
+            }
+
+            cout << "," << (agree ? "yes" : "NO") << "\n";
+        }
+    }
+
+    ColumnKernels::vectorized = original;
+}
+
+void benchAsOf(const vector<size_t>& sizes){                 //Balance-as-of and time-range queries through the chunk checkpoints vs walking the history from the head, run with --bench asof [record counts...]
+    using Clock = std::chrono::steady_clock;
+
+    cout << "records,asof_ns,asof_walk_ns,between_100_ns,between_100_walk_ns,speedup,agree\n";
+
+    for(size_t count : sizes){
+        TransactionHistory history;
+        std::mt19937_64 engine(count);
+        Money balance;
+
+        for(size_t i = 0; i < count; i++){                  //About one record a millisecond, with some sharing a timestamp
+            Money change = Money::fromCents(int64_t(engine() % 50000));
+
+            if(engine() % 5 < 2 && change <= balance){
+                change = -change;
+            }
+
+            history.addRecord(change < Money() ? TransactionType::Withdrawal : TransactionType::Deposit, balance, change, int64_t(1000 + i * 1000 - (i % 4) * 250 * (i % 2)));
+            balance = balance + change;
+        }
+
+        int64_t last = int64_t(count) * 1000;
+        size_t queries = 200000;
+        size_t walks = std::max<size_t>(5, std::min<size_t>(queries, 20000000 / count));
+        vector<int64_t> times(queries);
+
+        for(int64_t& time : times){
+            time = int64_t(engine() % uint64_t(last + 2000));
+        }
+
+        auto walkAsOf = [&history](int64_t micros){             //What answering this took before: every record from the head
+            Money result;
+            history.forEach([&](const Transaction& record){
+                if(record.getTimestamp() <= micros){
+                    result = record.getNewBalance();
+                }
+            });
+            return result;
+        };
+
+        auto walkBetween = [&history](int64_t from, int64_t to){
+            int64_t checksum = 0;
+            history.forEach([&](const Transaction& record){
+                if(record.getTimestamp() >= from && record.getTimestamp() <= to){
+                    checksum += record.getBalanceChange().getCents();
+                }
+            });
+            return checksum;
+        };
+
+        auto between = [&history](int64_t from, int64_t to){
+            int64_t checksum = 0;
+            history.forEachBetween(from, to, [&checksum](const Transaction& record){
+                checksum += record.getBalanceChange().getCents();
+            });
+            return checksum;
+        };
+
+        const int64_t window = 100 * 1000;                   //~100 records
+        int64_t sink = 0;
+        auto start = Clock::now();
+
+        for(int64_t time : times){
+            sink += history.balanceAsOf(time).getCents();
+        }
+
+        double asOfNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / queries;
+        start = Clock::now();
+
+        for(size_t i = 0; i < walks; i++){
+            sink += walkAsOf(times[i]).getCents();
+        }
+
+        double walkNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / walks;
+        start = Clock::now();
+
+        for(int64_t time : times){
+            sink += between(time, time + window);
+        }
+
+        double betweenNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / queries;
+        start = Clock::now();
+
+        for(size_t i = 0; i < walks; i++){
+            sink += walkBetween(times[i], times[i] + window);
+        }
+
+        double betweenWalkNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / walks;
+        bool agree = true;
+
+        for(size_t i = 0; i < walks; i++){
+            agree = agree && history.balanceAsOf(times[i]) == walkAsOf(times[i]) && between(times[i], times[i] + window) == walkBetween(times[i], times[i] + window);
+        }
+
+        cout << count << "," << asOfNs << "," << walkNs << "," << betweenNs << "," << betweenWalkNs << "," << walkNs / asOfNs << "," << (agree ? "yes" : "NO") << "\n";
+
+        if(sink == 0){
+            cout << "(no work)\n";
+        }
+    }
+}
+
+bool benchAllocations(size_t accountCount){                   //Heap allocations per lookup and login call, which should all be zero -- run with --bench allocs [accounts], exits 1 if any path allocates
+    using Clock = std::chrono::steady_clock;
+
+    if(!AllocationCounter::enabled){
+        cout << "Allocation counting is compiled out, rebuild with -DBANK_COUNT_ALLOCATIONS to run this benchmark.\n";
+        return false;
+    }
+
+    Bank bank;
+    vector<string> names, passwords;
+
+    for(size_t i = 0; i < accountCount; i++){               //Lengths 3-20, so plenty are past the 15 characters std::string keeps inline
+        string name = std::to_string(i);
+        name.resize(std::max(name.size(), 3 + i % 18), 'x');
+        names.push_back(name);
+        passwords.push_back(string(3 + (i * 7) % 18, char('a' + i % 26)));
+        bank.addAccount(names.back(), passwords.back());
+    }
+
+    vector<string> missing;
+
+    for(size_t i = 0; i < accountCount; i++){
+        missing.push_back("nobody_" + std::to_string(i) + "_here");
+    }
+
+    struct Path{
+        const char* name;
+        std::function<bool(size_t)> run;
+    };
+
+    vector<Path> paths = {
+        {"exists_hit", [&](size_t i){ return bank.accountExists(names[i]); }},
+        {"exists_miss", [&](size_t i){ return !bank.accountExists(missing[i]); }},
+        {"acquire", [&](size_t i){ return bool(bank.acquire(names[i])); }},
+        {"login_ok", [&](size_t i){ return bool(bank.signIn(names[i], passwords[i])); }},
+        {"login_wrong_password", [&](size_t i){ return !bank.signIn(names[i], missing[i]); }},
+        {"login_unknown_user", [&](size_t i){ return !bank.signIn(missing[i], passwords[i]); }},
+        {"authenticate", [&](size_t i){ return bank.authenticate(names[i], passwords[i]) == OpResult::Ok; }}
+    };
+
+    const size_t calls = 1000000;
+    bool clean = true;
+    cout << "path,calls,allocations_per_call,bytes_per_call,ns_per_call,correct\n";
+
+    for(const Path& path : paths){
+        for(size_t i = 0; i < std::min(accountCount, size_t(1000)); i++){      //Warm up first, thread-local metric shards register on first use
+            path.run(i);
+        }
+
+        bool correct = true;
+        uint64_t allocationsBefore = AllocationCounter::allocations, bytesBefore = AllocationCounter::bytes;
+        auto start = Clock::now();
+
+        for(size_t i = 0; i < calls; i++){
+            correct &= path.run((i * 2654435761ULL) % accountCount);
+        }
+
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / calls;
+        uint64_t allocations = AllocationCounter::allocations - allocationsBefore, bytes = AllocationCounter::bytes - bytesBefore;
+        clean = clean && allocations == 0;
+
+        cout << path.name << "," << calls << "," << double(allocations) / calls << "," << double(bytes) / calls << "," << ns << "," << (correct ? "yes" : "NO") << "\n";
+    }
+
+    cout << (clean ? "No heap allocations on any lookup or login path.\n" : "Some lookup or login path allocates.\n");
+    return clean;
+}
+
+void benchExport(size_t accountCount, size_t recordsPerAccount){        //Export, streaming decode and import throughput plus size against the raw record formats, run with --bench export [accounts] [records per account]
+    using Clock = std::chrono::steady_clock;
+
+    const string path = "/tmp/bankingSystem-export-bench.bin";
+    const string again = "/tmp/bankingSystem-export-bench-again.bin";
+    Bank bank;
+    std::mt19937_64 engine(accountCount);
+    int64_t now = nowMicros();
+
+    for(size_t i = 0; i < accountCount; i++){
+        string name = "user" + std::to_string(i);
+        bank.addAccount(name, "pass");
+        AccountHandle account = bank.acquire(name);
+
+        for(size_t r = 0; r < recordsPerAccount; r++){          //Retail-looking amounts a few seconds apart, about a third withdrawals
+            char code = engine() % 4 == 0 ? 'S' : 'C';
+            Money amount = Money::fromCents(int64_t(100 + engine() % 20000));
+            now += int64_t(engine() % 5000000);
+
+            if(engine() % 3 != 0 || account -> withdraw(code, amount, now) != OpResult::Ok){
+                account -> deposit(code, amount, now);
+            }
+        }
+    }
+
+    ExportStats exported;
+    auto start = Clock::now();
+    bool written = bank.exportAccounts(path, "", exported);
+    double exportSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if(!written){
+        cout << "Could not write " << path << "\n";
+        return;
+    }
+
+    start = Clock::now();                                   //Decode only, nothing kept: memory stays at the reader's buffer however large the file is
+    ExportReader reader(path);
+    uint64_t decoded = 0;
+    int64_t checksum = 0;
+
+    while(reader.ok() && reader.nextAccount()){
+        for(int sub = 0; sub < 2; sub++){
+            Money balance, oldBalance, change;
+            uint64_t records = 0;
+            TransactionType type;
+            int64_t timestamp;
+            reader.beginSubAccount(balance, records);
+
+            for(uint64_t r = 0; r < records && reader.nextRecord(type, oldBalance, change, timestamp); r++){
+                checksum += change.getCents();
+                decoded++;
+            }
+        }
+    }
+
+    double decodeSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    Bank copy;
+    ExportStats imported;
+    start = Clock::now();
+    bool read = copy.importAccounts(path, imported);
+    double importSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    ExportStats reexported;
+    bool identical = read && copy.exportAccounts(again, "", reexported) && reexported.bytes == exported.bytes;       //Same accounts in the same order, so a faithful import exports byte for byte the same
+    std::ifstream first(path, std::ios::binary), second(again, std::ios::binary);
+    identical = identical && std::equal(std::istreambuf_iterator<char>(first), std::istreambuf_iterator<char>(), std::istreambuf_iterator<char>(second));
+
+    double fileMb = exported.bytes / 1048576.0;
+    double rawMb = exported.records * sizeof(SnapshotRecord) / 1048576.0;
+    double memoryMb = exported.records * TransactionChunk::recordBytes / 1048576.0;
+
+    cout << "accounts,records,export_mb,snapshot_record_mb,in_memory_mb,ratio_vs_snapshot,bytes_per_record\n";
+    cout << exported.accounts << "," << exported.records << "," << fileMb << "," << rawMb << "," << memoryMb << "," << rawMb / fileMb << "," << double(exported.bytes) / exported.records << "\n";
+    cout << "phase,seconds,file_mb_s,raw_mb_s,mrecords_s\n";
+    cout << "export," << exportSeconds << "," << fileMb / exportSeconds << "," << rawMb / exportSeconds << "," << exported.records / exportSeconds / 1e6 << "\n";
+    cout << "decode," << decodeSeconds << "," << fileMb / decodeSeconds << "," << rawMb / decodeSeconds << "," << decoded / decodeSeconds / 1e6 << "\n";
+    cout << "import," << importSeconds << "," << fileMb / importSeconds << "," << rawMb / importSeconds << "," << imported.records / importSeconds / 1e6 << "\n";
+    cout << (identical && decoded == exported.records && checksum != 0 ? "Import round trip is byte-identical.\n" : "Import round trip differs!\n");
+
+    ::unlink(path.c_str());
+    ::unlink(again.c_str());
+}
+
+void benchSessions(const vector<size_t>& sizes){               //Menu sessions multiplexed on one thread, fed round-robin a line at a time: memory per parked session and lines/sec, run with --bench sessions [session counts...]
+    using Clock = std::chrono::steady_clock;
+
+    cout << "sessions,session_bytes,peak_frame_bytes_per_session,lines,seconds,lines_per_sec,transcripts_match\n";
+
+    for(size_t count : sizes){
+        Bank bank;
+        vector<std::unique_ptr<MenuSession>> sessions;
+        vector<string> names;
+        vector<size_t> written(count, 0);
+        int64_t framesBefore = MenuFlow::liveFrameBytes();
+        int64_t peakFrames = 0;
+
+        for(size_t i = 0; i < count; i++){
+            char name[32];
+            std::snprintf(name, sizeof(name), "sess%08zu", i);
+            names.emplace_back(name);
+            sessions.push_back(std::make_unique<MenuSession>(bank));
+            sessions.back() -> start();
+            written[i] += sessions.back() -> takeOutput().size();
+        }
+
+        const char* script[] = {"C", nullptr, "pass", "L", nullptr, "pass", "D", "C", "6000", "125.50", "W", "C", "5", "H", "C", "X", "U", nullptr, "pass", "newpass", "X"};     //nullptr is the session's own name
+        size_t lines = 0;
+        auto start = Clock::now();
+
+        for(const char* step : script){                        //Every session answers one prompt before any answers the next, so all of them are parked at once
+            for(size_t i = 0; i < count; i++){
+                sessions[i] -> feed(step != nullptr ? std::string_view(step) : std::string_view(names[i]));
+                written[i] += sessions[i] -> takeOutput().size();
+                lines++;
+            }
+
+            peakFrames = std::max(peakFrames, MenuFlow::liveFrameBytes() - framesBefore);
+        }
+
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        bool match = true;
+
+        for(size_t i = 0; i < count; i++){                      //Names are all the same length, so every transcript should be the same size
+            match = match && sessions[i] -> finished() && written[i] == written[0];
+        }
+
+        cout << count << "," << sizeof(MenuSession) << "," << (count > 0 ? peakFrames / int64_t(count) : 0) << "," << lines << "," << seconds << ","
+             << (seconds > 0 ? lines / seconds : 0) << "," << (match ? "yes" : "NO") << "\n";
+    }
+}
+
+template<typename Policy>
+class MutexPolicyAccount{                               //Benchmark stand-in for the previous design: every deposit/withdraw checks the balance, appends the history and stores the balance under the account mutex
+    private:
+        static constexpr int64_t balanceLimit = (int64_t(1) << 47) - 1;
+        static constexpr int64_t floorCents = Policy::minimumBalance.getCents() - Policy::overdraft.getCents();
+        static constexpr int64_t maxCents = Policy::maxTransaction.getCents();
+
+        mutable std::mutex lock;
+        TransactionHistory History;
+        std::atomic<int64_t> balanceCents;
+
+        template<typename Rule>
+        bool update(TransactionType type, Rule&& rule){
+            auto admitted = WriteAheadLog::admit(nullptr);
+            std::lock_guard<std::mutex> guard(lock);
+            int64_t cents = balanceCents.load(std::memory_order_relaxed);
+            int64_t newCents;
+
+            if(!rule(cents, newCents)){
+                return false;
+            }
+
+            History.addRecord(type, Money::fromCents(cents), Money::fromCents(newCents - cents));
+            balanceCents.store(newCents, std::memory_order_release);
+            return true;
+        }
+
+    public:
+        MutexPolicyAccount() : balanceCents(0) {}
+
+        OpResult applyDeposit(Money depositAmount){
+            OpTimer timer(MetricOp::Deposit);
+            int64_t amount = depositAmount.getCents();
+
+            if((amount <= 0) | (amount > maxCents)){
+                return timer.result(OpResult::OutOfBounds);
+            }
+
+            bool accepted = update(TransactionType::Deposit, [amount](int64_t cents, int64_t& newCents){
+                newCents = cents + amount;
+                return newCents <= balanceLimit;
+            });
+
+            return accepted ? OpResult::Ok : timer.result(OpResult::OutOfBounds);
+        }
+
+        OpResult applyWithdraw(Money withdrawAmount){
+            OpTimer timer(MetricOp::Withdraw);
+            int64_t amount = withdrawAmount.getCents();
+
+            if((amount <= 0) | (amount > maxCents)){
+                return timer.result(OpResult::OutOfBounds);
+            }
+
+            bool accepted = update(TransactionType::Withdrawal, [amount](int64_t cents, int64_t& newCents){
+                newCents = cents - amount;
+                return newCents >= floorCents;
+            });
+
+            return accepted ? OpResult::Ok : timer.result(OpResult::OutOfBounds);
+        }
+
+        Money getBalance() const{
+            return Money::fromCents(balanceCents.load(std::memory_order_acquire));
+        }
+
+        template<typename Visitor>
+        void readHistory(Visitor&& visit) const{
+            std::lock_guard<std::mutex> guard(lock);
+            History.forEach(visit);
+        }
+};
+
+template<typename Account>
+std::pair<double, bool> hammerAccount(Account& account, size_t threads, size_t operations){       //ops/sec of threads all depositing to and withdrawing from one account, and whether its history chains up to its balance
+    using Clock = std::chrono::steady_clock;
+
+    std::atomic<size_t> accepted(0);
+    vector<std::thread> workers;
+    auto start = Clock::now();
+
+    for(size_t t = 0; t < threads; t++){
+        workers.emplace_back([&account, &accepted, operations, t](){
+            uint64_t seed = 0x9E3779B97F4A7C15ULL * (t + 1);
+            size_t mine = 0;
+
+            for(size_t i = 0; i < operations; i++){
+                seed ^= seed << 13;
+                seed ^= seed >> 7;
+                seed ^= seed << 17;
+
+                Money amount = Money::fromCents(int64_t(100 + (seed >> 8) % 10000));     //$1-$101, so withdrawals near the floor get rejected
+                mine += ((seed & 1) ? account.applyDeposit(amount) : account.applyWithdraw(amount)) == OpResult::Ok;
+            }
+
+            accepted += mine;
+        });
+    }
+
+    for(std::thread& worker : workers){
+        worker.join();
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    Money expected;
+    size_t records = 0;
+    bool chained = true;
+
+    account.readHistory([&](const Transaction& record){
+        chained = chained && record.getOldBalance() == expected;
+        expected = record.getNewBalance();
+        records++;
+    });
+
+    return {threads * operations / seconds, chained && expected == account.getBalance() && records == accepted.load()};
+}
+
+void benchHotAccount(size_t operations, const vector<size_t>& threadCounts){          //Contention on one account, CAS balance + ordered history queue vs the account mutex, run with --bench hot [ops per thread] [thread counts...]
+    Metrics::enabled = false;                                   //Keep the figure about the account, not the instrumentation
+    cout << "threads,operations,mutex_ops_per_sec,cas_ops_per_sec,speedup,mutex_consistent,cas_consistent\n";
+
+    for(size_t threads : threadCounts){
+        MutexPolicyAccount<CheckingPolicy> locked;
+        CheckingAccount lockFree;
+        auto [mutexRate, mutexConsistent] = hammerAccount(locked, threads, operations);
+        auto [casRate, casConsistent] = hammerAccount(lockFree, threads, operations);
+
+        cout << threads << "," << threads * operations << "," << mutexRate << "," << casRate << "," << casRate / mutexRate << ","
+             << (mutexConsistent ? "yes" : "NO") << "," << (casConsistent ? "yes" : "NO") << "\n";
+    }
+
+    Metrics::enabled = true;
+}
+
+void benchTransfers(size_t transfers, size_t accountCount, const vector<size_t>& threadCounts){       //Random transfers among a few accounts, one at a time vs settled 1000 per call, checking money is conserved and every history chains, run with --bench transfer [transfers per thread] [accounts] [thread counts...]
+    using Clock = std::chrono::steady_clock;
+    constexpr size_t batchSize = 1000;
+
+    cout << "threads,mode,transfers,seconds,transfers_per_sec,accepted,conserved,histories_consistent\n";
+
+    for(size_t threads : threadCounts){
+        for(bool batched : {false, true}){
+            Bank bank;
+            vector<string> names;
+
+            for(size_t i = 0; i < accountCount; i++){
+                names.push_back("user" + std::to_string(i));
+                bank.createAccount(names.back(), "pass");
+                bank.acquire(names.back()) -> deposit('C', Money::dollars(1000));
+            }
+
+            std::atomic<size_t> accepted(0);
+            vector<std::thread> workers;
+            auto start = Clock::now();
+
+            for(size_t t = 0; t < threads; t++){
+                workers.emplace_back([&bank, &names, &accepted, transfers, batched, t](){
+                    uint64_t seed = 0x9E3779B97F4A7C15ULL * (t + 1);
+                    vector<TransferOrder> orders;
+                    size_t mine = 0;
+
+                    for(size_t i = 0; i < transfers; i++){
+                        seed ^= seed << 13;
+                        seed ^= seed >> 7;
+                        seed ^= seed << 17;
+
+                        TransferOrder order{names[seed % names.size()], (seed >> 20) & 1 ? 'S' : 'C', names[(seed >> 24) % names.size()], (seed >> 21) & 1 ? 'S' : 'C', Money::fromCents(int64_t(100 + (seed >> 40) % 50000)), OpResult::Ok};
+
+                        if(!batched){
+                            mine += bank.transfer(order.fromUser, order.fromChoice, order.toUser, order.toChoice, order.amount) == OpResult::Ok;
+                            continue;
+                        }
+
+                        orders.push_back(order);
+
+                        if(orders.size() == batchSize || i + 1 == transfers){
+                            mine += bank.settleTransfers(orders);
+                            orders.clear();
+                        }
+                    }
+
+                    accepted += mine;
+                });
+            }
+
+            for(std::thread& worker : workers){
+                worker.join();
+            }
+
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            int64_t total = 0;
+            size_t records = 0;
+            bool chained = true;
+
+            for(const string& name : names){
+                AccountHandle account = bank.acquire(name);
+
+                for(char code : {'C', 'S'}){
+                    SubAccount* sub = account -> getSubAccount(code);
+                    auto [balance, count] = sub -> readState();
+                    Money expected;
+
+                    sub -> readHistory([&](const Transaction& record){
+                        chained = chained && record.getOldBalance() == expected;
+                        expected = record.getNewBalance();
+                    });
+
+                    chained = chained && expected == balance;
+                    total += balance.getCents();
+                    records += count;
+                }
+            }
+
+            bool conserved = total == int64_t(accountCount) * Money::dollars(1010).getCents();
+            bool paired = records == 2 * accountCount + 2 * accepted.load();        //Opening savings deposit and the $1000 checking deposit, then two per transfer
+
+            cout << threads << "," << (batched ? "batched" : "single") << "," << threads * transfers << "," << seconds << "," << threads * transfers / seconds << ","
+                 << accepted.load() << "," << (conserved ? "yes" : "NO") << "," << (chained && paired ? "yes" : "NO") << "\n";
+        }
+    }
+}
+
+bool benchRecovery(size_t operations, size_t threads){         //Snapshots written while deposits, withdrawals, transfers and password changes keep going, then each one loaded and the log replayed from its offset -- every one has to land exactly on the live bank's final state, run with --bench recovery [ops per thread] [threads], exits 1 if any doesn't
+    using Clock = std::chrono::steady_clock;
+    constexpr size_t accountCount = 32;
+    constexpr size_t maxSnapshots = 8;
+
+    const string logPath = "/tmp/bankingSystem-recovery-bench.log";
+    const string snapshotPath = "/tmp/bankingSystem-recovery-bench.snap";
+    ::unlink(logPath.c_str());
+
+    Bank bank;
+    bank.attachJournal(std::make_unique<WriteAheadLog>(logPath, Durability::Async));
+    vector<string> names;
+
+    for(size_t i = 0; i < accountCount; i++){
+        names.push_back("user" + std::to_string(i));
+        bank.createAccount(names.back(), "pass");
+    }
+
+    std::atomic<size_t> running(threads);
+    vector<std::thread> workers;
+    auto start = Clock::now();
+
+    for(size_t t = 0; t < threads; t++){
+        workers.emplace_back([&bank, &names, &running, operations, t](){
+            uint64_t seed = 0x9E3779B97F4A7C15ULL * (t + 1);
+
+            for(size_t i = 0; i < operations; i++){
+                seed ^= seed << 13;
+                seed ^= seed >> 7;
+                seed ^= seed << 17;
+
+                const string& name = names[seed % names.size()];
+                char code = (seed >> 20) & 1 ? 'S' : 'C';
+                Money amount = Money::fromCents(int64_t(100 + (seed >> 40) % 50000));
+                unsigned pick = (seed >> 32) % 16;
+
+                if(pick < 6){
+                    bank.acquire(name) -> deposit(code, amount);
+
+                } else if(pick < 10){
+                    bank.acquire(name) -> withdraw(code, amount);
+
+                } else if(pick < 15){
+                    bank.transfer(name, code, names[(seed >> 24) % names.size()], (seed >> 21) & 1 ? 'S' : 'C', amount);
+
+                } else {
+                    bank.acquire(name) -> setPassword("pass" + std::to_string(i));
+                }
+            }
+
+            running--;
+        });
+    }
+
+    size_t snapshots = 0;
+    bool written = true;
+
+    while(running.load() > 0 && snapshots < maxSnapshots){         //Each one taken mid-stream, with changes landing on both sides of its capture
+        written = written && bank.writeSnapshot(snapshotPath + std::to_string(snapshots++));
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    for(std::thread& worker : workers){
+        worker.join();
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    bank.getJournal() -> flushAll();
+
+    auto sameAccount = [](BankAccount& live, BankAccount& restored){
+        if(!restored.hasCredential(live.getCredential())){
+            return false;
+        }
+
+        for(char code : {'C', 'S'}){
+            vector<std::tuple<int64_t, int64_t, int64_t, TransactionType>> records[2];
+            SubAccount* sides[2] = {live.getSubAccount(code), restored.getSubAccount(code)};
+
+            for(int side = 0; side < 2; side++){
+                sides[side] -> readHistory([&records, side](const Transaction& record){
+                    records[side].emplace_back(record.getOldBalance().getCents(), record.getBalanceChange().getCents(), record.getTimestamp(), record.getType());
+                });
+            }
+
+            if(sides[0] -> getBalance() != sides[1] -> getBalance() || records[0] != records[1]){
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    size_t matched = 0;
+
+    for(size_t i = 0; i < snapshots; i++){
+        string path = snapshotPath + std::to_string(i);
+        Bank restored;
+        bool same = restored.loadSnapshot(path) && openJournal(restored, logPath, Durability::Async);
+
+        for(size_t a = 0; same && a < names.size(); a++){
+            AccountHandle live = bank.acquire(names[a]);
+            AccountHandle copy = restored.acquire(names[a]);
+            same = copy && sameAccount(*live.get(), *copy.get());
+        }
+
+        matched += same;
+        ::unlink(path.c_str());
+    }
+
+    ::unlink(logPath.c_str());
+
+    cout << "threads,operations,seconds,snapshots,recovered_exactly\n";
+    cout << threads << "," << threads * operations << "," << seconds << "," << snapshots << "," << (written && snapshots > 0 && matched == snapshots ? "yes" : "NO") << "\n";
+    return written && snapshots > 0 && matched == snapshots;
+}
+
+void benchLogin(const vector<HashSettings>& settingsList){      //Logins/sec through Bank::signIn per hash setting and thread count, with every login paying the KDF and again with the session cache, run with --bench login [settings...]
+    using Clock = std::chrono::steady_clock;
+    constexpr double budget = 0.5;                              //Seconds per row, a count would take minutes at the expensive settings
+
+    if(!checkHashVectors(cout, true)){
+        return;
+    }
+
+    vector<size_t> threadCounts;
+
+    for(size_t threads = 1; threads <= std::max(1u, std::thread::hardware_concurrency()); threads *= 2){
+        threadCounts.push_back(threads);
+    }
+
+    cout << "settings,memory_kb,threads,logins,seconds,logins_per_sec,ms_per_login,cached_logins_per_sec\n";
+
+    for(const HashSettings& settings : settingsList){
+        PasswordHasher::configure(settings);
+        Bank bank;
+
+        for(size_t i = 0; i < threadCounts.back(); i++){
+            bank.createAccount("user" + std::to_string(i), "pass" + std::to_string(i));
+        }
+
+        size_t memoryKb = settings.scheme == HashScheme::Scrypt ? ((size_t(128) * settings.blockSize) << settings.cost) / 1024 : 0;
+
+        for(size_t threads : threadCounts){
+            auto run = [&](size_t& logins, bool& allAccepted){             //Each thread signs in as its own user until the budget runs out
+                std::atomic<size_t> total{0};
+                std::atomic<bool> accepted{true};
+                vector<std::thread> workers;
+                Clock::time_point start = Clock::now();
+
+                for(size_t t = 0; t < threads; t++){
+                    workers.emplace_back([&, t](){
+                        string name = "user" + std::to_string(t);
+                        string password = "pass" + std::to_string(t);
+                        size_t done = 0;
+
+                        while(std::chrono::duration<double>(Clock::now() - start).count() < budget){
+                            if(!bank.signIn(name, password)){
+                                accepted = false;
+                            }
+
+                            done++;
+                        }
+
+                        total += done;
+                    });
+                }
+
+                for(std::thread& worker : workers){
+                    worker.join();
+                }
+
+                logins = total;
+                allAccepted = accepted;
+                return std::chrono::duration<double>(Clock::now() - start).count();
+            };
+
+            size_t logins = 0, cachedLogins = 0;
+            bool accepted = true, cachedAccepted = true;
+
+            PasswordHasher::setCacheSeconds(0);
+            double seconds = run(logins, accepted);
+            PasswordHasher::setCacheSeconds(300);
+            double cachedSeconds = run(cachedLogins, cachedAccepted);
+
+            if(!accepted || !cachedAccepted){
+                cout << describeHashSettings(settings) << ": a correct password was REJECTED\n";
+                return;
+            }
+
+            cout << describeHashSettings(settings) << "," << memoryKb << "," << threads << "," << logins << "," << seconds << "," << logins / seconds << ","
+                 << seconds * 1000.0 * threads / logins << "," << cachedLogins / cachedSeconds << "\n";
+        }
+    }
+}
+
+void benchThreads(size_t operations, size_t accountCount){      //Multi-threaded stress on the shared Bank with 1-64 threads, run with --bench threads [ops per thread] [accounts]
+    using Clock = std::chrono::steady_clock;
+
+    cout << "threads,operations,seconds,ops_per_sec,speedup,balances_consistent\n";
+    double baseline = 0;
+
+    for(size_t threads = 1; threads <= 64; threads *= 2){
+        Bank bank;
+
+        for(size_t i = 0; i < accountCount; i++){
+            bank.createAccount("user" + std::to_string(i), "pass");
+        }
+
+        std::atomic<int64_t> expectedNet(0);                //Net of every acknowledged deposit/withdrawal, checked against the final balances
+        vector<std::thread> workers;
+        auto start = Clock::now();
+
+        for(size_t t = 0; t < threads; t++){
+            workers.emplace_back([&bank, &expectedNet, operations, accountCount, t](){
+                uint64_t seed = 0x9E3779B97F4A7C15ULL * (t + 1);
+                int64_t net = 0;
+                string scratch = "temp" + std::to_string(t);
+
+                for(size_t i = 0; i < operations; i++){
+                    seed ^= seed << 13;
+                    seed ^= seed >> 7;
+                    seed ^= seed << 17;
+
+                    if(seed % 1000 == 0){                   //Rare directory writes: create and delete a private account
+                        bank.createAccount(scratch, "pass");
+                        bank.deleteAccount(scratch, "pass");
+                        continue;
+                    }
+
+                    AccountHandle account = bank.acquire("user" + std::to_string(seed % accountCount));
+                    char choice = (seed >> 20) & 1 ? 'S' : 'C';
+                    Money amount = Money::fromCents(int64_t((seed >> 24) % 2000));
+
+                    if((seed >> 40) % 100 == 0){            //Occasional history read under the account lock
+                        account -> getSubAccount(choice) -> historySize();
+
+                    } else if((seed >> 32) & 1){
+                        net += account -> deposit(choice, amount) == OpResult::Ok ? amount.getCents() : 0;
+
+                    } else {
+                        net -= account -> withdraw(choice, amount) == OpResult::Ok ? amount.getCents() : 0;
+                    }
+                }
+
+                expectedNet += net;
+            });
+        }
+
+        for(std::thread& worker : workers){
+            worker.join();
+        }
+
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        int64_t actualNet = 0;
+
+        for(size_t i = 0; i < accountCount; i++){
+            AccountHandle account = bank.acquire("user" + std::to_string(i));
+            actualNet += account -> getSubAccount('C') -> getBalance().getCents() + account -> getSubAccount('S') -> getBalance().getCents() - Money::dollars(10).getCents();
+        }
+
+        double rate = operations * threads / seconds;
+        baseline = threads == 1 ? rate : baseline;
+
+        cout << threads << "," << operations * threads << "," << seconds << "," << rate << "," << rate / baseline << "," << (actualNet == expectedNet.load() ? "yes" : "NO") << "\n";
+    }
+}
+
+void benchRender(const vector<size_t>& sizes){                  //History rendering throughput, legacy cout-per-field vs the buffered renderer in each format, run with --bench render [record counts...]
+    using Clock = std::chrono::steady_clock;
+
+    std::ofstream devNull("/dev/null", std::ios::binary);
+    cout << "records,format,seconds,mb_per_sec,records_per_sec\n";
+
+    for(size_t count : sizes){
+        TransactionHistory history;
+        Money balance;
+
+        for(size_t i = 0; i < count; i++){
+            Money change = Money::fromCents(i % 3 == 0 ? -int64_t(i % 9000) : int64_t(i % 500000));
+            history.addRecord(change < Money() ? TransactionType::Withdrawal : TransactionType::Deposit, balance, change);
+            balance += change;
+        }
+
+        HistoryRenderer renderer;
+        renderer.render(history, RenderFormat::Text, devNull);          //Warm up and measure how many bytes the text layout is
+        uint64_t textBytes = renderer.getWritten();
+
+        std::streambuf* saved = cout.rdbuf(devNull.rdbuf());            //Legacy path: displayRecords straight into cout
+        auto start = Clock::now();
+        history.displayRecords();
+        cout.flush();
+        double legacySeconds = std::chrono::duration<double>(Clock::now() - start).count();
+        cout.rdbuf(saved);
+
+        cout << count << ",legacy_cout," << legacySeconds << "," << textBytes / legacySeconds / 1e6 << "," << count / legacySeconds << "\n";
+
+        const std::pair<const char*, RenderFormat> formats[] = {{"text", RenderFormat::Text}, {"csv", RenderFormat::Csv}, {"json", RenderFormat::Json}};
+
+        for(const auto& [formatName, format] : formats){
+            uint64_t before = renderer.getWritten();
+            start = Clock::now();
+            renderer.render(history, format, devNull);
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            cout << count << "," << formatName << "," << seconds << "," << (renderer.getWritten() - before) / seconds / 1e6 << "," << count / seconds << "\n";
+        }
+    }
+}
+
+class NullBuffer : public std::streambuf{             //Discards everything, so output benchmarks measure formatting rather than the terminal
+    protected:
+        int overflow(int character){
+            return character;
+        }
+
+        std::streamsize xsputn(const char*, std::streamsize count){
+            return count;
+        }
+};
+
+struct SuiteResult{
+    double nsPerOp;
+    double allocationsPerOp;
+};
+
+template<typename Body>
+SuiteResult measureOps(size_t operations, Body&& body){        //Runs body (which performs `operations` operations) once, timing it and diffing this thread's allocation count
+    using Clock = std::chrono::steady_clock;
+
+    uint64_t allocationsBefore = AllocationCounter::allocations;
+    auto start = Clock::now();
+    body();
+    double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    uint64_t allocations = AllocationCounter::allocations - allocationsBefore;
+
+    return SuiteResult{elapsed / operations, double(allocations) / operations};
+}
+
+void reportSuite(const char* benchmark, size_t accounts, size_t historyLength, size_t operations, SuiteResult result){        //One JSON object per line, stable keys so runs can be diffed
+    cout << "{\"benchmark\":\"" << benchmark << "\",\"accounts\":" << accounts << ",\"history\":" << historyLength
+         << ",\"operations\":" << operations << ",\"ns_per_op\":" << result.nsPerOp << ",\"allocs_per_op\":";
+
+    if(AllocationCounter::enabled){
+        cout << result.allocationsPerOp << "}\n";
+    } else {
+        cout << "null}\n";
+    }
+}
+
+void benchSuite(size_t accounts, size_t historyLength){        //Hot paths of the real classes on synthetic data, run with --bench suite [accounts] [history length]
+    vector<string> names;
+    names.reserve(accounts);
+
+    for(size_t i = 0; i < accounts; i++){
+        names.push_back("user" + std::to_string(i));
+    }
+
+    {
+        AccountList list;
+        reportSuite("AccountList::addAccount", accounts, historyLength, accounts, measureOps(accounts, [&](){
+            for(const string& name : names){
+                list.addAccount(name, benchCredential());
+            }
+        }));
+
+        reportSuite("AccountList::deleteAccount", accounts, historyLength, accounts, measureOps(accounts, [&](){
+            for(const string& name : names){
+                list.deleteAccount(name);
+            }
+        }));
+    }
+
+    {
+        Bank bank;
+
+        for(const string& name : names){
+            bank.createAccount(name, "pass");
+        }
+
+        const size_t lookups = 1000000;
+        vector<string> probes;
+
+        for(size_t i = 0; i < 4096; i++){                   //Half hits, half misses
+            probes.push_back(i & 1 ? names[(i * 2654435761ULL) % accounts] : "absent" + std::to_string(i));
+        }
+
+        size_t found = 0;
+        reportSuite("Bank::accountExists", accounts, historyLength, lookups, measureOps(lookups, [&](){
+            for(size_t i = 0; i < lookups; i++){
+                found += bank.accountExists(probes[i & 4095]);
+            }
+        }));
+
+        if(found == 0){
+            cout << "(no matches)\n";
+        }
+    }
+
+    {
+        size_t histories = std::max<size_t>(1, 1000000 / std::max<size_t>(1, historyLength));         //Enough histories for ~1M appends total
+        vector<TransactionHistory> store(histories);
+
+        reportSuite("TransactionHistory::addRecord", accounts, historyLength, histories * historyLength, measureOps(histories * historyLength, [&](){
+            for(TransactionHistory& history : store){
+                Money balance;
+
+                for(size_t i = 0; i < historyLength; i++){
+                    history.addRecord(TransactionType::Deposit, balance, Money::fromCents(int64_t(i % 500000)));
+                    balance += Money::fromCents(int64_t(i % 500000));
+                }
+            }
+        }));
+
+        NullBuffer discard;
+        std::ostream nullSink(&discard);
+        std::streambuf* saved = cout.rdbuf(&discard);
+
+        SuiteResult legacy = measureOps(historyLength, [&](){
+            store[0].displayRecords();
+        });
+
+        cout.rdbuf(saved);
+        reportSuite("TransactionHistory::displayRecords", accounts, historyLength, historyLength, legacy);
+
+        HistoryRenderer renderer;
+        reportSuite("HistoryRenderer::render(text)", accounts, historyLength, historyLength, measureOps(historyLength, [&](){
+            renderer.render(store[0], RenderFormat::Text, nullSink);
+        }));
+    }
+
+    {
+        const size_t strips = 1000000;
+        vector<string> padded = {"   alice  ", "\tbob\n", "carol", "  dave with spaces  ", "                 "};
+        size_t kept = 0;
+
+        reportSuite("stripSpace", accounts, historyLength, strips, measureOps(strips, [&](){
+            for(size_t i = 0; i < strips; i++){
+                kept += stripSpace(padded[i % padded.size()]).size();
+            }
+        }));
+
+        if(kept == 0){
+            cout << "(nothing kept)\n";
+        }
+    }
+}
+
+vector<size_t> benchSizes(int argc, char* argv[], vector<size_t> defaults){      //Numeric arguments after the benchmark name, or the defaults if none were given
+    vector<size_t> sizes;
+
+    for(int i = 3; i < argc; i++){
+        sizes.push_back(std::stoull(argv[i]));
+    }
+
+    return sizes.empty() ? defaults : sizes;
+}
+
+int runBenchmark(int argc, char* argv[]){                       //Entry point for --bench <name> [args...], kept out of the interactive flow
+    string name = argc > 2 ? argv[2] : "";
+    PasswordHasher::configure(HashSettings{HashScheme::Pbkdf2Sha256, 1, 0, 0});        //Cheapest setting, so account setup doesn't swamp what the other benchmarks measure -- login picks its own
+
+    if(name == "lookup"){
+        vector<size_t> sizes = benchSizes(argc, argv, {10000, 1000000, 10000000});
+        benchLookup(sizes);
+        return 0;
+    }
+
+    if(name == "money"){
+        vector<size_t> sizes = benchSizes(argc, argv, {100000, 1000000, 10000000});
+        benchMoney(sizes);
+        return 0;
+    }
+
+    if(name == "wal"){
+        size_t operations = argc > 3 ? std::stoull(argv[3]) : 2000;
+        vector<size_t> threads;
+
+        for(int i = 4; i < argc; i++){
+            threads.push_back(std::stoull(argv[i]));
+        }
+
+        benchJournal(operations, threads.empty() ? vector<size_t>{1, 4, 16} : threads);
+        return 0;
+    }
+
+    if(name == "snapshot"){
+        vector<size_t> sizes = benchSizes(argc, argv, {1000, 100000, 1000000, 10000000});
+        benchSnapshot(sizes);
+        return 0;
+    }
+
+    if(name == "policy"){
+        benchPolicy(argc > 3 ? std::stoull(argv[3]) : 5000000);
+        return 0;
+    }
+
+    if(name == "metrics"){
+        benchMetrics(argc > 3 ? std::stoull(argv[3]) : 2000000);
+        return 0;
+    }
+
+    if(name == "ordered"){
+        vector<size_t> sizes = benchSizes(argc, argv, {10000, 1000000});
+        benchOrdered(sizes);
+        return 0;
+    }
+
+    if(name == "bloom"){
+        vector<size_t> sizes = benchSizes(argc, argv, {10000, 1000000, 10000000});
+        benchBloom(sizes);
+        return 0;
+    }
+
+    if(name == "columns"){
+        vector<size_t> sizes = benchSizes(argc, argv, {1000, 100000, 10000000});
+        benchColumns(sizes);
+        return 0;
+    }
+
+    if(name == "asof"){
+        vector<size_t> sizes = benchSizes(argc, argv, {1000, 100000, 10000000});
+        benchAsOf(sizes);
+        return 0;
+    }
+
+    if(name == "allocs"){
+        return benchAllocations(argc > 3 ? std::stoull(argv[3]) : 100000) ? 0 : 1;
+    }
+
+    if(name == "export"){
+        benchExport(argc > 3 ? std::stoull(argv[3]) : 10000, argc > 4 ? std::stoull(argv[4]) : 1000);
+        return 0;
+    }
+
+    if(name == "sessions"){
+        vector<size_t> sizes = benchSizes(argc, argv, {1000, 100000});
+        benchSessions(sizes);
+        return 0;
+    }
+
+    if(name == "hot"){
+        size_t operations = argc > 3 ? std::stoull(argv[3]) : 500000;
+        vector<size_t> threads;
+
+        for(int i = 4; i < argc; i++){
+            threads.push_back(std::stoull(argv[i]));
+        }
+
+        benchHotAccount(operations, threads.empty() ? vector<size_t>{1, 2, 4, 8, 16, 64} : threads);
+        return 0;
+    }
+
+    if(name == "transfer"){
+        size_t transfers = argc > 3 ? std::stoull(argv[3]) : 200000;
+        size_t accounts = argc > 4 ? std::stoull(argv[4]) : 64;
+        vector<size_t> threads;
+
+        for(int i = 5; i < argc; i++){
+            threads.push_back(std::stoull(argv[i]));
+        }
+
+        benchTransfers(transfers, std::max<size_t>(accounts, 1), threads.empty() ? vector<size_t>{1, 2, 4, 8, 16, 64} : threads);
+        return 0;
+    }
+
+    if(name == "pool"){
+        benchPool(argc > 3 ? std::stoull(argv[3]) : 100000, argc > 4 ? std::stoull(argv[4]) : 10);
+        return 0;
+    }
+
+    if(name == "recovery"){
+        return benchRecovery(argc > 3 ? std::stoull(argv[3]) : 100000, argc > 4 ? std::stoull(argv[4]) : 4) ? 0 : 1;
+    }
+
+    if(name == "login"){
+        vector<HashSettings> settings;
+
+        for(int i = 3; i < argc; i++){
+            settings.emplace_back();
+
+            if(!parseHashSettings(argv[i], settings.back())){
+                cout << "Hash settings must be scrypt[:log2 N[:r[:p]]] or pbkdf2[:iterations], within sane bounds.\n";
+                return 1;
+            }
+        }
+
+        if(settings.empty()){                                   //scrypt from 1MB to 64MB at r = 8, then PBKDF2 at a legacy and the current recommended count
+            for(uint32_t costLog2 = 10; costLog2 <= 16; costLog2++){
+                settings.push_back(HashSettings{HashScheme::Scrypt, costLog2, 8, 1});
+            }
+
+            settings.push_back(HashSettings{HashScheme::Pbkdf2Sha256, 100000, 0, 0});
+            settings.push_back(HashSettings{HashScheme::Pbkdf2Sha256, 600000, 0, 0});
+        }
+
+        benchLogin(settings);
+        return 0;
+    }
+
+    if(name == "threads"){
+        benchThreads(argc > 3 ? std::stoull(argv[3]) : 200000, argc > 4 ? std::stoull(argv[4]) : 10000);
+        return 0;
+    }
+
+    if(name == "render"){
+        vector<size_t> sizes = benchSizes(argc, argv, {10000, 1000000});
+        benchRender(sizes);
+        return 0;
+    }
+
+    if(name == "suite"){
+        benchSuite(argc > 3 ? std::stoull(argv[3]) : 100000, argc > 4 ? std::stoull(argv[4]) : 1000);
+        return 0;
+    }
+
+    cout << "Unknown benchmark. Available: lookup, money, wal, snapshot, policy, metrics, ordered, bloom, columns, asof, allocs, pool, export, sessions, hot, transfer, recovery, login, threads, render, suite\n";
+    return 1;
+}
@@ -0,0 +1,347 @@
+#include "../bank/server.h"
+#include "tools.h"
+
+enum class ScriptDialect{Flat, Split, SplitConfirm};          //How a version wants its menus answered: 1.0 has one balance, 1.3+ pick C/S, 1.4 reads every amount twice
+
+bool parseDialect(const string& text, ScriptDialect& dialect){
+    if(text == "flat"){
+        dialect = ScriptDialect::Flat;
+
+    } else if(text == "split"){
+        dialect = ScriptDialect::Split;
+
+    } else if(text == "confirm"){
+        dialect = ScriptDialect::SplitConfirm;
+
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+struct VersionTarget{                                               //One binary under comparison, given as label=path[@flat|split|confirm]
+    string label;
+    string binary;
+    ScriptDialect dialect;
+};
+
+class ScriptBuilder{                                                //Writes the same abstract workload as keystrokes in a version's dialect
+    private:
+        ScriptDialect dialect;
+        string script;
+
+        void line(const string& text){
+            script += text;
+            script += '\n';
+        }
+
+        void amount(char account, const char* action, int dollars){
+            line(action);
+
+            if(dialect != ScriptDialect::Flat){
+                line(string(1, account));
+            }
+
+            line(std::to_string(dollars));
+
+            if(dialect == ScriptDialect::SplitConfirm){           //1.4 prompts once in deposit/withdraw and again inside validate()
+                line(std::to_string(dollars));
+            }
+        }
+
+    public:
+        explicit ScriptBuilder(ScriptDialect newDialect) : dialect(newDialect) {}
+
+        static string username(size_t i){
+            char name[32];
+            std::snprintf(name, sizeof(name), "user%06zu", i);
+            return name;
+        }
+
+        void create(size_t i){
+            line("C");
+            line(username(i));
+            line("pass1234");
+        }
+
+        void login(size_t i){
+            line("L");
+            line(username(i));
+            line("pass1234");
+        }
+
+        void deposit(char account, int dollars){
+            amount(account, "D", dollars);
+        }
+
+        void withdraw(char account, int dollars){
+            amount(account, "W", dollars);
+        }
+
+        void history(char account){
+            line("H");
+
+            if(dialect != ScriptDialect::Flat){
+                line(string(1, account));
+            }
+        }
+
+        void logout(){
+            line("X");
+        }
+
+        string finish(){
+            line("X");
+            return script;
+        }
+};
+
+struct ScriptRun{                                                   //Outcome of one child process fed a script on stdin
+    double seconds = 0;
+    long peakKb = 0;
+    bool ok = false;
+};
+
+ScriptRun runScript(const string& binary, const string& script, unsigned timeoutSeconds, FILE* output = nullptr){       //Script goes through an unlinked temp file rather than a pipe so a stalled child can never block the writer
+    ScriptRun run;
+    FILE* input = std::tmpfile();
+
+    if(input == nullptr){
+        return run;
+    }
+
+    std::fwrite(script.data(), 1, script.size(), input);
+    std::fflush(input);
+    std::rewind(input);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t child = fork();
+
+    if(child == 0){
+        int sink = output != nullptr ? fileno(output) : open("/dev/null", O_WRONLY);
+        dup2(fileno(input), STDIN_FILENO);
+        dup2(sink, STDOUT_FILENO);
+        dup2(sink, STDERR_FILENO);
+        alarm(timeoutSeconds);                                      //Pending alarms survive exec, so a version stuck reprompting at EOF gets killed
+        execl(binary.c_str(), binary.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+
+    std::fclose(input);
+
+    if(child < 0){
+        return run;
+    }
+
+    int status = 0;
+    struct rusage usage{};
+
+    if(wait4(child, &status, 0, &usage) < 0){
+        return run;
+    }
+
+    run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    run.peakKb = usage.ru_maxrss;
+    run.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    return run;
+}
+
+size_t countAmountPrompts(const string& binary, const string& script, unsigned timeoutSeconds){         //Dry run with stdout kept, a version fed the wrong dialect desyncs and asks for a different number of amounts
+    FILE* output = std::tmpfile();
+
+    if(output == nullptr){
+        return 0;
+    }
+
+    size_t prompts = 0;
+
+    if(runScript(binary, script, timeoutSeconds, output).ok){
+        std::rewind(output);
+        char line[512];
+
+        while(std::fgets(line, sizeof(line), output) != nullptr){
+            if(std::strncmp(line, "How much would you like to", 26) == 0){
+                prompts++;
+            }
+        }
+    }
+
+    std::fclose(output);
+    return prompts;
+}
+
+enum class ComparePhase{Startup, Create, Login, Deposit, Withdraw, History, Mixed};
+
+string comparisonScript(ScriptDialect dialect, ComparePhase phase, size_t operations){      //Each phase extends the one it is diffed against by exactly `operations` of one kind
+    ScriptBuilder script(dialect);
+    size_t views = std::min<size_t>(operations, 100);
+
+    if(phase == ComparePhase::Startup){
+        return script.finish();
+    }
+
+    if(phase == ComparePhase::Mixed){                               //The shared workload: everyone opens an account, then sessions cycle through them
+        for(size_t i = 0; i < operations; i++){
+            script.create(i);
+        }
+
+        for(size_t i = 0; i < operations; i++){
+            script.login(i * 7919 % operations);
+            script.deposit('C', 25);
+            script.deposit('S', 25);
+            script.withdraw('C', 10);
+            script.withdraw('S', 10);
+            script.history('C');
+            script.logout();
+        }
+
+        return script.finish();
+    }
+
+    size_t accounts = phase == ComparePhase::Create || phase == ComparePhase::Login ? operations : 1;
+
+    for(size_t i = 0; i < accounts; i++){
+        script.create(i);
+    }
+
+    if(phase == ComparePhase::Create){
+        return script.finish();
+    }
+
+    if(phase == ComparePhase::Login){
+        for(size_t i = 0; i < operations; i++){
+            script.login(i);
+            script.logout();
+        }
+
+        return script.finish();
+    }
+
+    script.login(0);
+
+    for(size_t i = 0; i < operations; i++){
+        script.deposit('C', 25);
+    }
+
+    if(phase == ComparePhase::Withdraw){                            //Every withdrawal is covered by the deposits before it, so no version reprompts
+        for(size_t i = 0; i < operations; i++){
+            script.withdraw('C', 10);
+        }
+
+    } else if(phase == ComparePhase::History){
+        for(size_t i = 0; i < views; i++){
+            script.history('C');
+        }
+    }
+
+    script.logout();
+    return script.finish();
+}
+
+int runCompare(int argc, char* argv[]){                             //Entry point for --compare [--ops N] [--repeat R] label=binary[@dialect]..., drives each version through the same stdin workload
+    size_t operations = 2000;
+    size_t repeats = 3;
+    unsigned timeoutSeconds = 120;
+    vector<VersionTarget> targets;
+
+    try{
+        for(int i = 2; i < argc; i++){
+            string argument = argv[i];
+
+            if(argument == "--ops" && i + 1 < argc){
+                operations = std::max<size_t>(std::stoull(argv[++i]), 1);
+
+            } else if(argument == "--repeat" && i + 1 < argc){
+                repeats = std::max<size_t>(std::stoull(argv[++i]), 1);
+
+            } else if(argument == "--timeout" && i + 1 < argc){
+                timeoutSeconds = std::stoul(argv[++i]);
+
+            } else {
+                VersionTarget target;
+                size_t equals = argument.find('=');
+                target.label = equals == string::npos ? argument : argument.substr(0, equals);
+                target.binary = equals == string::npos ? argument : argument.substr(equals + 1);
+
+                size_t at = target.binary.rfind('@');
+                string hint = target.label + " " + target.binary;        //Without an explicit dialect, guess from the version number in the label or path
+                target.dialect = hint.find("1.4") != string::npos ? ScriptDialect::SplitConfirm
+                               : hint.find("1.3") != string::npos || hint.find("1.5") != string::npos ? ScriptDialect::Split
+                               : ScriptDialect::Flat;
+
+                if(at != string::npos){
+                    if(!parseDialect(target.binary.substr(at + 1), target.dialect)){
+                        std::cerr << "Dialect must be flat, split or confirm.\n";
+                        return 1;
+                    }
+
+                    target.binary.resize(at);
+                }
+
+                targets.push_back(target);
+            }
+        }
+
+    } catch(const exception& error){
+        std::cerr << "Invalid number: " << error.what() << "\n";
+        return 1;
+    }
+
+    if(targets.empty()){
+        std::cerr << "Usage: --compare [--ops N] [--repeat R] [--timeout S] label=binary[@flat|split|confirm]...\n";
+        return 1;
+    }
+
+    const ComparePhase phases[] = {ComparePhase::Startup, ComparePhase::Create, ComparePhase::Login, ComparePhase::Deposit, ComparePhase::Withdraw, ComparePhase::History, ComparePhase::Mixed};
+    const size_t phaseCount = sizeof(phases) / sizeof(phases[0]);
+    size_t views = std::min<size_t>(operations, 100);
+    bool failed = false;
+
+    std::printf("%zu ops per phase, median of %zu runs, latency is the per-op wall time over the phase it extends\n\n", operations, repeats);
+    std::printf("%-12s %12s %10s %10s %10s %10s %10s %10s %10s\n", "version", "mixed ms", "peak KB", "start ms", "create us", "login us", "deposit us", "withdr us", "history us");
+
+    for(const VersionTarget& target : targets){
+        double medians[phaseCount] = {};
+        long peakKb = 0;
+        bool ok = countAmountPrompts(target.binary, comparisonScript(target.dialect, ComparePhase::Mixed, operations), timeoutSeconds) == 4 * operations;
+
+        for(size_t p = 0; p < phaseCount && ok; p++){
+            string script = comparisonScript(target.dialect, phases[p], operations);
+            vector<double> times;
+
+            for(size_t r = 0; r < repeats && ok; r++){
+                ScriptRun run = runScript(target.binary, script, timeoutSeconds);
+                ok = run.ok;
+                times.push_back(run.seconds);
+
+                if(phases[p] == ComparePhase::Mixed){
+                    peakKb = std::max(peakKb, run.peakKb);
+                }
+            }
+
+            std::sort(times.begin(), times.end());
+            medians[p] = times.empty() ? 0 : times[times.size() / 2];
+        }
+
+        if(!ok){
+            std::printf("%-12s did not follow the workload (crashed, timed out, or the dialect is wrong)\n", target.label.c_str());
+            failed = true;
+            continue;
+        }
+
+        auto perOp = [&](ComparePhase phase, ComparePhase baseline, size_t count){
+            return std::max(0.0, medians[size_t(phase)] - medians[size_t(baseline)]) * 1e6 / double(count);
+        };
+
+        std::printf("%-12s %12.1f %10ld %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n", target.label.c_str(),
+            medians[size_t(ComparePhase::Mixed)] * 1e3, peakKb, medians[size_t(ComparePhase::Startup)] * 1e3,
+            perOp(ComparePhase::Create, ComparePhase::Startup, operations),
+            perOp(ComparePhase::Login, ComparePhase::Create, operations),
+            (medians[size_t(ComparePhase::Deposit)] - medians[size_t(ComparePhase::Startup)]) * 1e6 / double(operations),
+            perOp(ComparePhase::Withdraw, ComparePhase::Deposit, operations),
+            perOp(ComparePhase::History, ComparePhase::Deposit, views));
+    }
+
+    return failed ? 1 : 0;
+}
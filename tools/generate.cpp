@@ -0,0 +1,329 @@
+#include "../bank/server.h"
+#include "tools.h"
+
+enum class WorkloadOp : unsigned char{Create, Login, Deposit, Withdraw, History, Passwd};
+
+const char* const workloadOpNames[] = {"create", "login", "deposit", "withdraw", "history", "passwd"};
+const size_t workloadOpCount = sizeof(workloadOpNames) / sizeof(workloadOpNames[0]);
+
+struct WorkloadConfig{                                          //Knobs for --generate, defaults give a read-mostly retail banking mix
+    uint64_t seed = 42;
+    size_t operations = 100000;
+    size_t accounts = 1000;                                     //Population created before the mix starts
+    double skew = 0.99;                                         //Zipf exponent of account popularity, 0 is uniform
+    size_t historyDepth = 20;                                   //Warm-up transactions per account before the mix starts
+    double mistakeRate = 0.03;                                  //Share of commands carrying a user error (bad length, wrong password, amount over the max...)
+    double mix[workloadOpCount] = {2, 20, 30, 28, 15, 5};       //Relative weights, same order as WorkloadOp
+};
+
+bool parseMix(const string& text, double* mix){                 //"deposit=40,withdraw=40,history=20" -- ops left out get weight 0
+    double parsed[workloadOpCount] = {};
+    std::stringstream entries(text);
+    string entry;
+
+    while(getline(entries, entry, ',')){
+        size_t equals = entry.find('=');
+        size_t op = 0;
+
+        while(op < workloadOpCount && (equals == string::npos || entry.compare(0, equals, workloadOpNames[op]) != 0)){
+            op++;
+        }
+
+        if(op == workloadOpCount){
+            return false;
+        }
+
+        char* end = nullptr;
+        parsed[op] = std::strtod(entry.c_str() + equals + 1, &end);
+
+        if(*end != '\0' || parsed[op] < 0){
+            return false;
+        }
+    }
+
+    std::copy(parsed, parsed + workloadOpCount, mix);
+    return true;
+}
+
+class ZipfSampler{                                              //Rank 0 is the most popular, P(rank k) proportional to 1 / (k + 1)^skew, sampled by binary search over the CDF
+    private:
+        vector<double> cdf;
+
+    public:
+        ZipfSampler(size_t ranks, double skew) : cdf(ranks) {
+            double total = 0;
+
+            for(size_t k = 0; k < ranks; k++){
+                total += 1.0 / std::pow(double(k + 1), skew);
+                cdf[k] = total;
+            }
+
+            for(double& point : cdf){
+                point /= total;
+            }
+        }
+
+        template<typename Engine>
+        size_t sample(Engine& engine){
+            double point = std::uniform_real_distribution<double>(0.0, 1.0)(engine);
+            return std::min<size_t>(std::lower_bound(cdf.begin(), cdf.end(), point) - cdf.begin(), cdf.size() - 1);
+        }
+};
+
+class WorkloadGenerator{                                        //Emits batch commands while tracking what the bank will hold, so it knows which ones the rules will reject
+    private:
+        struct ModelAccount{
+            string username;
+            string password;
+            int64_t checking;                               //Cents, mirrors SubAccount::balance
+            int64_t savings;
+        };
+
+        WorkloadConfig config;
+        std::mt19937_64 engine;
+        ZipfSampler popularity;
+        vector<ModelAccount> accounts;
+        vector<size_t> byRank;                              //Popularity rank -> accounts index, shuffled so the hot accounts aren't simply the oldest
+        size_t nextName;
+        size_t emitted[workloadOpCount];
+        size_t rejected[workloadOpCount];
+
+        bool chance(double probability){
+            return std::uniform_real_distribution<double>(0.0, 1.0)(engine) < probability;
+        }
+
+        size_t between(size_t low, size_t high){
+            return std::uniform_int_distribution<size_t>(low, high)(engine);
+        }
+
+        string credential(size_t length){                   //Random lowercase/digit token, batch commands split on whitespace so no spaces
+            static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+            string token(length, 'a');
+
+            for(char& c : token){
+                c = alphabet[between(0, sizeof(alphabet) - 2)];
+            }
+
+            return token;
+        }
+
+        string badLength(){                                 //Just outside the 3-20 rule on either side
+            return chance(0.5) ? credential(between(1, 2)) : credential(between(21, 30));
+        }
+
+        int64_t everydayAmount(){                           //Log-normal cents, median around $60 with a long tail towards the $5000 cap
+            double dollars = std::lognormal_distribution<double>(4.1, 1.3)(engine);
+            return std::clamp<int64_t>(int64_t(dollars * 100), 1, CheckingPolicy::maxTransaction.getCents());
+        }
+
+        int64_t tooLarge(){
+            return CheckingPolicy::maxTransaction.getCents() + int64_t(between(1, 500000));
+        }
+
+        ModelAccount& pick(){
+            return accounts[byRank[popularity.sample(engine)]];
+        }
+
+        void emit(std::ostream& out, WorkloadOp op, bool accepted, const string& line){
+            emitted[size_t(op)]++;
+            rejected[size_t(op)] += !accepted;
+            out << line << "\n";
+        }
+
+        bool deposit(int64_t& balance, int64_t amount){     //Same bounds as PolicyAccount::applyDeposit
+            if(amount <= 0 || amount > CheckingPolicy::maxTransaction.getCents()){
+                return false;
+            }
+
+            balance += amount;
+            return true;
+        }
+
+        template<typename Policy>
+        bool withdraw(int64_t& balance, int64_t amount){    //Same bounds as PolicyAccount::applyWithdraw
+            int64_t floor = Policy::minimumBalance.getCents() - Policy::overdraft.getCents();
+
+            if(amount <= 0 || amount > Policy::maxTransaction.getCents() || amount > balance - floor){
+                return false;
+            }
+
+            balance -= amount;
+            return true;
+        }
+
+        bool moneyCommand(std::ostream& out, WorkloadOp op, ModelAccount& account, char choice, int64_t amount){
+            int64_t& balance = choice == 'C' ? account.checking : account.savings;
+            bool accepted = op == WorkloadOp::Deposit ? deposit(balance, amount)
+                          : choice == 'C' ? withdraw<CheckingPolicy>(balance, amount)
+                          : withdraw<SavingsPolicy>(balance, amount);
+
+            emit(out, op, accepted, string(op == WorkloadOp::Deposit ? "DEPOSIT " : "WITHDRAW ") + account.username + " " + choice + " " + Money::fromCents(amount).toString());
+            return accepted;
+        }
+
+        void createAccount(std::ostream& out, bool warmUp){
+            if(!warmUp && chance(config.mistakeRate)){      //Either the name is taken or one of the fields breaks the length rule
+                if(chance(0.5) && !accounts.empty()){
+                    emit(out, WorkloadOp::Create, false, "CREATE " + pick().username + " " + credential(8));
+
+                } else {
+                    emit(out, WorkloadOp::Create, false, chance(0.5) ? "CREATE " + badLength() + " " + credential(8) : "CREATE user" + std::to_string(nextName++) + " " + badLength());
+                }
+
+                return;
+            }
+
+            ModelAccount account{"user" + std::to_string(nextName++), credential(between(3, 20)), CheckingPolicy::openingDeposit.getCents(), SavingsPolicy::openingDeposit.getCents()};
+            emit(out, WorkloadOp::Create, true, "CREATE " + account.username + " " + account.password);
+            accounts.push_back(account);
+
+            if(byRank.size() < config.accounts){
+                byRank.push_back(accounts.size() - 1);
+
+            } else {                                        //Newcomers take over a random popularity slot, the displaced account goes cold
+                byRank[between(0, byRank.size() - 1)] = accounts.size() - 1;
+            }
+        }
+
+        void step(std::ostream& out, WorkloadOp op){
+            if(op == WorkloadOp::Create){
+                createAccount(out, false);
+                return;
+            }
+
+            ModelAccount& account = pick();
+            bool mistake = chance(config.mistakeRate);
+            char choice = chance(0.7) ? 'C' : 'S';
+
+            switch(op){
+                case WorkloadOp::Login:
+                    emit(out, op, !mistake, "LOGIN " + account.username + " " + (mistake ? credential(between(3, 20)) + "x" : account.password));
+                    break;
+
+                case WorkloadOp::Deposit:
+                    moneyCommand(out, op, account, choice, mistake ? tooLarge() : everydayAmount());
+                    break;
+
+                case WorkloadOp::Withdraw:                  //Overdrafts and savings floors reject on their own, mistakes add over-the-max requests
+                    moneyCommand(out, op, account, choice, mistake ? tooLarge() : everydayAmount());
+                    break;
+
+                case WorkloadOp::History:
+                    emit(out, op, true, "HISTORY " + account.username + " " + choice);
+                    break;
+
+                case WorkloadOp::Passwd:
+                    if(mistake){
+                        bool wrongOld = chance(0.5);
+                        emit(out, op, false, "PASSWD " + account.username + " " + (wrongOld ? account.password + "x" : account.password) + " " + (wrongOld ? credential(8) : badLength()));
+
+                    } else {
+                        string newPassword = credential(between(3, 20));
+                        emit(out, op, true, "PASSWD " + account.username + " " + account.password + " " + newPassword);
+                        account.password = newPassword;
+                    }
+                    break;
+
+                case WorkloadOp::Create:
+                    break;
+            }
+        }
+
+    public:
+        explicit WorkloadGenerator(const WorkloadConfig& newConfig) : config(newConfig), engine(newConfig.seed), popularity(std::max<size_t>(newConfig.accounts, 1), newConfig.skew), accounts(), byRank(), nextName(0), emitted(), rejected() {}
+
+        void generate(std::ostream& out){
+            out << "# seed " << config.seed << ", " << config.accounts << " accounts, zipf " << config.skew << ", history depth " << config.historyDepth << "\n";
+
+            for(size_t i = 0; i < std::max<size_t>(config.accounts, 1); i++){
+                createAccount(out, true);
+            }
+
+            for(ModelAccount& account : accounts){          //Warm-up history, always accepted so every account starts with the configured depth
+                for(size_t i = 0; i < config.historyDepth; i++){
+                    char choice = i % 3 == 2 ? 'S' : 'C';
+                    int64_t& balance = choice == 'C' ? account.checking : account.savings;
+                    int64_t amount = everydayAmount();
+
+                    if(i % 2 == 1 && balance - amount >= (choice == 'C' ? 0 : SavingsPolicy::minimumBalance.getCents())){
+                        moneyCommand(out, WorkloadOp::Withdraw, account, choice, amount);
+
+                    } else {
+                        moneyCommand(out, WorkloadOp::Deposit, account, choice, amount);
+                    }
+                }
+            }
+
+            std::fill(emitted, emitted + workloadOpCount, 0);          //Only the mix counts towards the report
+            std::fill(rejected, rejected + workloadOpCount, 0);
+            out << "# mix\n";
+
+            std::discrete_distribution<size_t> mix(config.mix, config.mix + workloadOpCount);
+
+            for(size_t i = 0; i < config.operations; i++){
+                step(out, WorkloadOp(mix(engine)));
+            }
+        }
+
+        void report(std::ostream& out) const{              //Expected outcome per command type, a --batch run of the same stream should fail exactly this many
+            size_t totalRejected = 0;
+
+            out << "op,emitted,expected_rejected\n";
+
+            for(size_t op = 0; op < workloadOpCount; op++){
+                out << workloadOpNames[op] << "," << emitted[op] << "," << rejected[op] << "\n";
+                totalRejected += rejected[op];
+            }
+
+            out << "total," << config.operations << "," << totalRejected << "\n";
+        }
+};
+
+int runGenerate(int argc, char* argv[]){                        //Entry point for --generate [options], writes batch commands to stdout and the expected rejections to stderr
+    WorkloadConfig config;
+
+    try{
+        for(int i = 2; i < argc; i++){
+            string argument = argv[i];
+            bool hasValue = i + 1 < argc;
+
+            if(argument == "--seed" && hasValue){
+                config.seed = std::stoull(argv[++i]);
+
+            } else if(argument == "--ops" && hasValue){
+                config.operations = std::stoull(argv[++i]);
+
+            } else if(argument == "--accounts" && hasValue){
+                config.accounts = std::stoull(argv[++i]);
+
+            } else if(argument == "--zipf" && hasValue){
+                config.skew = std::stod(argv[++i]);
+
+            } else if(argument == "--depth" && hasValue){
+                config.historyDepth = std::stoull(argv[++i]);
+
+            } else if(argument == "--mistakes" && hasValue){
+                config.mistakeRate = std::stod(argv[++i]);
+
+            } else if(argument == "--mix" && hasValue && parseMix(argv[++i], config.mix)){
+                continue;
+
+            } else {
+                std::cerr << "Usage: --generate [--seed N] [--ops N] [--accounts N] [--zipf S] [--depth N] [--mistakes P] [--mix create=W,login=W,deposit=W,withdraw=W,history=W,passwd=W]\n";
+                return 1;
+            }
+        }
+
+    } catch(const exception& error){
+        std::cerr << "Invalid number: " << error.what() << "\n";
+        return 1;
+    }
+
+    std::ios::sync_with_stdio(false);
+
+    WorkloadGenerator generator(config);
+    generator.generate(cout);
+    cout.flush();
+    generator.report(std::cerr);
+    return 0;
+}
@@ -0,0 +1,200 @@
+#include "../bank/server.h"
+#include "tools.h"
+
+struct LoadSession{                                             //One --load connection: creates its own account, runs the mix on it until time is up, then deletes it
+    enum class Phase : unsigned char{Creating, LoggingIn, Running, Deleting};
+
+    int fd = -1;
+    Phase phase = Phase::Creating;
+    string name;
+    string input;                                               //Reply bytes past the last complete line
+    std::chrono::steady_clock::time_point sent;
+};
+
+int runLoad(int argc, char* argv[]){                            //Entry point for --load <address> [connections] [seconds], closed-loop clients with one request in flight each
+    using Clock = std::chrono::steady_clock;
+
+    ServerAddress address;
+
+    if(argc < 3 || !parseServerAddress(argv[2], address)){
+        std::cerr << "Usage: --load <socket path | loopback host:port> [connections] [seconds]\n";
+        return 1;
+    }
+
+    size_t connections = 1000;
+    double seconds = 10;
+
+    try{
+        connections = argc > 3 ? std::stoull(argv[3]) : connections;
+        seconds = argc > 4 ? std::stod(argv[4]) : seconds;
+
+    } catch(const exception& error){
+        std::cerr << "Invalid number: " << error.what() << "\n";
+        return 1;
+    }
+
+    raiseDescriptorLimit();
+    signal(SIGPIPE, SIG_IGN);
+
+    int poller = epoll_create1(EPOLL_CLOEXEC);
+    vector<LoadSession> sessions(connections);
+    string tag = std::to_string(getpid() % 100000);            //Keeps concurrent load runs from colliding on account names
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+
+    auto issue = [](LoadSession& session, const string& request){      //Requests are tiny and only one is in flight, so the socket always takes all of it
+        session.sent = Clock::now();
+        return ::send(session.fd, request.data(), request.size(), MSG_NOSIGNAL) == ssize_t(request.size());
+    };
+
+    for(size_t i = 0; i < connections; i++){
+        LoadSession& session = sessions[i];
+        session.fd = socket(address.tcp ? AF_INET : AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        if(session.fd < 0 || connect(session.fd, address.get(), address.size()) != 0){
+            std::cerr << "Could not connect session " << i << ": " << std::strerror(errno) << "\n";
+            return 1;
+        }
+
+        if(address.tcp){
+            int on = 1;
+            setsockopt(session.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
+
+        fcntl(session.fd, F_SETFL, fcntl(session.fd, F_GETFL) | O_NONBLOCK);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = &session;
+        epoll_ctl(poller, EPOLL_CTL_ADD, session.fd, &event);
+        session.name = "ld" + tag + "_" + std::to_string(i);
+    }
+
+    LatencyHistogram latency;
+    size_t operations = 0;
+    size_t rejected = 0;
+    size_t dropped = 0;
+    size_t active = connections;
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    auto lastReply = start;
+
+    for(LoadSession& session : sessions){
+        if(!issue(session, "CREATE " + session.name + " loadpass\n")){
+            std::cerr << "Could not send to the server\n";
+            return 1;
+        }
+    }
+
+    auto finish = [&active](LoadSession& session){
+        ::close(session.fd);
+        session.fd = -1;
+        active--;
+    };
+
+    epoll_event events[256];
+    char buffer[65536];
+    string request;
+
+    while(active > 0){
+        int ready = epoll_wait(poller, events, 256, 100);
+        auto now = Clock::now();
+
+        if(now > deadline + std::chrono::seconds(10)){          //Grace period for the last replies and the deletes
+            dropped += active;
+            break;
+        }
+
+        for(int i = 0; i < ready; i++){
+            LoadSession& session = *static_cast<LoadSession*>(events[i].data.ptr);
+            ssize_t received = ::recv(session.fd, buffer, sizeof(buffer), 0);
+
+            if(received <= 0){
+                if(received < 0 && (errno == EAGAIN || errno == EINTR)){
+                    continue;
+                }
+
+                dropped++;
+                finish(session);
+                continue;
+            }
+
+            session.input.append(buffer, size_t(received));
+            size_t start = 0;
+
+            for(size_t end = session.input.find('\n'); end != string::npos && session.fd >= 0; end = session.input.find('\n', start)){
+                std::string_view line = std::string_view(session.input).substr(start, end - start);
+                start = end + 1;
+
+                if(line.substr(0, 2) != "OK" && line.substr(0, 3) != "ERR"){      //Body lines (SUMMARY has none, but HISTORY would) come before the status line
+                    continue;
+                }
+
+                if(session.phase == LoadSession::Phase::Running){
+                    latency.record(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now - session.sent).count()));
+                    operations++;
+                    rejected += line[0] == 'E';
+                    lastReply = now;
+                }
+
+                if(session.phase == LoadSession::Phase::Deleting){
+                    finish(session);
+                    break;
+                }
+
+                if(now >= deadline){
+                    session.phase = LoadSession::Phase::Deleting;
+                    request = "DELETE " + session.name + " loadpass\n";
+
+                } else if(session.phase == LoadSession::Phase::Creating){      //The mix only touches the session's own account, which the server wants logged in first
+                    session.phase = LoadSession::Phase::LoggingIn;
+                    request = "LOGIN " + session.name + " loadpass\n";
+
+                } else {                                        //Mix: 40% deposit, 35% withdraw, 20% login, 5% summary
+                    session.phase = LoadSession::Phase::Running;
+                    seed ^= seed << 13;
+                    seed ^= seed >> 7;
+                    seed ^= seed << 17;
+
+                    unsigned roll = unsigned(seed % 100);
+                    const char* choice = (seed >> 8) & 1 ? " S" : " C";
+                    string amount = std::to_string(1 + (seed >> 16) % 200);
+
+                    if(roll < 40){
+                        request = "DEPOSIT " + session.name + choice + " " + amount + "\n";
+
+                    } else if(roll < 75){
+                        request = "WITHDRAW " + session.name + choice + " " + amount + "\n";
+
+                    } else if(roll < 95){
+                        request = "LOGIN " + session.name + " loadpass\n";
+
+                    } else {
+                        request = "SUMMARY " + session.name + choice + "\n";
+                    }
+                }
+
+                if(!issue(session, request)){
+                    dropped++;
+                    finish(session);
+                }
+            }
+
+            if(session.fd >= 0){
+                session.input.erase(0, start);
+            }
+        }
+    }
+
+    for(LoadSession& session : sessions){
+        if(session.fd >= 0){
+            ::close(session.fd);
+        }
+    }
+
+    ::close(poller);
+
+    double elapsed = std::chrono::duration<double>(lastReply - start).count();
+    cout << "connections,operations,seconds,ops_per_sec,rejected,p50_us,p99_us,p999_us,dropped\n";
+    cout << connections << "," << operations << "," << elapsed << "," << (elapsed > 0 ? operations / elapsed : 0) << "," << rejected << ","
+         << latency.percentile(0.50) / 1000.0 << "," << latency.percentile(0.99) / 1000.0 << "," << latency.percentile(0.999) / 1000.0 << "," << dropped << "\n";
+    return dropped == 0 ? 0 : 1;
+}
@@ -0,0 +1,6 @@
+#pragma once                                                        //Entry points of the tools built into the bank binary, see tools/*.cpp
+
+int runBenchmark(int argc, char* argv[]);                       //--bench <name> [args...]
+int runCompare(int argc, char* argv[]);                         //--compare [--ops N] [--repeat R] label=binary[@dialect]...
+int runGenerate(int argc, char* argv[]);                        //--generate [options]
+int runLoad(int argc, char* argv[]);                            //--load [options]